@@ -1,34 +1,91 @@
+#include <cstdint>
 #include <string>
-#include <iterator>
 #include <iostream>
 
 #include "cli.hpp"
 #include "beeline.hpp"
 
 
-// Reads all characters from the given input stream.
+// Reads all characters from the given input stream in blocks.
 // Returns a string containing all characters read.
 std::string read_all_from(std::istream& input)
 {
-    input >> std::noskipws;
-    std::istream_iterator<char> it(input);
-    std::istream_iterator<char> end;
-    return {it, end};
+    std::string text;
+    char block[1 << 16];
+    while (input.read(block, sizeof(block)) || input.gcount() > 0)
+    {
+        text.append(block, input.gcount());
+    }
+    return text;
+}
+
+
+// Reads declarations from the given input stream line by line, prompting
+// for each line, and executes every declaration as soon as the line ending
+// it has been read. Errors have been logged by the time they are caught,
+// and the session continues after them.
+void repl(Beeline& beeline, std::istream& input)
+{
+    Beeline::Session session = beeline.session();
+    std::string line;
+    while (true)
+    {
+        std::cout << (session.is_pending() ? "... " : "> ") << std::flush;
+        if (!std::getline(input, line))
+        {
+            break;
+        }
+        try
+        {
+            session.submit(line + '\n');
+            session.confirm();
+        }
+        catch (const BeelineError&)
+        {
+        }
+    }
+    std::cout << '\n';
+    session.finish();
 }
 
 
-// Reads all characters from stdin and runs the beeline
-// interpreter on the input. Sets the logging level
-// according to the given arguments. Returns 0 on success
-// and 1 on error.
+// Runs the beeline interpreter on the given script files, or
+// reads all characters from stdin and runs the interpreter on
+// the input, or streams the input through the interpreter or
+// runs an interactive session on it if requested. Sets the logging level according to the given
+// arguments. Returns 0 on success and 1 on error.
 int main(const int argc, const char** argv)
 {
     Arguments arguments = ArgumentParser().parse(argc, argv);
     init_logging(arguments.logging_level);
     int return_code = 0;
+    Beeline beeline{static_cast<std::size_t>(arguments.jobs), arguments.cache_directory};
+    if (!arguments.output_cache_directory.empty())
+    {
+        beeline.cache_output(arguments.output_cache_directory, static_cast<std::uintmax_t>(arguments.output_cache_size) << 20);
+    }
     try
     {
-        Beeline{}.run(read_all_from(std::cin));
+        beeline.optimize(OptimizationOptions{arguments.optimization_level, arguments.enabled_passes, arguments.disabled_passes, arguments.dump_after});
+        if (!arguments.scripts.empty())
+        {
+            beeline.run_files(arguments.scripts);
+        }
+        else if (arguments.repl)
+        {
+            repl(beeline, std::cin);
+        }
+        else if (arguments.stream)
+        {
+            // Lets std::cin buffer independently of stdio, so that the streaming
+            // interpreter can tell when reading further input would block.
+            std::ios::sync_with_stdio(false);
+            beeline.stream(std::cin);
+        }
+        else
+        {
+            beeline.run(read_all_from(std::cin));
+        }
     }
     catch (const BeelineError& be)
     {
@@ -1,10 +1,15 @@
 #include <sstream>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
 
 #include <boost/program_options.hpp>
 
 #include "cli.hpp"
+#include "beeline.hpp"
 
 
 namespace po = boost::program_options;
@@ -14,7 +19,7 @@ namespace po = boost::program_options;
 std::string build_usage_string(const std::string &process_name, const po::options_description &desc)
 {
     std::stringstream ss;
-    ss << "usage: " << process_name << " [options]\n" << desc;
+    ss << "usage: " << process_name << " [options] [script ...]\n" << desc;
     return ss.str();
 }
 
@@ -78,7 +83,7 @@ protected:
     {
         if (arguments.version)
         {
-            std::cout << "version: 0.0.1\n";
+            std::cout << "version: " << BEELINE_VERSION << "\n";
             exit(0);
         }
     }
@@ -115,6 +120,96 @@ protected:
 };
 
 
+// Ensures streaming is only requested when the program is read from stdin.
+class StreamXorScriptsValidationHandler : public ArgumentHandler
+{
+protected:
+    void handle_(const Arguments arguments, const ArgumentParsingContext context) const override
+    {
+        if (arguments.stream && !arguments.scripts.empty())
+        {
+            std::cerr << "error: stream and scripts are mutually exclusive\n" << build_usage_string(context.argv[0], context.desc);
+            exit(1);
+        }
+    }
+};
+
+
+// Ensures the REPL is neither combined with streaming nor given scripts.
+class ReplValidationHandler : public ArgumentHandler
+{
+protected:
+    void handle_(const Arguments arguments, const ArgumentParsingContext context) const override
+    {
+        if (arguments.repl && (arguments.stream || !arguments.scripts.empty()))
+        {
+            std::cerr << "error: repl is mutually exclusive with stream and scripts\n" << build_usage_string(context.argv[0], context.desc);
+            exit(1);
+        }
+    }
+};
+
+
+// Ensures the number of jobs is not negative.
+class JobsValidationHandler : public ArgumentHandler
+{
+protected:
+    void handle_(const Arguments arguments, const ArgumentParsingContext context) const override
+    {
+        if (arguments.jobs < 0)
+        {
+            std::cerr << "error: jobs must not be negative\n" << build_usage_string(context.argv[0], context.desc);
+            exit(1);
+        }
+    }
+};
+
+
+// Ensures the output cache can hold something.
+class OutputCacheSizeValidationHandler : public ArgumentHandler
+{
+protected:
+    void handle_(const Arguments arguments, const ArgumentParsingContext context) const override
+    {
+        if (arguments.output_cache_size <= 0)
+        {
+            std::cerr << "error: output cache size must be positive\n" << build_usage_string(context.argv[0], context.desc);
+            exit(1);
+        }
+    }
+};
+
+
+// Ensures the optimization level is between 0 and 2 and the passes named exist.
+class OptimizationValidationHandler : public ArgumentHandler
+{
+protected:
+    void handle_(const Arguments arguments, const ArgumentParsingContext context) const override
+    {
+        if (arguments.optimization_level < 0 || arguments.optimization_level > 2)
+        {
+            std::cerr << "error: optimization level must be between 0 and 2\n" << build_usage_string(context.argv[0], context.desc);
+            exit(1);
+        }
+        std::vector<std::string> names = arguments.enabled_passes;
+        names.insert(names.end(), arguments.disabled_passes.begin(), arguments.disabled_passes.end());
+        if (!arguments.dump_after.empty())
+        {
+            names.push_back(arguments.dump_after);
+        }
+        const std::vector<std::string_view> passes = Beeline::passes();
+        for (const std::string& name : names)
+        {
+            if (std::find(passes.begin(), passes.end(), name) == passes.end())
+            {
+                std::cerr << "error: unknown optimization pass '" << name << "'\n" << build_usage_string(context.argv[0], context.desc);
+                exit(1);
+            }
+        }
+    }
+};
+
+
 // Parses the arguments and returns an Arguments object.
 class ArgumentParser::Impl
 {
@@ -126,13 +221,23 @@ public:
         // the help and version handlers are called.
         std::unique_ptr<HelpXorVersionValidationHandler> mutual_exclusive_help_and_version_handler = std::make_unique<HelpXorVersionValidationHandler>();
         std::unique_ptr<LoggingLevelValidationHandler> logging_level_validation_handler = std::make_unique<LoggingLevelValidationHandler>();
+        std::unique_ptr<StreamXorScriptsValidationHandler> stream_xor_scripts_validation_handler = std::make_unique<StreamXorScriptsValidationHandler>();
+        std::unique_ptr<ReplValidationHandler> repl_validation_handler = std::make_unique<ReplValidationHandler>();
+        std::unique_ptr<JobsValidationHandler> jobs_validation_handler = std::make_unique<JobsValidationHandler>();
+        std::unique_ptr<OutputCacheSizeValidationHandler> output_cache_size_validation_handler = std::make_unique<OutputCacheSizeValidationHandler>();
+        std::unique_ptr<OptimizationValidationHandler> optimization_validation_handler = std::make_unique<OptimizationValidationHandler>();
         std::unique_ptr<HelpHandler> help_handler = std::make_unique<HelpHandler>();
         std::unique_ptr<VersionHandler> version_handler = std::make_unique<VersionHandler>();
 
         // Set the next handler in the chain. Reverse order is necessary
         // to ensure handlers are not referenced after they are moved.
         help_handler->set_next(std::move(version_handler));
-        logging_level_validation_handler->set_next(std::move(help_handler));
+        optimization_validation_handler->set_next(std::move(help_handler));
+        output_cache_size_validation_handler->set_next(std::move(optimization_validation_handler));
+        jobs_validation_handler->set_next(std::move(output_cache_size_validation_handler));
+        repl_validation_handler->set_next(std::move(jobs_validation_handler));
+        stream_xor_scripts_validation_handler->set_next(std::move(repl_validation_handler));
+        logging_level_validation_handler->set_next(std::move(stream_xor_scripts_validation_handler));
         mutual_exclusive_help_and_version_handler->set_next(std::move(logging_level_validation_handler));
 
         handler_chain_ = std::move(mutual_exclusive_help_and_version_handler);
@@ -140,11 +245,16 @@ public:
     Arguments parse(const int argc, const char** argv) const
     {
         po::options_description desc = build_options_description();
+        po::options_description hidden = build_hidden_options_description();
+        po::options_description all;
+        all.add(desc).add(hidden);
+        po::positional_options_description positional;
+        positional.add("script", -1);
         po::variables_map vm;
 
         try
         {
-            po::store(po::parse_command_line(argc, argv, desc), vm);
+            po::store(po::command_line_parser(argc, argv).options(all).positional(positional).run(), vm);
         }
         catch (const po::error &e)
         {
@@ -158,6 +268,17 @@ public:
             static_cast<LoggingLevel>(vm["debug_level"].as<int>()),
             vm.count("version") > 0,
             vm.count("help") > 0,
+            vm.count("stream") > 0,
+            vm.count("repl") > 0,
+            vm["jobs"].as<int>(),
+            vm["cache_dir"].as<std::string>(),
+            vm["output_cache_dir"].as<std::string>(),
+            vm["output_cache_size"].as<int>(),
+            vm["optimize"].as<int>(),
+            vm.count("enable_pass") > 0 ? vm["enable_pass"].as<std::vector<std::string>>() : std::vector<std::string>{},
+            vm.count("disable_pass") > 0 ? vm["disable_pass"].as<std::vector<std::string>>() : std::vector<std::string>{},
+            vm["dump_after"].as<std::string>(),
+            vm.count("script") > 0 ? vm["script"].as<std::vector<std::string>>() : std::vector<std::string>{},
         };
 
         handler_chain_->handle(arguments, {argc, argv, desc});
@@ -168,14 +289,38 @@ private:
     std::unique_ptr<ArgumentHandler> handler_chain_;
     po::options_description build_options_description() const
     {
+        std::string passes;
+        for (const std::string_view pass : Beeline::passes())
+        {
+            passes += (passes.empty() ? "" : ", ") + std::string{pass};
+        }
         po::options_description desc("Allowed options");
         desc.add_options()
             ("debug_level,d", po::value<int>()->default_value(4), "set debug level (0=trace, 1=debug, 2=info, 3=warn, 4=error, 5=fatal)")
             ("help,h", "produce help message")
             ("version,v", "print version string")
+            ("stream,s", "execute each top-level declaration as soon as it has been read from stdin")
+            ("repl,r", "read declarations interactively, executing each one as soon as its line is entered")
+            ("jobs,j", po::value<int>()->default_value(0), "number of threads lexing and parsing large programs (0=one per core)")
+            ("cache_dir", po::value<std::string>()->default_value(""), "directory caching compiled programs, so that unchanged ones are not lexed and parsed again")
+            ("output_cache_dir", po::value<std::string>()->default_value(""), "directory caching the output of programs, so that unchanged ones are not run again")
+            ("output_cache_size", po::value<int>()->default_value(64), "maximum size of the output cache in MiB")
+            ("optimize,O", po::value<int>()->default_value(2), "optimization level (0=no passes, 1=passes rewriting nodes in place, 2=all passes)")
+            ("enable_pass", po::value<std::vector<std::string>>(), ("run the given optimization pass whatever the level (" + passes + ")").c_str())
+            ("disable_pass", po::value<std::vector<std::string>>(), "skip the given optimization pass whatever the level")
+            ("dump_after", po::value<std::string>()->default_value(""), "print each program after the given optimization pass")
         ;
         return desc;
     }
+    // Options that are not listed in the usage string, such as positional arguments.
+    po::options_description build_hidden_options_description() const
+    {
+        po::options_description hidden;
+        hidden.add_options()
+            ("script", po::value<std::vector<std::string>>(), "script files to run instead of reading stdin")
+        ;
+        return hidden;
+    }
 };
 
 
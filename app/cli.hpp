@@ -1,6 +1,8 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "logging.hpp"
 
@@ -10,6 +12,17 @@ struct Arguments
     LoggingLevel logging_level;
     bool version;
     bool help;
+    bool stream;
+    bool repl;
+    int jobs;
+    std::string cache_directory;
+    std::string output_cache_directory;
+    int output_cache_size;
+    int optimization_level;
+    std::vector<std::string> enabled_passes;
+    std::vector<std::string> disabled_passes;
+    std::string dump_after;
+    std::vector<std::string> scripts;
 };
 
 
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "source.hpp"
+#include "lexer.hpp"
+
+
+// Representative mix of beeline code: comments, indentation, keywords,
+// identifiers, numbers and string literals.
+constexpr const char* SNIPPET =
+    "// Computes the fibonacci sequence and reports every element.\n"
+    "var trailing_value = 0\n"
+    "var leading_value = 1\n"
+    "var n_found = 0\n"
+    "while (n_found < 1000 and !(trailing_value >= 123456.789)) {\n"
+    "    print \"element \" + n_found + \" of the sequence is \" + trailing_value\n"
+    "    if (n_found != (n_to_find - 1)) { print \", \" } else { print null }\n"
+    "    var temp = trailing_value  // swap through a temporary\n"
+    "    trailing_value = leading_value\n"
+    "    leading_value = temp + leading_value * 1.0 / 2\n"
+    "    n_found = n_found + 1 == true or false\n"
+    "}\n";
+
+
+// Builds a source of at least the given size by repeating the snippet.
+std::string generate(const std::size_t size)
+{
+    std::string text;
+    text.reserve(size + std::char_traits<char>::length(SNIPPET));
+    while (text.size() < size)
+    {
+        text += SNIPPET;
+    }
+    return text;
+}
+
+
+// Lexes a generated script (or the script at the given path) repeatedly and
+// reports the throughput of the lexer in MB/s.
+//
+// usage: lexer_throughput [path]
+int main(const int argc, const char** argv)
+{
+    std::string text;
+    if (argc > 1)
+    {
+        std::ifstream file{argv[1], std::ios::binary};
+        std::ostringstream ss;
+        ss << file.rdbuf();
+        text = ss.str();
+    }
+    else
+    {
+        text = generate(16 * 1024 * 1024);
+    }
+    const Source source{std::move(text)};
+    constexpr int iterations = 10;
+    std::size_t tokens = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        tokens += Lexer{source}.scan().size();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double megabytes = static_cast<double>(source.text().size()) * iterations / (1024 * 1024);
+    std::cout << "lexed " << megabytes << " MB (" << tokens << " tokens) in " << elapsed.count() << " s: "
+              << megabytes / elapsed.count() << " MB/s\n";
+    return 0;
+}
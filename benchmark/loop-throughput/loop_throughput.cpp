@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "beeline.hpp"
+#include "logging.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "flat_ast.hpp"
+#include "interpreter.hpp"
+
+
+// Builds the loop of example/while_loops.txt, counting up to the given
+// number of iterations.
+std::string generate_count(const std::size_t iterations)
+{
+    return "var i = 0\nwhile (i < " + std::to_string(iterations) + ") {\n    i = i + 1\n}\n";
+}
+
+
+// Builds a loop that counts down and adds to a total on some of its
+// iterations, comparing a variable to a constant on both sides.
+std::string generate_branches(const std::size_t iterations)
+{
+    return "var i = " + std::to_string(iterations) + "\nvar total = 0\nwhile (0 < i) {\n"
+        "    if (i >= 100) {\n        total = total + 2\n    }\n    i = i - 1\n}\n";
+}
+
+
+// Builds a loop that appends a literal to a string on every iteration.
+std::string generate_append(const std::size_t iterations)
+{
+    return "var s = \"\"\nvar i = 0\nwhile (i < " + std::to_string(iterations) + ") {\n    s = s + \"x\"\n    i = i + 1\n}\n";
+}
+
+
+// Runs the given script with the given optimization options and returns the
+// time it took, lexing and parsing left out.
+std::chrono::duration<double> time(const std::string& text, const OptimizationOptions& optimization)
+{
+    FlatAst ast = lower(Parser{Lexer{Source{text}}.scan()}.parse());
+    Interpreter interpreter{optimization};
+    const auto start = std::chrono::steady_clock::now();
+    interpreter.interpret(std::move(ast));
+    return std::chrono::steady_clock::now() - start;
+}
+
+
+// Runs the given script of loops of the given number of iterations with and
+// without superinstructions, and reports the time per iteration of each.
+void measure(const std::string& name, const std::string& text, const std::size_t iterations)
+{
+    const std::chrono::duration<double> unfused = time(text, OptimizationOptions{2, {}, {"superinstructions"}});
+    const std::chrono::duration<double> fused = time(text, OptimizationOptions{});
+    const auto per_iteration = [&](const std::chrono::duration<double> elapsed) {
+        return elapsed.count() * 1e9 / static_cast<double>(iterations);
+    };
+    std::cout << name << ": " << iterations << " iterations: " << per_iteration(unfused) << " ns/iteration unfused, "
+              << per_iteration(fused) << " ns/iteration fused (" << unfused / fused << "x)\n";
+}
+
+
+// Runs generated loops shaped like example/while_loops.txt with and without
+// superinstructions and reports the time each iteration takes.
+//
+// usage: loop_throughput
+int main()
+{
+    init_logging(LoggingLevel::ERROR);
+    measure("count", generate_count(20000000), 20000000);
+    measure("branches", generate_branches(20000000), 20000000);
+    measure("append", generate_append(100000), 100000);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "program.hpp"
+
+
+// Builds statements whose expressions nest parentheses and prefix operators
+// the given number of levels deep, such as `print -(!(-(a + 1) * 2) - 3)`.
+std::string generate_nested(const std::size_t statements, const std::size_t depth)
+{
+    std::string text;
+    for (std::size_t i = 0; i < statements; ++i)
+    {
+        text += "print ";
+        for (std::size_t level = 0; level < depth; ++level)
+        {
+            text += level % 2 == 0 ? "-(" : "!(";
+        }
+        text += "a";
+        for (std::size_t level = 0; level < depth; ++level)
+        {
+            text += level % 3 == 0 ? " + 1)" : level % 3 == 1 ? " * 2)" : " == b)";
+        }
+        text += "\n";
+    }
+    return text;
+}
+
+
+// Builds statements each holding one long chain of binary operators of mixed
+// precedence, such as `x = a + b * c < d or e - f / g ...`.
+std::string generate_flat(const std::size_t statements, const std::size_t length)
+{
+    constexpr const char* OPERATORS[] = {" + ", " * ", " < ", " or ", " - ", " / ", " >= ", " and ", " != "};
+    std::string text;
+    for (std::size_t i = 0; i < statements; ++i)
+    {
+        text += "x = a";
+        for (std::size_t j = 0; j < length; ++j)
+        {
+            text += OPERATORS[j % std::size(OPERATORS)];
+            text += j % 2 == 0 ? "b" : "2";
+        }
+        text += "\n";
+    }
+    return text;
+}
+
+
+// Builds if statements whose bodies each declare a variable and update it the
+// given number of times, long enough to be deferred when parsing lazily.
+std::string generate_blocks(const std::size_t statements, const std::size_t length)
+{
+    std::string text;
+    for (std::size_t i = 0; i < statements; ++i)
+    {
+        text += "if (a < " + std::to_string(i) + ") {\n    var x = \"\"\n";
+        for (std::size_t j = 0; j < length; ++j)
+        {
+            text += "    x = x + \"" + std::to_string(j) + "\" + (a * 2 - b)\n";
+        }
+        text += "}\n";
+    }
+    return text;
+}
+
+
+// Parses the given script repeatedly and reports the throughput of the parser
+// in tokens per second, deferring large blocks if lazy. Lexing is done once up
+// front and left out of the time.
+void measure(const std::string& name, std::string text, const bool lazy = false)
+{
+    const Source source{std::move(text)};
+    const TokenStream tokens = Lexer{source}.scan();
+    constexpr int iterations = 10;
+    std::size_t statements = 0;
+    std::chrono::duration<double> elapsed{0};
+    for (int i = 0; i < iterations; ++i)
+    {
+        TokenStream copy = tokens;
+        const auto start = std::chrono::steady_clock::now();
+        statements += Parser{std::move(copy), lazy}.parse().statements.size();
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+    const double megatokens = static_cast<double>(tokens.size()) * iterations / 1e6;
+    std::cout << name << ": parsed " << megatokens << " M tokens (" << statements << " statements) in "
+              << elapsed.count() << " s: " << megatokens / elapsed.count() << " M tokens/s\n";
+}
+
+
+// Parses generated scripts of deeply nested and of long flat expressions, and
+// one of large if bodies eagerly and lazily, and reports the throughput of the
+// parser on each.
+//
+// usage: parser_throughput
+int main()
+{
+    measure("nested", generate_nested(20000, 64));
+    measure("flat", generate_flat(20000, 128));
+    const std::string blocks = generate_blocks(20000, 16);
+    measure("blocks", blocks);
+    measure("deferred blocks", blocks, true);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "beeline.hpp"
+#include "logging.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "flat_ast.hpp"
+#include "resolver.hpp"
+#include "pass_manager.hpp"
+
+
+// Builds a script of the given number of top-level declarations, each
+// followed by a branch that assigns the variable it declares, so that the
+// number of variables grows with the number of branches.
+std::string generate_branches(const std::size_t pairs)
+{
+    std::string text;
+    for (std::size_t i = 0; i < pairs; ++i)
+    {
+        const std::string name = "v" + std::to_string(i);
+        text += "var " + name + " = " + std::to_string(i) + "\nif (" + name + " > 0) {\n    " + name + " = " + name + " + 1\n}\n";
+    }
+    return text;
+}
+
+
+// Runs the given pass alone on the given script and returns the time it
+// took, lexing, parsing and resolving left out.
+std::chrono::duration<double, std::milli> time(const std::string& text, const std::string_view pass)
+{
+    FlatAst ast = lower(Parser{Lexer{Source{text}}.scan()}.parse());
+    Resolver resolver;
+    resolver.resolve(ast);
+    const PassManager passes{OptimizationOptions{0, {std::string{pass}}}};
+    const auto start = std::chrono::steady_clock::now();
+    passes.run(ast, resolver.global_count());
+    return std::chrono::steady_clock::now() - start;
+}
+
+
+// Runs each pass alone on scripts of doubling numbers of declarations and
+// branches, and reports the time each takes, which should double with them.
+//
+// usage: pass_scaling
+int main()
+{
+    init_logging(LoggingLevel::ERROR);
+    for (std::size_t pairs = 20000; pairs <= 80000; pairs *= 2)
+    {
+        const std::string text = generate_branches(pairs);
+        std::cout << pairs << " branches:";
+        for (const Pass& pass : registered_passes())
+        {
+            std::cout << " " << pass.name << " " << time(text, pass.name).count() << " ms";
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -1,16 +1,117 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <ostream>
+#include <istream>
 #include <stdexcept>
 
 
+// Version of the interpreter. Programs compiled by one version are not
+// reused by another.
+constexpr std::string_view BEELINE_VERSION = "0.0.1";
+
+
+// Options of the passes that optimize programs after they are resolved and
+// before they run. The passes are named by Beeline::passes.
+struct OptimizationOptions
+{
+    // 0 runs no passes, 1 the passes that rewrite expressions and statements
+    // in place, and 2 all passes.
+    int level{2};
+    // Passes to run, and not to run, whatever the level. A pass that is both
+    // enabled and disabled is not run.
+    std::vector<std::string> enabled_passes{};
+    std::vector<std::string> disabled_passes{};
+    // Pass after which each optimized program is printed to std::cerr, if
+    // any.
+    std::string dump_after{};
+};
+
+
 // Beeline interpreter.
 class Beeline
 {
 public:
-    // Runs the beeline interpreter on the given input.
-    void run(const std::string& input);
+    class Session;
+    // Creates an interpreter that lexes and parses large programs on the
+    // given number of threads, or on one thread per core if it is zero.
+    // Programs run whole are compiled through the program cache in the given
+    // directory, unless it is empty.
+    explicit Beeline(const std::size_t jobs = 1, std::filesystem::path cache_directory = {});
+    // Runs the beeline interpreter on the given input. The input is moved
+    // into a shared source buffer that the tokens and AST refer into.
+    void run(std::string input);
+    // Runs the beeline interpreter on the files at the given paths, which are
+    // memory-mapped rather than read. The files are executed in order and
+    // share their variables, but errors report positions within each file.
+    // Each file is compiled just before it is executed.
+    void run_files(const std::vector<std::string>& paths);
+    // Runs the beeline interpreter on the given input stream. Each complete
+    // top-level declaration is executed as soon as it has been read, and
+    // freed afterwards. Declarations preceding a syntax or parsing error
+    // have already been executed by the time the error is reported.
+    void stream(std::istream& input);
+    // Starts a session that executes text as it is submitted.
+    Session session() const;
+    // Caches the results of run and run_files in the given directory, whose
+    // entries are capped at the given total size in bytes. The output of a
+    // program run before is replayed instead of running it again, together
+    // with the errors it logged and whether it failed.
+    void cache_output(std::filesystem::path directory, const std::uintmax_t capacity);
+    // Optimizes the programs run afterwards with the given options. Throws a
+    // BeelineError if the level is not between 0 and 2 or a pass is unknown.
+    // The time each pass takes and the number of nodes it adds or removes
+    // are logged at the info level. Programs are not replayed from the
+    // output cache while passes are logged or dumped.
+    void optimize(OptimizationOptions optimization);
+    // Returns the names of the passes, in the order they run.
+    static std::vector<std::string_view> passes();
+private:
+    std::size_t jobs_;
+    std::filesystem::path cache_directory_;
+    std::filesystem::path output_cache_directory_;
+    std::uintmax_t output_cache_capacity_{0};
+    OptimizationOptions optimization_;
+};
+
+
+// Session of the beeline interpreter, for embedders and interactive use.
+// One interpreter is kept alive across submissions, so the variables defined
+// by earlier declarations remain visible to later ones. Each complete
+// top-level declaration is lexed, parsed and executed once, as soon as its
+// end has been submitted, so a submission costs only its own new text.
+class Beeline::Session
+{
+public:
+    explicit Session(const std::size_t jobs = 1, const OptimizationOptions& optimization = {});
+    ~Session();
+    Session(Session&& other);
+    Session& operator=(Session&& other);
+    // Submits text continuing the text submitted so far, and executes the
+    // declarations it completes. After an error, the text still pending is
+    // discarded, but the session remains usable, and the effects of the
+    // declarations executed before the error are kept.
+    void submit(std::string_view text);
+    // Executes the if statement ended by the last newline submitted, without
+    // waiting to see whether it continues with an 'else', as submit does for
+    // every other declaration as soon as its newline arrives. Interactive input
+    // is confirmed after every line, so an 'else' must then start on the line
+    // that ends the statement it follows.
+    void confirm();
+    // Returns whether submitted text awaits the rest of its declaration.
+    bool is_pending() const;
+    // Executes the text still pending, as at the end of the input.
+    void finish();
+private:
+    // PIMPL idiom
+    class Impl;
+    std::unique_ptr<Impl> impl_;
 };
 
 
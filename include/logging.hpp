@@ -1,5 +1,10 @@
 #pragma once
 
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <boost/log/trivial.hpp>
 
 
@@ -22,6 +27,64 @@ enum struct LoggingLevel
 void init_logging(const LoggingLevel logging_level);
 
 
+// Returns whether log messages with the given logging level are printed.
+bool is_logging_enabled(const LoggingLevel logging_level);
+
+
+// Discards the log messages written by the current thread for as long as
+// it is alive, for work whose errors are reported again elsewhere.
+class LoggingSilencer
+{
+public:
+    LoggingSilencer();
+    ~LoggingSilencer();
+    LoggingSilencer(const LoggingSilencer&) = delete;
+    LoggingSilencer& operator=(const LoggingSilencer&) = delete;
+private:
+    bool was_silenced_;
+};
+
+
+// Log message kept by a LoggingRecorder.
+struct LoggedMessage
+{
+    LoggingLevel logging_level;
+    std::string text;
+};
+
+
+// Keeps a copy of the warning, error and fatal messages logged by the
+// current thread for as long as it is alive, whether or not they are printed,
+// so that they can be logged again later at whichever logging level is then
+// set. Messages discarded by a LoggingSilencer, or logged while an
+// UnrecordedLogging is alive, are not kept.
+class LoggingRecorder
+{
+public:
+    explicit LoggingRecorder(std::vector<LoggedMessage>& messages);
+    ~LoggingRecorder();
+    LoggingRecorder(const LoggingRecorder&) = delete;
+    LoggingRecorder& operator=(const LoggingRecorder&) = delete;
+private:
+    std::vector<LoggedMessage>* previous_messages_;
+};
+
+
+// Keeps the messages logged by the current thread from its LoggingRecorder
+// for as long as it is alive, for messages about the caches rather than the
+// program being run, which would be wrong to log again later.
+class UnrecordedLogging
+{
+public:
+    UnrecordedLogging();
+    ~UnrecordedLogging();
+    UnrecordedLogging(const UnrecordedLogging&) = delete;
+    UnrecordedLogging& operator=(const UnrecordedLogging&) = delete;
+private:
+    std::vector<LoggedMessage>* previous_messages_;
+};
+
+
 class LoggingStream
 {
 public:
@@ -29,6 +92,16 @@ public:
     template <typename String>
     friend const LoggingStream& operator<<(const LoggingStream& ls, const String& str)
     {
+        if (ls.silenced_)
+        {
+            return ls;
+        }
+        if (ls.recorded_messages_ && ls.logging_level_ >= LoggingLevel::WARN)
+        {
+            std::ostringstream text;
+            text << str;
+            ls.recorded_messages_->push_back(LoggedMessage{ls.logging_level_, std::move(text).str()});
+        }
         switch (ls.logging_level_)
         {
             case LoggingLevel::TRACE:
@@ -56,6 +129,8 @@ public:
     }
 private:
     LoggingLevel logging_level_;
+    bool silenced_;
+    std::vector<LoggedMessage>* recorded_messages_;
 };
 
 
@@ -2,6 +2,17 @@
 
 Generates the AST classes for the parser. Writes to stdout.
 Accepts the output programming language as a command line argument.
+
+By default, nodes own their children through std::unique_ptr. With --arena,
+nodes are allocated from the Arena of the program they belong to and refer
+to their children through plain pointers, so that the whole AST is freed in
+one step. With --static-dispatch, nodes also record their kind, and dispatch
+functions switch on it to call a function object with the concrete node,
+whose results are returned directly. The virtual visitors remain available
+either way. The sources in src/ are generated with:
+
+    python scripts/generate_ast.py hpp --arena --static-dispatch > src/ast.hpp
+    python scripts/generate_ast.py cpp --arena --static-dispatch --header '"ast.hpp"' > src/ast.cpp
 """
 
 import abc
@@ -19,6 +30,18 @@ class Field:
         self.type = type
 
 
+class Child:
+    """A single child node, which may be absent."""
+    def __init__(self, abc):
+        self.abc = abc
+
+
+class Children:
+    """A sequence of child nodes."""
+    def __init__(self, abc):
+        self.abc = abc
+
+
 class Type:
     def __init__(
         self,
@@ -47,19 +70,22 @@ STATEMENT = ABC("Statement")
 
 TYPES = [
     EXPRESSION,
-    Type("Binary", [Field("left", "std::unique_ptr<Expression>"), Field("op", "Token"), Field("right", "std::unique_ptr<Expression>")], EXPRESSION),
-    Type("Grouping", [Field("expression", "std::unique_ptr<Expression>")], EXPRESSION),
+    Type("Binary", [Field("left", Child(EXPRESSION)), Field("op", "Token"), Field("right", Child(EXPRESSION))], EXPRESSION),
+    Type("Grouping", [Field("expression", Child(EXPRESSION))], EXPRESSION),
     Type("Literal", [Field("value", "Token::Literal")], EXPRESSION),
-    Type("Unary", [Field("op", "Token"), Field("right", "std::unique_ptr<Expression>")], EXPRESSION),
+    Type("Unary", [Field("op", "Token"), Field("right", Child(EXPRESSION))], EXPRESSION),
     Type("Variable", [Field("name", "Token")], EXPRESSION),
-    Type("Assignment", [Field("name", "Token"), Field("value", "std::unique_ptr<Expression>")], EXPRESSION),
+    Type("Assignment", [Field("name", "Token"), Field("value", Child(EXPRESSION))], EXPRESSION),
     STATEMENT,
-    Type("Expression", [Field("expression", "std::unique_ptr<::Expression>")], STATEMENT),
-    Type("Print", [Field("keyword", "Token"), Field("expression", "std::unique_ptr<::Expression>")], STATEMENT),
-    Type("VariableDeclaration", [Field("name", "Token"), Field("initializer", "std::unique_ptr<::Expression>")], STATEMENT),
-    Type("Block", [Field("statements", "std::vector<std::unique_ptr<Statement>>")], STATEMENT),
-    Type("IfElse", [Field("condition", "std::unique_ptr<::Expression>"), Field("if_keyword", "Token"), Field("then_statement", "std::unique_ptr<Statement>"), Field("else_keyword", "std::optional<Token>"), Field("else_statement", "std::unique_ptr<Statement>")], STATEMENT),
-    Type("WhileLoop", [Field("keyword", "Token"), Field("condition", "std::unique_ptr<::Expression>"), Field("body", "std::unique_ptr<Statement>")], STATEMENT),
+    Type("Expression", [Field("expression", Child(EXPRESSION))], STATEMENT),
+    Type("Print", [Field("keyword", "Token"), Field("expression", Child(EXPRESSION))], STATEMENT),
+    Type("VariableDeclaration", [Field("name", "Token"), Field("initializer", Child(EXPRESSION))], STATEMENT),
+    Type("Block", [Field("statements", Children(STATEMENT))], STATEMENT),
+    # Stands in for a block whose body is parsed the first time it is executed,
+    # together with the variables the body refers to from outside it.
+    Type("LazyBlock", [Field("left_brace", "Token"), Field("right_brace", "Token"), Field("free_variables", Children(EXPRESSION))], STATEMENT),
+    Type("IfElse", [Field("condition", Child(EXPRESSION)), Field("if_keyword", "Token"), Field("then_statement", Child(STATEMENT)), Field("else_keyword", "std::optional<Token>"), Field("else_statement", Child(STATEMENT))], STATEMENT),
+    Type("WhileLoop", [Field("keyword", "Token"), Field("condition", Child(EXPRESSION)), Field("body", Child(STATEMENT))], STATEMENT),
 ]
 
 
@@ -69,8 +95,10 @@ def to_snake_case(s: str) -> str:
 
 
 class AstMetaProgrammer(abc.ABC):
-    def __init__(self, types: list[Type]):
+    def __init__(self, types: list[Type], arena: bool = False, static_dispatch: bool = False):
         self._types = types
+        self._arena = arena
+        self._static_dispatch = static_dispatch
         self._visitable_types_by_parent = {}
         for t in self._types:
             if isinstance(t, ABC):
@@ -79,12 +107,27 @@ class AstMetaProgrammer(abc.ABC):
                 self._visitable_types_by_parent[t.parent] = []
             self._visitable_types_by_parent[t.parent].append(t)
 
+    def field_type(self, t: Type, field: Field) -> str:
+        if isinstance(field.type, str):
+            return field.type
+        name = field.type.abc.name
+        # Nested classes of the parent shadow the base class they share a name with.
+        if t.parent != field.type.abc and any(sub_t.name == name for sub_t in self._visitable_types_by_parent[t.parent]):
+            name = f"::{name}"
+        if isinstance(field.type, Children):
+            return f"std::span<{name}*>" if self._arena else f"std::vector<std::unique_ptr<{name}>>"
+        return f"{name}*" if self._arena else f"std::unique_ptr<{name}>"
+
+    def kind(self, t: Type) -> str:
+        return to_snake_case(t.name).upper()
+
     def generate(self) -> str:
         return "".join([
             self.generate_docstring(),
             self.generate_includes(),
             self.generate_ast_classes(),
             self.generate_visitors(),
+            self.generate_dispatchers(),
             "\n"
         ])
 
@@ -104,13 +147,18 @@ class AstMetaProgrammer(abc.ABC):
     def generate_visitors(self) -> str:
         pass
 
+    def generate_dispatchers(self) -> str:
+        return ""
+
 
 class CppAstMetaProgrammer(AstMetaProgrammer):
     def __init__(self, types: list[Type], cli_args):
-        super().__init__(types)
         parser = argparse.ArgumentParser()
         parser.add_argument("--header", required=True)
+        parser.add_argument("--arena", action="store_true")
+        parser.add_argument("--static-dispatch", action="store_true")
         args = parser.parse_args(cli_args)
+        super().__init__(types, args.arena, args.static_dispatch)
         self._header = args.header
 
 
@@ -136,9 +184,12 @@ class CppAstMetaProgrammer(AstMetaProgrammer):
     def generate_ast_class_methods(self, t: Type):
         if isinstance(t, ABC):
             return ""
+        initializers = [f"{field.name}{{std::move({field.name})}}" for field in t.fields]
+        if self._static_dispatch:
+            initializers.insert(0, f"{t.parent.name}{{Kind::{self.kind(t)}}}")
         return "".join([
             "\n\n",
-            f"\n{t.parent.name}::{t.name}::{t.name}({', '.join (f'{field.type} {field.name}' for field in t.fields)}) : {', '.join (f'{field.name}{{std::move({field.name})}}' for field in t.fields)} {{}}",
+            f"\n{t.parent.name}::{t.name}::{t.name}({', '.join (f'{self.field_type(t, field)} {field.name}' for field in t.fields)}) : {', '.join(initializers)} {{}}",
             f"\nvoid {t.parent.name}::{t.name}::accept({t.parent.name}::Visitor& visitor) const {{ visitor.visit(*this); }}"
         ])
 
@@ -148,12 +199,32 @@ class CppAstMetaProgrammer(AstMetaProgrammer):
 
 class HppAstMetaProgrammer(AstMetaProgrammer):
     def __init__(self, types: list[Type], cli_args):
-        super().__init__(types)
+        parser = argparse.ArgumentParser()
+        parser.add_argument("--arena", action="store_true")
+        parser.add_argument("--static-dispatch", action="store_true")
+        args = parser.parse_args(cli_args)
+        super().__init__(types, args.arena, args.static_dispatch)
 
     def generate_docstring(self):
         return "/*\n * This file was generated by the generate_ast.py script.\n */"
 
     def generate_includes(self):
+        if self._arena and self._static_dispatch:
+            return "".join([
+                "\n\n#pragma once",
+                "\n\n#include <cassert>",
+                "\n#include <cstdint>",
+                "\n#include <optional>",
+                "\n#include <span>",
+                "\n\n#include \"lexer.hpp\"",
+            ])
+        if self._arena:
+            return "".join([
+                "\n\n#pragma once",
+                "\n\n#include <optional>",
+                "\n#include <span>",
+                "\n\n#include \"lexer.hpp\"",
+            ])
         return "".join([
             "\n\n#pragma once",
             "\n\n#include <memory>",
@@ -184,23 +255,41 @@ class HppAstMetaProgrammer(AstMetaProgrammer):
     def generate_ast_class_types(self, t: Type):
         if not isinstance(t, ABC):
             return ""
-        return "\n".join([""] + ["    class Visitor;"] + [f"    class {sub_t.name};" for sub_t in self._types if sub_t.parent == t])
+        declarations = "\n".join([""] + ["    class Visitor;"] + [f"    class {sub_t.name};" for sub_t in self._types if sub_t.parent == t])
+        if not self._static_dispatch:
+            return declarations
+        return "".join([
+            declarations,
+            "\n    enum struct Kind : std::uint8_t\n    {",
+            "".join(f"\n        {self.kind(sub_t)}," for sub_t in self._visitable_types_by_parent[t]),
+            "\n    };",
+            "\n    const Kind kind;",
+        ])
 
     def generate_ast_class_methods(self, t: Type):
+        if isinstance(t, ABC) and self._arena:
+            # Nodes are never deleted through a base pointer, and a trivial
+            # destructor lets the arena skip destroying most nodes.
+            return "".join([
+                "\n    virtual void accept(Visitor& visitor) const = 0;",
+                "\nprotected:",
+                f"\n    {t.name}(const Kind kind) : kind{{kind}} {{}}" if self._static_dispatch else "",
+                f"\n    ~{t.name}() = default;",
+            ])
         if isinstance(t, ABC):
             return "".join([
                 f"\n    virtual ~{t.name}() = default;",
                 "\n    virtual void accept(Visitor& visitor) const = 0;",
             ])
         return "".join([
-            f"\n    {t.name}({', '.join (f'{field.type} {field.name}' for field in t.fields)});",
+            f"\n    {t.name}({', '.join (f'{self.field_type(t, field)} {field.name}' for field in t.fields)});",
             f"\n    void accept({t.parent.name}::Visitor& visitor) const override;",
         ])
 
     def generate_ast_class_fields(self, t: Type):
         if isinstance(t, ABC):
             return ""
-        return "\n".join([""] + [f"    {field.type} {field.name};" for field in t.fields])
+        return "\n".join([""] + [f"    {self.field_type(t, field)} {field.name};" for field in t.fields])
 
     def generate_ast_class_footer(self, t: Type):
         return "\n};"
@@ -235,6 +324,38 @@ class HppAstMetaProgrammer(AstMetaProgrammer):
     def generate_visitor_footer(self, t: Type):
         return "\n};"
 
+    def generate_dispatchers(self):
+        if not self._static_dispatch:
+            return ""
+        return "".join([
+            self.generate_dispatcher(t, qualifier)
+            for t in self._visitable_types_by_parent.keys()
+            for qualifier in ["const ", ""]
+        ])
+
+    def generate_dispatcher(self, t: Type, qualifier: str):
+        return "".join(
+            [
+                f"\n\n\n// Calls the given function with the {to_snake_case(t.name)} cast to its concrete type, switching",
+                "\n// on its kind rather than calling a virtual function. Returns the result of the function.",
+                "\ntemplate <typename Function>",
+                f"\ndecltype(auto) dispatch({qualifier}{t.name}& {to_snake_case(t.name)}, Function&& function)",
+                "\n{",
+                f"\n    switch ({to_snake_case(t.name)}.kind)",
+                "\n    {",
+            ]
+            + [
+                f"\n        case {t.name}::Kind::{self.kind(v_t)}: return function(static_cast<{qualifier}{t.name}::{v_t.name}&>({to_snake_case(t.name)}));"
+                for v_t in self._visitable_types_by_parent.get(t)
+            ]
+            + [
+                "\n    }",
+                f"\n    assert(false && \"unhandled {to_snake_case(t.name)} kind\");",
+                "\n    __builtin_unreachable();",
+                "\n}",
+            ]
+        )
+
 
 def parse_args():
     parser = argparse.ArgumentParser(
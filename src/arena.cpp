@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
+#include "arena.hpp"
+
+
+// Blocks double in size up to this limit, so small programs stay small while
+// large ones allocate rarely.
+constexpr std::size_t MAXIMUM_BLOCK_SIZE = 1 << 20;
+
+
+Arena::~Arena()
+{
+    destroy();
+}
+
+
+void Arena::merge(Arena&& other)
+{
+    // The blocks of the other arena go first, so that this one keeps carving
+    // objects out of its current block.
+    blocks_.insert(blocks_.begin(), std::make_move_iterator(other.blocks_.begin()), std::make_move_iterator(other.blocks_.end()));
+    finalizers_.insert(finalizers_.end(), other.finalizers_.begin(), other.finalizers_.end());
+    other.blocks_.clear();
+    other.finalizers_.clear();
+    other.current_ = nullptr;
+    other.end_ = nullptr;
+}
+
+
+void Arena::clear()
+{
+    destroy();
+    finalizers_.clear();
+    if (current_ == nullptr)
+    {
+        // Any blocks were merged in; none is being carved.
+        blocks_.clear();
+        return;
+    }
+    blocks_.erase(blocks_.begin(), blocks_.end() - 1);
+    current_ = blocks_.back().get();
+}
+
+
+void Arena::grow(const std::size_t size)
+{
+    const std::size_t block_size = std::max(next_block_size_, size);
+    next_block_size_ = std::min(next_block_size_ * 2, MAXIMUM_BLOCK_SIZE);
+    blocks_.push_back(std::make_unique_for_overwrite<std::byte[]>(block_size));
+    current_ = blocks_.back().get();
+    end_ = current_ + block_size;
+}
+
+
+void Arena::destroy()
+{
+    // Objects are destroyed in the reverse order of their construction.
+    for (auto it = finalizers_.rbegin(); it != finalizers_.rend(); ++it)
+    {
+        it->destroy(it->object);
+    }
+}
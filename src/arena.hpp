@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Bump allocator owning the nodes of an AST. Objects are carved out of large
+// blocks and released together when the arena is destroyed, instead of being
+// allocated and freed one by one. Only the objects that are not trivially
+// destructible are destroyed individually.
+class Arena
+{
+public:
+    Arena() = default;
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    // Constructs an object of the given type in the arena.
+    template <typename T, typename... Arguments>
+    T* make(Arguments&&... arguments)
+    {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Arguments>(arguments)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            finalizers_.push_back(Finalizer{object, [](void* object) { static_cast<T*>(object)->~T(); }});
+        }
+        return object;
+    }
+    // Copies the given values into the arena.
+    template <typename T>
+    std::span<T> copy(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+        if (values.empty())
+        {
+            return {};
+        }
+        T* copies = static_cast<T*>(allocate(sizeof(T) * values.size(), alignof(T)));
+        std::uninitialized_copy(values.begin(), values.end(), copies);
+        return {copies, values.size()};
+    }
+    // Takes over the objects of the given arena, which is left empty.
+    void merge(Arena&& other);
+    // Destroys all objects. Keeps the most recent block for reuse, so that an
+    // arena cleared between uses stops allocating once it has grown.
+    void clear();
+private:
+    struct Finalizer
+    {
+        void* object;
+        void (*destroy)(void*);
+    };
+    // The block objects are currently carved out of is always the last one.
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* current_{nullptr};
+    std::byte* end_{nullptr};
+    std::size_t next_block_size_{4096};
+    std::vector<Finalizer> finalizers_;
+    void* allocate(const std::size_t size, const std::size_t alignment)
+    {
+        std::byte* start = align(current_, alignment);
+        if (current_ == nullptr || end_ - start < static_cast<std::ptrdiff_t>(size))
+        {
+            grow(size + alignment);
+            start = align(current_, alignment);
+        }
+        current_ = start + size;
+        return start;
+    }
+    static std::byte* align(std::byte* pointer, const std::size_t alignment)
+    {
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(pointer);
+        return pointer + ((alignment - address % alignment) % alignment);
+    }
+    // Starts a new block with room for at least the given number of bytes.
+    void grow(const std::size_t size);
+    void destroy();
+};
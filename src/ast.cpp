@@ -7,49 +7,53 @@
 #include "ast.hpp"
 
 
-Expression::Binary::Binary(std::unique_ptr<Expression> left, Token op, std::unique_ptr<Expression> right) : left{std::move(left)}, op{std::move(op)}, right{std::move(right)} {}
+Expression::Binary::Binary(Expression* left, Token op, Expression* right) : Expression{Kind::BINARY}, left{std::move(left)}, op{std::move(op)}, right{std::move(right)} {}
 void Expression::Binary::accept(Expression::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Expression::Grouping::Grouping(std::unique_ptr<Expression> expression) : expression{std::move(expression)} {}
+Expression::Grouping::Grouping(Expression* expression) : Expression{Kind::GROUPING}, expression{std::move(expression)} {}
 void Expression::Grouping::accept(Expression::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Expression::Literal::Literal(Token::Literal value) : value{std::move(value)} {}
+Expression::Literal::Literal(Token::Literal value) : Expression{Kind::LITERAL}, value{std::move(value)} {}
 void Expression::Literal::accept(Expression::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Expression::Unary::Unary(Token op, std::unique_ptr<Expression> right) : op{std::move(op)}, right{std::move(right)} {}
+Expression::Unary::Unary(Token op, Expression* right) : Expression{Kind::UNARY}, op{std::move(op)}, right{std::move(right)} {}
 void Expression::Unary::accept(Expression::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Expression::Variable::Variable(Token name) : name{std::move(name)} {}
+Expression::Variable::Variable(Token name) : Expression{Kind::VARIABLE}, name{std::move(name)} {}
 void Expression::Variable::accept(Expression::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Expression::Assignment::Assignment(Token name, std::unique_ptr<Expression> value) : name{std::move(name)}, value{std::move(value)} {}
+Expression::Assignment::Assignment(Token name, Expression* value) : Expression{Kind::ASSIGNMENT}, name{std::move(name)}, value{std::move(value)} {}
 void Expression::Assignment::accept(Expression::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Statement::Expression::Expression(std::unique_ptr<::Expression> expression) : expression{std::move(expression)} {}
+Statement::Expression::Expression(::Expression* expression) : Statement{Kind::EXPRESSION}, expression{std::move(expression)} {}
 void Statement::Expression::accept(Statement::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Statement::Print::Print(Token keyword, std::unique_ptr<::Expression> expression) : keyword{std::move(keyword)}, expression{std::move(expression)} {}
+Statement::Print::Print(Token keyword, ::Expression* expression) : Statement{Kind::PRINT}, keyword{std::move(keyword)}, expression{std::move(expression)} {}
 void Statement::Print::accept(Statement::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Statement::VariableDeclaration::VariableDeclaration(Token name, std::unique_ptr<::Expression> initializer) : name{std::move(name)}, initializer{std::move(initializer)} {}
+Statement::VariableDeclaration::VariableDeclaration(Token name, ::Expression* initializer) : Statement{Kind::VARIABLE_DECLARATION}, name{std::move(name)}, initializer{std::move(initializer)} {}
 void Statement::VariableDeclaration::accept(Statement::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Statement::Block::Block(std::vector<std::unique_ptr<Statement>> statements) : statements{std::move(statements)} {}
+Statement::Block::Block(std::span<Statement*> statements) : Statement{Kind::BLOCK}, statements{std::move(statements)} {}
 void Statement::Block::accept(Statement::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Statement::IfElse::IfElse(std::unique_ptr<::Expression> condition, Token if_keyword, std::unique_ptr<Statement> then_statement, std::optional<Token> else_keyword, std::unique_ptr<Statement> else_statement) : condition{std::move(condition)}, if_keyword{std::move(if_keyword)}, then_statement{std::move(then_statement)}, else_keyword{std::move(else_keyword)}, else_statement{std::move(else_statement)} {}
+Statement::LazyBlock::LazyBlock(Token left_brace, Token right_brace, std::span<::Expression*> free_variables) : Statement{Kind::LAZY_BLOCK}, left_brace{std::move(left_brace)}, right_brace{std::move(right_brace)}, free_variables{std::move(free_variables)} {}
+void Statement::LazyBlock::accept(Statement::Visitor& visitor) const { visitor.visit(*this); }
+
+
+Statement::IfElse::IfElse(::Expression* condition, Token if_keyword, Statement* then_statement, std::optional<Token> else_keyword, Statement* else_statement) : Statement{Kind::IF_ELSE}, condition{std::move(condition)}, if_keyword{std::move(if_keyword)}, then_statement{std::move(then_statement)}, else_keyword{std::move(else_keyword)}, else_statement{std::move(else_statement)} {}
 void Statement::IfElse::accept(Statement::Visitor& visitor) const { visitor.visit(*this); }
 
 
-Statement::WhileLoop::WhileLoop(Token keyword, std::unique_ptr<::Expression> condition, std::unique_ptr<Statement> body) : keyword{std::move(keyword)}, condition{std::move(condition)}, body{std::move(body)} {}
+Statement::WhileLoop::WhileLoop(Token keyword, ::Expression* condition, Statement* body) : Statement{Kind::WHILE_LOOP}, keyword{std::move(keyword)}, condition{std::move(condition)}, body{std::move(body)} {}
 void Statement::WhileLoop::accept(Statement::Visitor& visitor) const { visitor.visit(*this); }
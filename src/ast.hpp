@@ -4,8 +4,10 @@
 
 #pragma once
 
-#include <memory>
+#include <cassert>
+#include <cstdint>
 #include <optional>
+#include <span>
 
 #include "lexer.hpp"
 
@@ -19,26 +21,38 @@ struct Expression
     class Unary;
     class Variable;
     class Assignment;
-    virtual ~Expression() = default;
+    enum struct Kind : std::uint8_t
+    {
+        BINARY,
+        GROUPING,
+        LITERAL,
+        UNARY,
+        VARIABLE,
+        ASSIGNMENT,
+    };
+    const Kind kind;
     virtual void accept(Visitor& visitor) const = 0;
+protected:
+    Expression(const Kind kind) : kind{kind} {}
+    ~Expression() = default;
 };
 
 
 struct Expression::Binary : Expression
 {
-    Binary(std::unique_ptr<Expression> left, Token op, std::unique_ptr<Expression> right);
+    Binary(Expression* left, Token op, Expression* right);
     void accept(Expression::Visitor& visitor) const override;
-    std::unique_ptr<Expression> left;
+    Expression* left;
     Token op;
-    std::unique_ptr<Expression> right;
+    Expression* right;
 };
 
 
 struct Expression::Grouping : Expression
 {
-    Grouping(std::unique_ptr<Expression> expression);
+    Grouping(Expression* expression);
     void accept(Expression::Visitor& visitor) const override;
-    std::unique_ptr<Expression> expression;
+    Expression* expression;
 };
 
 
@@ -52,10 +66,10 @@ struct Expression::Literal : Expression
 
 struct Expression::Unary : Expression
 {
-    Unary(Token op, std::unique_ptr<Expression> right);
+    Unary(Token op, Expression* right);
     void accept(Expression::Visitor& visitor) const override;
     Token op;
-    std::unique_ptr<Expression> right;
+    Expression* right;
 };
 
 
@@ -69,10 +83,10 @@ struct Expression::Variable : Expression
 
 struct Expression::Assignment : Expression
 {
-    Assignment(Token name, std::unique_ptr<Expression> value);
+    Assignment(Token name, Expression* value);
     void accept(Expression::Visitor& visitor) const override;
     Token name;
-    std::unique_ptr<Expression> value;
+    Expression* value;
 };
 
 
@@ -83,66 +97,90 @@ struct Statement
     class Print;
     class VariableDeclaration;
     class Block;
+    class LazyBlock;
     class IfElse;
     class WhileLoop;
-    virtual ~Statement() = default;
+    enum struct Kind : std::uint8_t
+    {
+        EXPRESSION,
+        PRINT,
+        VARIABLE_DECLARATION,
+        BLOCK,
+        LAZY_BLOCK,
+        IF_ELSE,
+        WHILE_LOOP,
+    };
+    const Kind kind;
     virtual void accept(Visitor& visitor) const = 0;
+protected:
+    Statement(const Kind kind) : kind{kind} {}
+    ~Statement() = default;
 };
 
 
 struct Statement::Expression : Statement
 {
-    Expression(std::unique_ptr<::Expression> expression);
+    Expression(::Expression* expression);
     void accept(Statement::Visitor& visitor) const override;
-    std::unique_ptr<::Expression> expression;
+    ::Expression* expression;
 };
 
 
 struct Statement::Print : Statement
 {
-    Print(Token keyword, std::unique_ptr<::Expression> expression);
+    Print(Token keyword, ::Expression* expression);
     void accept(Statement::Visitor& visitor) const override;
     Token keyword;
-    std::unique_ptr<::Expression> expression;
+    ::Expression* expression;
 };
 
 
 struct Statement::VariableDeclaration : Statement
 {
-    VariableDeclaration(Token name, std::unique_ptr<::Expression> initializer);
+    VariableDeclaration(Token name, ::Expression* initializer);
     void accept(Statement::Visitor& visitor) const override;
     Token name;
-    std::unique_ptr<::Expression> initializer;
+    ::Expression* initializer;
 };
 
 
 struct Statement::Block : Statement
 {
-    Block(std::vector<std::unique_ptr<Statement>> statements);
+    Block(std::span<Statement*> statements);
     void accept(Statement::Visitor& visitor) const override;
-    std::vector<std::unique_ptr<Statement>> statements;
+    std::span<Statement*> statements;
+};
+
+
+struct Statement::LazyBlock : Statement
+{
+    LazyBlock(Token left_brace, Token right_brace, std::span<::Expression*> free_variables);
+    void accept(Statement::Visitor& visitor) const override;
+    Token left_brace;
+    Token right_brace;
+    std::span<::Expression*> free_variables;
 };
 
 
 struct Statement::IfElse : Statement
 {
-    IfElse(std::unique_ptr<::Expression> condition, Token if_keyword, std::unique_ptr<Statement> then_statement, std::optional<Token> else_keyword, std::unique_ptr<Statement> else_statement);
+    IfElse(::Expression* condition, Token if_keyword, Statement* then_statement, std::optional<Token> else_keyword, Statement* else_statement);
     void accept(Statement::Visitor& visitor) const override;
-    std::unique_ptr<::Expression> condition;
+    ::Expression* condition;
     Token if_keyword;
-    std::unique_ptr<Statement> then_statement;
+    Statement* then_statement;
     std::optional<Token> else_keyword;
-    std::unique_ptr<Statement> else_statement;
+    Statement* else_statement;
 };
 
 
 struct Statement::WhileLoop : Statement
 {
-    WhileLoop(Token keyword, std::unique_ptr<::Expression> condition, std::unique_ptr<Statement> body);
+    WhileLoop(Token keyword, ::Expression* condition, Statement* body);
     void accept(Statement::Visitor& visitor) const override;
     Token keyword;
-    std::unique_ptr<::Expression> condition;
-    std::unique_ptr<Statement> body;
+    ::Expression* condition;
+    Statement* body;
 };
 
 
@@ -165,6 +203,85 @@ public:
     virtual void visit(const Statement::Print& print) = 0;
     virtual void visit(const Statement::VariableDeclaration& variable_declaration) = 0;
     virtual void visit(const Statement::Block& block) = 0;
+    virtual void visit(const Statement::LazyBlock& lazy_block) = 0;
     virtual void visit(const Statement::IfElse& if_else) = 0;
     virtual void visit(const Statement::WhileLoop& while_loop) = 0;
 };
+
+
+// Calls the given function with the expression cast to its concrete type, switching
+// on its kind rather than calling a virtual function. Returns the result of the function.
+template <typename Function>
+decltype(auto) dispatch(const Expression& expression, Function&& function)
+{
+    switch (expression.kind)
+    {
+        case Expression::Kind::BINARY: return function(static_cast<const Expression::Binary&>(expression));
+        case Expression::Kind::GROUPING: return function(static_cast<const Expression::Grouping&>(expression));
+        case Expression::Kind::LITERAL: return function(static_cast<const Expression::Literal&>(expression));
+        case Expression::Kind::UNARY: return function(static_cast<const Expression::Unary&>(expression));
+        case Expression::Kind::VARIABLE: return function(static_cast<const Expression::Variable&>(expression));
+        case Expression::Kind::ASSIGNMENT: return function(static_cast<const Expression::Assignment&>(expression));
+    }
+    assert(false && "unhandled expression kind");
+    __builtin_unreachable();
+}
+
+
+// Calls the given function with the expression cast to its concrete type, switching
+// on its kind rather than calling a virtual function. Returns the result of the function.
+template <typename Function>
+decltype(auto) dispatch(Expression& expression, Function&& function)
+{
+    switch (expression.kind)
+    {
+        case Expression::Kind::BINARY: return function(static_cast<Expression::Binary&>(expression));
+        case Expression::Kind::GROUPING: return function(static_cast<Expression::Grouping&>(expression));
+        case Expression::Kind::LITERAL: return function(static_cast<Expression::Literal&>(expression));
+        case Expression::Kind::UNARY: return function(static_cast<Expression::Unary&>(expression));
+        case Expression::Kind::VARIABLE: return function(static_cast<Expression::Variable&>(expression));
+        case Expression::Kind::ASSIGNMENT: return function(static_cast<Expression::Assignment&>(expression));
+    }
+    assert(false && "unhandled expression kind");
+    __builtin_unreachable();
+}
+
+
+// Calls the given function with the statement cast to its concrete type, switching
+// on its kind rather than calling a virtual function. Returns the result of the function.
+template <typename Function>
+decltype(auto) dispatch(const Statement& statement, Function&& function)
+{
+    switch (statement.kind)
+    {
+        case Statement::Kind::EXPRESSION: return function(static_cast<const Statement::Expression&>(statement));
+        case Statement::Kind::PRINT: return function(static_cast<const Statement::Print&>(statement));
+        case Statement::Kind::VARIABLE_DECLARATION: return function(static_cast<const Statement::VariableDeclaration&>(statement));
+        case Statement::Kind::BLOCK: return function(static_cast<const Statement::Block&>(statement));
+        case Statement::Kind::LAZY_BLOCK: return function(static_cast<const Statement::LazyBlock&>(statement));
+        case Statement::Kind::IF_ELSE: return function(static_cast<const Statement::IfElse&>(statement));
+        case Statement::Kind::WHILE_LOOP: return function(static_cast<const Statement::WhileLoop&>(statement));
+    }
+    assert(false && "unhandled statement kind");
+    __builtin_unreachable();
+}
+
+
+// Calls the given function with the statement cast to its concrete type, switching
+// on its kind rather than calling a virtual function. Returns the result of the function.
+template <typename Function>
+decltype(auto) dispatch(Statement& statement, Function&& function)
+{
+    switch (statement.kind)
+    {
+        case Statement::Kind::EXPRESSION: return function(static_cast<Statement::Expression&>(statement));
+        case Statement::Kind::PRINT: return function(static_cast<Statement::Print&>(statement));
+        case Statement::Kind::VARIABLE_DECLARATION: return function(static_cast<Statement::VariableDeclaration&>(statement));
+        case Statement::Kind::BLOCK: return function(static_cast<Statement::Block&>(statement));
+        case Statement::Kind::LAZY_BLOCK: return function(static_cast<Statement::LazyBlock&>(statement));
+        case Statement::Kind::IF_ELSE: return function(static_cast<Statement::IfElse&>(statement));
+        case Statement::Kind::WHILE_LOOP: return function(static_cast<Statement::WhileLoop&>(statement));
+    }
+    assert(false && "unhandled statement kind");
+    __builtin_unreachable();
+}
@@ -1,10 +1,26 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <thread>
+
 #include "beeline.hpp"
+#include "source.hpp"
 #include "lexer.hpp"
 #include "logging.hpp"
 #include "parser.hpp"
 #include "ast.hpp"
 #include "stringify.hpp"
 #include "interpreter.hpp"
+#include "resolver.hpp"
+#include "splitter.hpp"
+#include "parallel_parser.hpp"
+#include "flat_ast.hpp"
+#include "program_cache.hpp"
+#include "output_cache.hpp"
+#include "pass_manager.hpp"
+#include "type_checker.hpp"
 
 
 BeelineError::BeelineError(const std::string& message) : std::runtime_error(message) {}
@@ -16,39 +32,344 @@ std::ostream& operator<<(std::ostream& os, const BeelineError& be)
 }
 
 
-void Beeline::run(const std::string& input)
+// Runs the given function, propagating internal errors to the user as BeelineErrors.
+template <typename Function>
+void propagate_errors(Function&& function)
 {
     try
     {
-        std::vector<Token> tokens = Lexer{input}.scan();
+        function();
+    }
+    catch (const BeelineSyntaxError& bse)
+    {
+        throw BeelineError{bse.what()};
+    }
+    catch (const BeelineParseError& bpe)
+    {
+        throw BeelineError{bpe.what()};
+    }
+    catch (const BeelineResolveError& bre)
+    {
+        throw BeelineError{bre.what()};
+    }
+    catch (const BeelineTypeError& bte)
+    {
+        throw BeelineError{bte.what()};
+    }
+    catch (const BeelineRuntimeError& bre)
+    {
+        throw BeelineError{bre.what()};
+    }
+}
+
 
-        for (const Token& token : tokens)
+// Sources smaller than this are lexed and parsed on a single thread, since
+// splitting them up would cost more than it saves.
+constexpr std::size_t MINIMUM_PARALLEL_PARSE_SIZE = 1 << 20;
+// Smallest chunk of a source lexed and parsed by one task.
+constexpr std::size_t MINIMUM_PARALLEL_PARSE_CHUNK_SIZE = 1 << 16;
+
+
+// Lexes and parses the given source into a program, logging the
+// intermediate tokens and statements. Unless the intermediate results are
+// logged, which must happen in order and in full, large sources are lexed
+// and parsed on the given number of threads, and large block bodies are
+// parsed lazily.
+Program parse(Source source, const std::size_t jobs)
+{
+    const bool lazy = !is_logging_enabled(LoggingLevel::DEBUG);
+    if (jobs > 1 && source.text().size() >= MINIMUM_PARALLEL_PARSE_SIZE && lazy)
+    {
+        // A few chunks per thread even out the differences between chunks.
+        const std::size_t chunk_size = std::max(source.text().size() / (jobs * 4), MINIMUM_PARALLEL_PARSE_CHUNK_SIZE);
+        if (std::optional<Program> program = parse_in_parallel(source, jobs, chunk_size, lazy))
         {
-            log(LoggingLevel::DEBUG) << token;
+            return std::move(*program);
         }
+        // Parsing serially reports the errors in order.
+    }
+
+
+    // The tokens and the program share the source, which they refer into.
+    TokenStream tokens = Lexer{std::move(source)}.scan();
+
+    for (std::size_t i = 0; i < tokens.size(); ++i)
+    {
+        log(LoggingLevel::DEBUG) << tokens[i];
+    }
 
-        std::vector<std::unique_ptr<Statement>> statements = Parser{tokens}.parse();
+    Program program = Parser{std::move(tokens), lazy}.parse();
 
-        for (const std::unique_ptr<Statement>& statement : statements)
+    for (const Statement* statement : program.statements)
+    {
+        ExpressionToString visitor;
+        statement->accept(visitor);
+        log(LoggingLevel::DEBUG) << visitor.str();
+    }
+
+    return program;
+}
+
+
+// Compiles the given source into the flat form the interpreter executes.
+// With a cache directory, the flat form is loaded from the program cache if
+// it holds the source, and stored there otherwise. The cache is bypassed
+// while the intermediate results of parsing are logged.
+FlatAst compile(Source source, const std::size_t jobs, const std::filesystem::path& cache_directory)
+{
+    if (cache_directory.empty() || is_logging_enabled(LoggingLevel::DEBUG))
+    {
+        return lower(parse(std::move(source), jobs));
+    }
+    const ProgramCache cache{cache_directory};
+    if (std::optional<FlatAst> ast = cache.load(source))
+    {
+        return std::move(*ast);
+    }
+    FlatAst ast = lower(parse(std::move(source), jobs));
+    cache.store(ast);
+    return ast;
+}
+
+
+// Runs the given function, which runs the given sources, propagating
+// internal errors as BeelineErrors. With an output cache directory, the
+// result of the run is replayed from the output cache if it holds the
+// sources run with the given optimization options, and recorded there
+// otherwise. The cache is bypassed while the intermediate results of parsing
+// are logged.
+template <typename Function>
+void run_through_output_cache(const std::filesystem::path& directory, const std::uintmax_t capacity, const OptimizationOptions& optimization, const std::vector<Source>& sources, Function&& function)
+{
+    if (directory.empty() || is_logging_enabled(LoggingLevel::DEBUG))
+    {
+        propagate_errors(function);
+        return;
+    }
+    const OutputCache cache{directory, capacity, optimization};
+    std::optional<OutputCache::Result> result = cache.load(sources);
+    if (result)
+    {
+        std::cout << result->output;
+        // The messages were recorded whatever the logging level was, and are
+        // filtered by the current one.
+        for (const LoggedMessage& message : result->messages)
         {
-            ExpressionToString visitor;
-            statement->accept(visitor);
-            log(LoggingLevel::DEBUG) << visitor.str();
+            log(message.logging_level) << message.text;
         }
+    }
+    else
+    {
+        result.emplace();
+        bool overflowed = false;
+        {
+            OutputRecorder output_recorder{std::cout, result->output, cache.capacity()};
+            LoggingRecorder logging_recorder{result->messages};
+            try
+            {
+                propagate_errors(function);
+            }
+            catch (const BeelineError& be)
+            {
+                result->failure = be.what();
+            }
+            overflowed = output_recorder.overflowed();
+        }
+        if (!overflowed)
+        {
+            cache.store(sources, *result);
+        }
+    }
+    if (result->failure)
+    {
+        throw BeelineError{*result->failure};
+    }
+}
 
-        Interpreter{}.interpret(std::move(statements));
+
+// Returns the output cache directory to run programs through, which is
+// empty while the passes optimizing them are logged or dumped, since replayed
+// programs are not optimized.
+std::filesystem::path output_cache_directory_for(const std::filesystem::path& directory, const OptimizationOptions& optimization)
+{
+    if (!optimization.dump_after.empty() || is_logging_enabled(LoggingLevel::INFO))
+    {
+        return {};
     }
-    // propagate internal errors to the user as BeelineErrors
-    catch (const BeelineSyntaxError& bse)
+    return directory;
+}
+
+
+Beeline::Beeline(const std::size_t jobs, std::filesystem::path cache_directory) : jobs_{jobs > 0 ? jobs : std::max(std::thread::hardware_concurrency(), 1u)}, cache_directory_{std::move(cache_directory)} {}
+
+
+void Beeline::run(std::string input)
+{
+    const Source source{std::move(input)};
+    run_through_output_cache(output_cache_directory_for(output_cache_directory_, optimization_), output_cache_capacity_, optimization_, {source}, [&]() {
+        Interpreter{optimization_}.interpret(compile(source, jobs_, cache_directory_));
+    });
+}
+
+
+void Beeline::run_files(const std::vector<std::string>& paths)
+{
+    const std::filesystem::path output_cache_directory = output_cache_directory_for(output_cache_directory_, optimization_);
+    if (output_cache_directory.empty())
     {
-        throw BeelineError{bse.what()};
+        propagate_errors([&]() {
+            Interpreter interpreter{optimization_};
+            for (const std::string& path : paths)
+            {
+                interpreter.interpret(compile(Source::map(path), jobs_, cache_directory_));
+            }
+        });
+        return;
     }
-    catch (const BeelineParseError& bpe)
+    // The output depends on all files, which are mapped up front to look it up.
+    std::vector<Source> sources;
+    for (const std::string& path : paths)
     {
-        throw BeelineError{bpe.what()};
+        sources.push_back(Source::map(path));
     }
-    catch (const BeelineRuntimeError& bre)
+    run_through_output_cache(output_cache_directory, output_cache_capacity_, optimization_, sources, [&]() {
+        Interpreter interpreter{optimization_};
+        for (const Source& source : sources)
+        {
+            interpreter.interpret(compile(source, jobs_, cache_directory_));
+        }
+    });
+}
+
+
+void Beeline::cache_output(std::filesystem::path directory, const std::uintmax_t capacity)
+{
+    output_cache_directory_ = std::move(directory);
+    output_cache_capacity_ = capacity;
+}
+
+
+void Beeline::optimize(OptimizationOptions optimization)
+{
+    // Rejects unknown passes before any program runs.
+    const PassManager passes{optimization};
+    optimization_ = std::move(optimization);
+}
+
+
+std::vector<std::string_view> Beeline::passes()
+{
+    std::vector<std::string_view> names;
+    for (const Pass& pass : registered_passes())
     {
-        throw BeelineError{bre.what()};
+        names.push_back(pass.name);
+    }
+    return names;
+}
+
+
+void Beeline::stream(std::istream& input)
+{
+    Session session{jobs_, optimization_};
+    std::string line;
+    while (true)
+    {
+        // Make the output so far visible before possibly waiting on the producer.
+        if (input.rdbuf()->in_avail() <= 0)
+        {
+            std::cout.flush();
+        }
+        if (!std::getline(input, line))
+        {
+            break;
+        }
+        if (!input.eof())
+        {
+            line += '\n';
+        }
+        session.submit(line);
     }
+    session.finish();
+}
+
+
+Beeline::Session Beeline::session() const
+{
+    return Session{jobs_, optimization_};
 }
+
+
+class Beeline::Session::Impl
+{
+public:
+    Impl(const std::size_t jobs, const OptimizationOptions& optimization) : jobs_{jobs}, interpreter_{optimization} {}
+    void submit(const std::string_view text)
+    {
+        pending_ += text;
+        execute_until(splitter_.scan(text));
+    }
+    void confirm()
+    {
+        execute_until(splitter_.confirm());
+    }
+    bool is_pending() const
+    {
+        return pending_.find_first_not_of(" \t\r\n") != std::string::npos;
+    }
+    void finish()
+    {
+        execute_until(splitter_.finish());
+        // Text submitted afterwards starts over.
+        splitter_ = Splitter{};
+        pending_offset_ = 0;
+    }
+private:
+    std::size_t jobs_;
+    Interpreter interpreter_;
+    Splitter splitter_;
+    // Text submitted but not yet executed, which starts at the given offset
+    // of the text scanned by the splitter and at the given line of all text
+    // submitted.
+    std::string pending_;
+    std::size_t pending_offset_{0};
+    std::size_t pending_line_{1};
+    // Executes and frees the pending declarations before the given boundary.
+    void execute_until(const std::size_t boundary)
+    {
+        if (boundary == pending_offset_)
+        {
+            return;
+        }
+        std::string text = pending_.substr(0, boundary - pending_offset_);
+        pending_.erase(0, boundary - pending_offset_);
+        pending_offset_ = boundary;
+        const std::size_t first_line = pending_line_;
+        pending_line_ += std::count(text.begin(), text.end(), '\n');
+        try
+        {
+            propagate_errors([&]() {
+                interpreter_.interpret(parse(Source{std::move(text), first_line}, jobs_));
+            });
+        }
+        catch (const BeelineError&)
+        {
+            // The pending text continues the declarations that failed, so it
+            // is discarded and the splitter starts over.
+            pending_line_ += std::count(pending_.begin(), pending_.end(), '\n');
+            pending_.clear();
+            splitter_ = Splitter{};
+            pending_offset_ = 0;
+            throw;
+        }
+    }
+};
+
+
+Beeline::Session::Session(const std::size_t jobs, const OptimizationOptions& optimization) : impl_{std::make_unique<Impl>(jobs, optimization)} {}
+Beeline::Session::~Session() = default;
+Beeline::Session::Session(Session&& other) = default;
+Beeline::Session& Beeline::Session::operator=(Session&& other) = default;
+void Beeline::Session::submit(const std::string_view text) { impl_->submit(text); }
+void Beeline::Session::confirm() { impl_->confirm(); }
+bool Beeline::Session::is_pending() const { return impl_->is_pending(); }
+void Beeline::Session::finish() { impl_->finish(); }
@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <unistd.h>
+
+#include "beeline.hpp"
+#include "cache_file.hpp"
+#include "logging.hpp"
+
+
+std::optional<Source> map_cache_file(const std::filesystem::path& path)
+{
+    std::error_code error;
+    if (!std::filesystem::exists(path, error))
+    {
+        return std::nullopt;
+    }
+    // Entries are mapped like scripts; a failure is no more than a miss.
+    try
+    {
+        LoggingSilencer silencer;
+        return Source::map(path.string());
+    }
+    catch (const BeelineError&)
+    {
+        return std::nullopt;
+    }
+}
+
+
+bool write_cache_file(const std::filesystem::path& path, const std::string_view contents)
+{
+    std::filesystem::path temporary = path;
+    temporary += ".tmp" + std::to_string(getpid());
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    {
+        std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+        file.write(contents.data(), contents.size());
+        if (!file)
+        {
+            const UnrecordedLogging unrecorded;
+            log(LoggingLevel::WARN) << "cannot write cache entry '" + temporary.string() + "'";
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        const UnrecordedLogging unrecorded;
+        log(LoggingLevel::WARN) << "cannot write cache entry '" + path.string() + "': " + error.message();
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+
+std::string cache_file_name(const std::uint64_t key, const std::string_view extension)
+{
+    char name[sizeof(key) * 2 + 1];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return std::string{name} + std::string{extension};
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "source.hpp"
+
+
+// Maps the cache entry at the given path into memory, through a source
+// whose text is the contents of the entry. Returns nothing, without logging,
+// if there is no such entry or it cannot be mapped.
+std::optional<Source> map_cache_file(const std::filesystem::path& path);
+
+
+// Writes a cache entry with the given contents to the given path, creating
+// its directory if needed. The entry is written to a temporary file that is
+// renamed into place, so concurrent runs never see partial entries. Failures
+// are logged as warnings, since caches are only an optimization. Returns
+// whether the entry was written.
+bool write_cache_file(const std::filesystem::path& path, std::string_view contents);
+
+
+// Returns the name of the cache entry with the given key and extension.
+std::string cache_file_name(const std::uint64_t key, std::string_view extension);
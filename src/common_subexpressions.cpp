@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "common_subexpressions.hpp"
+#include "flat_ast.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Numbers the values of expressions so that two expressions have the same
+// number exactly when they compute the same value: literals by their interned
+// constant, variables by their slot and how many times it has been assigned so
+// far, and operators by their opcode and the numbers of their operands.
+// Expressions that assign have no number, and neither do those around them.
+// The first evaluation of each numbered expression in the straight-line code
+// of a block, or of the top level, is kept available for the code after it,
+// and each later one is replaced by a temporary that the first one stores its
+// value in.
+class CommonSubexpressionEliminator
+{
+public:
+    CommonSubexpressionEliminator(FlatAst& ast, const std::span<const FlatAst::Index> statements, const std::size_t stack_size) : ast_{ast}, stack_size_{static_cast<FlatAst::Index>(stack_size)}, next_slot_{stack_size_}
+    {
+        for (const FlatAst::Index statement : statements)
+        {
+            find_slots(statement);
+        }
+    }
+    void eliminate_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+                eliminate_expression(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                if (node.b != FlatAst::NONE)
+                {
+                    eliminate_expression(node.b);
+                }
+                assign(node.c);
+                break;
+            case Opcode::BLOCK:
+            {
+                // The statements of the block go in the stack above those
+                // around it, and hold its temporaries.
+                const FlatAst::Index host = host_;
+                const FlatAst::Index host_stack_size = host_stack_size_;
+                const FlatAst::Index stack_size = stack_size_;
+                host_ = index;
+                host_stack_size_ = stack_size_;
+                stack_size_ += node.c;
+                const std::size_t scope = enter_scope();
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    eliminate_statement(statement);
+                }
+                leave_scope(scope);
+                host_ = host;
+                host_stack_size_ = host_stack_size;
+                stack_size_ = stack_size;
+                break;
+            }
+            case Opcode::LAZY_BLOCK:
+                // The code of lazy blocks is not known yet, so they may assign
+                // every variable they refer to.
+                for (const FlatAst::Index free_variable : ast_.list(node.a, node.b))
+                {
+                    assign(ast_.node(free_variable).c);
+                }
+                break;
+            case Opcode::IF_ELSE:
+            {
+                eliminate_expression(node.a);
+                // Only one of the branches runs, and maybe neither.
+                std::size_t scope = enter_scope();
+                eliminate_statement(node.b);
+                leave_scope(scope);
+                if (node.c != FlatAst::NONE)
+                {
+                    scope = enter_scope();
+                    eliminate_statement(node.c);
+                    leave_scope(scope);
+                }
+                break;
+            }
+            case Opcode::WHILE_LOOP:
+            {
+                // The condition runs again after the body, so what the loop
+                // assigns differs from what was there before it.
+                assign_all(node.a);
+                assign_all(node.b);
+                const std::size_t scope = enter_scope();
+                eliminate_expression(node.a);
+                eliminate_statement(node.b);
+                leave_scope(scope);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+private:
+    // Opcode and operands of an expression, by their numbers.
+    struct Value
+    {
+        Opcode opcode;
+        FlatAst::Index a;
+        FlatAst::Index b;
+        bool operator==(const Value&) const = default;
+    };
+    struct ValueHash
+    {
+        std::size_t operator()(const Value& value) const
+        {
+            return std::hash<std::uint64_t>{}((std::uint64_t{value.a} << 32 | value.b) * 31 + static_cast<std::uint64_t>(value.opcode));
+        }
+    };
+    // First evaluation of a value, in the block that holds its temporary.
+    struct Evaluation
+    {
+        FlatAst::Index index;
+        FlatAst::Index host;
+        FlatAst::Index host_stack_size;
+        // Name and slot of the temporary, if a later evaluation needed it.
+        FlatAst::Index name{FlatAst::NONE};
+        FlatAst::Index slot{FlatAst::NONE};
+    };
+    FlatAst& ast_;
+    // Size of the stack where the statement being eliminated runs.
+    FlatAst::Index stack_size_;
+    // Slot of the next temporary, above those of every variable.
+    FlatAst::Index next_slot_;
+    // Innermost block around the statement being eliminated, if any, and the
+    // size of the stack around it.
+    FlatAst::Index host_{FlatAst::NONE};
+    FlatAst::Index host_stack_size_{0};
+    // Number of times each slot has been assigned so far.
+    std::unordered_map<FlatAst::Index, FlatAst::Index> assignments_;
+    std::unordered_map<Value, FlatAst::Index, ValueHash> numbers_;
+    FlatAst::Index next_number_{0};
+    // Numbers of the nodes of the expression being eliminated, by index.
+    std::vector<FlatAst::Index> node_numbers_;
+    // Values evaluated in the code before the expression being eliminated
+    // that are still the same, and the order they were made available in.
+    std::unordered_map<FlatAst::Index, Evaluation> available_;
+    std::vector<FlatAst::Index> available_order_;
+    void find_slots(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                break;
+            case Opcode::VARIABLE:
+                use(node.c);
+                break;
+            case Opcode::ASSIGNMENT:
+            case Opcode::VARIABLE_DECLARATION:
+                use(node.c);
+                if (node.b != FlatAst::NONE)
+                {
+                    find_slots(node.b);
+                }
+                break;
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+                find_slots(node.a);
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    find_slots(statement);
+                }
+                break;
+            case Opcode::LAZY_BLOCK:
+                for (const FlatAst::Index free_variable : ast_.list(node.a, node.b))
+                {
+                    find_slots(free_variable);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                find_slots(node.a);
+                find_slots(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    find_slots(node.c);
+                }
+                break;
+            default:
+                find_slots(node.a);
+                find_slots(node.b);
+                break;
+        }
+    }
+    void use(const FlatAst::Index slot)
+    {
+        next_slot_ = std::max(next_slot_, slot + 1);
+    }
+    // Marks each slot that the statement or expression at the given index
+    // may assign as assigned.
+    void assign_all(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+            case Opcode::VARIABLE:
+                break;
+            case Opcode::ASSIGNMENT:
+            case Opcode::VARIABLE_DECLARATION:
+                assign(node.c);
+                if (node.b != FlatAst::NONE)
+                {
+                    assign_all(node.b);
+                }
+                break;
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+                assign_all(node.a);
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    assign_all(statement);
+                }
+                break;
+            case Opcode::LAZY_BLOCK:
+                for (const FlatAst::Index free_variable : ast_.list(node.a, node.b))
+                {
+                    assign(ast_.node(free_variable).c);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                assign_all(node.a);
+                assign_all(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    assign_all(node.c);
+                }
+                break;
+            default:
+                assign_all(node.a);
+                assign_all(node.b);
+                break;
+        }
+    }
+    void assign(const FlatAst::Index slot)
+    {
+        ++assignments_[slot];
+    }
+    void eliminate_expression(const FlatAst::Index index)
+    {
+        node_numbers_.resize(ast_.size());
+        number(index);
+        reuse(index);
+    }
+    // Numbers the expression at the given index and its operands, in the
+    // order they are evaluated in, and returns its number.
+    FlatAst::Index number(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        FlatAst::Index result = FlatAst::NONE;
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                result = number(Value{node.opcode, node.a, 0});
+                break;
+            case Opcode::VARIABLE:
+                result = number(Value{node.opcode, node.c, assignments_[node.c]});
+                break;
+            case Opcode::ASSIGNMENT:
+                number(node.b);
+                assign(node.c);
+                break;
+            case Opcode::GROUPING:
+                result = number(node.a);
+                break;
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            {
+                const FlatAst::Index operand = number(node.a);
+                if (operand != FlatAst::NONE)
+                {
+                    result = number(Value{node.opcode, operand, 0});
+                }
+                break;
+            }
+            default:
+            {
+                const FlatAst::Index left = number(node.a);
+                const FlatAst::Index right = number(node.b);
+                if (left != FlatAst::NONE && right != FlatAst::NONE)
+                {
+                    result = number(Value{node.opcode, left, right});
+                }
+                break;
+            }
+        }
+        node_numbers_[index] = result;
+        return result;
+    }
+    FlatAst::Index number(const Value& value)
+    {
+        const auto [entry, is_new] = numbers_.try_emplace(value, next_number_);
+        if (is_new)
+        {
+            ++next_number_;
+        }
+        return entry->second;
+    }
+    // Replaces the largest values in the expression at the given index that
+    // are available by their temporaries, in evaluation order, and makes the
+    // others available.
+    void reuse(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        const FlatAst::Index number = node_numbers_[index];
+        const bool is_operation = number != FlatAst::NONE && node.opcode != Opcode::LITERAL && node.opcode != Opcode::VARIABLE;
+        if (is_operation)
+        {
+            if (const auto evaluation = available_.find(number); evaluation != available_.end())
+            {
+                ast_.node(index) = read(evaluation->second);
+                return;
+            }
+        }
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+            case Opcode::VARIABLE:
+                break;
+            case Opcode::ASSIGNMENT:
+                reuse(node.b);
+                break;
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+                reuse(node.a);
+                break;
+            case Opcode::AND:
+            case Opcode::OR:
+            {
+                reuse(node.a);
+                // The right operand is not always evaluated.
+                const std::size_t scope = enter_scope();
+                reuse(node.b);
+                leave_scope(scope);
+                break;
+            }
+            default:
+                reuse(node.a);
+                reuse(node.b);
+                break;
+        }
+        if (is_operation && available_.try_emplace(number, Evaluation{index, host_, host_stack_size_}).second)
+        {
+            available_order_.push_back(number);
+        }
+    }
+    // Returns a variable that reads the temporary of the given evaluation,
+    // which stores its value there from now on.
+    FlatAst::Node read(Evaluation& evaluation)
+    {
+        if (evaluation.slot == FlatAst::NONE)
+        {
+            evaluation.name = ast_.add_temporary_name();
+            evaluation.slot = next_slot_++;
+            const FlatAst::Node expression = ast_.node(evaluation.index);
+            const FlatAst::Index value = ast_.add(expression.opcode, ast_.position(evaluation.index), expression.a, expression.b, expression.c);
+            ast_.node(evaluation.index) = FlatAst::Node{Opcode::ASSIGNMENT, evaluation.name, value, evaluation.slot};
+            // The stack is grown to the slot by the block holding the first
+            // evaluation, or before the program runs if it is at the top
+            // level. Blocks around loops whose invariants were moved out may
+            // already grow the stack past the slot.
+            if (evaluation.host == FlatAst::NONE)
+            {
+                ast_.reserve_stack(evaluation.slot + 1);
+            }
+            else if (evaluation.slot >= evaluation.host_stack_size)
+            {
+                FlatAst::Node& host = ast_.node(evaluation.host);
+                host.c = std::max(host.c, evaluation.slot + 1 - evaluation.host_stack_size);
+            }
+        }
+        return FlatAst::Node{Opcode::VARIABLE, evaluation.name, FlatAst::NONE, evaluation.slot};
+    }
+    std::size_t enter_scope() const
+    {
+        return available_order_.size();
+    }
+    // Forgets the values made available since the scope was entered.
+    void leave_scope(const std::size_t scope)
+    {
+        for (std::size_t i = scope; i < available_order_.size(); ++i)
+        {
+            available_.erase(available_order_[i]);
+        }
+        available_order_.resize(scope);
+    }
+};
+
+
+void eliminate_common_subexpressions(FlatAst& ast, const std::size_t stack_size)
+{
+    CommonSubexpressionEliminator eliminator{ast, ast.statements(), stack_size};
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        eliminator.eliminate_statement(statement);
+    }
+}
+
+
+void eliminate_common_subexpressions(FlatAst& ast, const FlatAst::Index statement, const std::size_t stack_size)
+{
+    // Only the whole program has top-level temporaries.
+    assert(ast.node(statement).opcode == Opcode::BLOCK);
+    CommonSubexpressionEliminator{ast, std::span<const FlatAst::Index>{&statement, 1}, stack_size}.eliminate_statement(statement);
+}
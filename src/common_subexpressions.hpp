@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+#include "flat_ast.hpp"
+
+
+// Computes the expressions of the given resolved flat AST that are evaluated
+// again with the same operands only once. Within the statements of a block,
+// or the top-level ones, the first evaluation of an expression that assigns nothing is stored in a
+// temporary, and later copies of it read the temporary as long as none of the
+// variables it reads has been assigned in between. Only copies that run after
+// the first evaluation whenever they run are replaced, so an expression that
+// fails still fails at its first evaluation. The temporaries take slots above
+// the given size of the stack, which the blocks that hold them grow to. The
+// stack the top-level statements need for theirs is reserved in the flat AST.
+void eliminate_common_subexpressions(FlatAst& ast, const std::size_t stack_size);
+
+
+// Eliminates the common subexpressions of the block at the given index of the
+// given resolved flat AST, which runs with the stack at the given size, as
+// above.
+void eliminate_common_subexpressions(FlatAst& ast, const FlatAst::Index statement, const std::size_t stack_size);
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <variant>
+
+#include "constant_folder.hpp"
+#include "flat_ast.hpp"
+#include "interpreter.hpp"
+#include "lexer.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Folds flat ASTs bottom up and in place, as their nodes are referred to by
+// index: a folded expression becomes a LITERAL node, and a dropped statement
+// an empty BLOCK node, which the block around it leaves out of its list.
+class ConstantFolder
+{
+public:
+    explicit ConstantFolder(FlatAst& ast) : ast_{ast} {}
+    void fold_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+                // The value of a literal statement is discarded.
+                if (fold_expression(node.a))
+                {
+                    drop(index);
+                }
+                break;
+            case Opcode::PRINT:
+                fold_expression(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                if (node.b != FlatAst::NONE)
+                {
+                    fold_expression(node.b);
+                }
+                break;
+            case Opcode::BLOCK:
+            {
+                const std::span<FlatAst::Index> statements = ast_.list(node.a, node.b);
+                for (const FlatAst::Index statement : statements)
+                {
+                    fold_statement(statement);
+                }
+                const auto end = std::remove_if(statements.begin(), statements.end(), [this](const FlatAst::Index statement) {
+                    return is_dropped(statement);
+                });
+                ast_.node(index).b = static_cast<FlatAst::Index>(end - statements.begin());
+                break;
+            }
+            case Opcode::LAZY_BLOCK:
+                // Folded once it is expanded.
+                break;
+            case Opcode::IF_ELSE:
+            {
+                const std::optional<bool> condition = fold_condition(index);
+                if (!condition)
+                {
+                    fold_statement(node.b);
+                    if (node.c != FlatAst::NONE)
+                    {
+                        fold_statement(node.c);
+                    }
+                }
+                else if (*condition)
+                {
+                    fold_statement(node.b);
+                    ast_.replace(index, node.b);
+                }
+                else if (node.c != FlatAst::NONE)
+                {
+                    fold_statement(node.c);
+                    ast_.replace(index, node.c);
+                }
+                else
+                {
+                    drop(index);
+                }
+                break;
+            }
+            case Opcode::WHILE_LOOP:
+                if (fold_condition(index) == false)
+                {
+                    drop(index);
+                }
+                else
+                {
+                    fold_statement(node.b);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+private:
+    FlatAst& ast_;
+    // Folds the expression at the given index. Returns whether it is now a
+    // literal.
+    bool fold_expression(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                return true;
+            case Opcode::VARIABLE:
+                return false;
+            case Opcode::ASSIGNMENT:
+                fold_expression(node.b);
+                return false;
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+                return fold_expression(node.a) && evaluate(index);
+            case Opcode::AND:
+            case Opcode::OR:
+            {
+                const bool is_left_literal = fold_expression(node.a);
+                const bool is_right_literal = fold_expression(node.b);
+                // The right operand is only evaluated if the left one is the
+                // boolean that does not decide the result.
+                return is_left_literal && (is_right_literal || !is_continued(node)) && evaluate(index);
+            }
+            default:
+            {
+                const bool is_left_literal = fold_expression(node.a);
+                const bool is_right_literal = fold_expression(node.b);
+                return is_left_literal && is_right_literal && evaluate(index);
+            }
+        }
+    }
+    // Folds the condition of the if or while statement at the given index.
+    // Returns its value if it is a boolean literal.
+    std::optional<bool> fold_condition(const FlatAst::Index index)
+    {
+        const FlatAst::Index condition = ast_.node(index).a;
+        if (!fold_expression(condition))
+        {
+            return std::nullopt;
+        }
+        const Token::Literal& value = ast_.constant(ast_.node(condition).a);
+        if (!std::holds_alternative<bool>(value))
+        {
+            return std::nullopt;
+        }
+        return std::get<bool>(value);
+    }
+    // Returns whether the given and or or node, whose left operand is a
+    // literal, evaluates its right operand.
+    bool is_continued(const FlatAst::Node& node) const
+    {
+        const Token::Literal& left = ast_.constant(ast_.node(node.a).a);
+        return std::holds_alternative<bool>(left) && std::get<bool>(left) == (node.opcode == Opcode::AND);
+    }
+    // Replaces the expression at the given index, whose operands are
+    // literals, by its value. Returns whether it succeeded, as the
+    // expression is left as it is if it fails: the failure was reported when
+    // the types of the program were checked.
+    bool evaluate(const FlatAst::Index index)
+    {
+        try
+        {
+            const FlatAst::Index constant = ast_.add_constant(Interpreter::evaluate_constant(ast_, index));
+            ast_.node(index) = FlatAst::Node{Opcode::LITERAL, constant, FlatAst::NONE, FlatAst::NONE};
+            return true;
+        }
+        catch (const BeelineRuntimeError&)
+        {
+            return false;
+        }
+    }
+    void drop(const FlatAst::Index index)
+    {
+        ast_.node(index) = FlatAst::Node{Opcode::BLOCK, 0, 0, 0};
+    }
+    bool is_dropped(const FlatAst::Index index) const
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        return node.opcode == Opcode::BLOCK && node.b == 0;
+    }
+};
+
+
+void fold_constants(FlatAst& ast)
+{
+    ConstantFolder folder{ast};
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        folder.fold_statement(statement);
+    }
+}
+
+
+void fold_constants(FlatAst& ast, const FlatAst::Index statement)
+{
+    ConstantFolder{ast}.fold_statement(statement);
+}
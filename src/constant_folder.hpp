@@ -0,0 +1,17 @@
+#pragma once
+
+#include "flat_ast.hpp"
+
+
+// Folds the expressions of the given resolved flat AST whose operands are
+// literals into literals, with the semantics of the interpreter, and drops
+// the branches and loops whose conditions are constant and never run them.
+// Expressions that would fail are left as they are: check_types fails the
+// program before it runs if they run whenever it does, and reports the
+// others as warnings, as they fail only if they are reached.
+void fold_constants(FlatAst& ast);
+
+
+// Folds the constant expressions of the statement at the given index of the
+// given resolved flat AST, as above.
+void fold_constants(FlatAst& ast, const FlatAst::Index statement);
@@ -0,0 +1,631 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "flat_ast.hpp"
+#include "arena.hpp"
+#include "ast.hpp"
+#include "lexer.hpp"
+#include "program.hpp"
+#include "serialization.hpp"
+
+
+FlatAst::FlatAst(Source source) : source_{std::move(source)} {}
+
+
+FlatAst::Index FlatAst::add(const Opcode opcode, const Token::Position& position, const Index a, const Index b, const Index c)
+{
+    nodes_.push_back(Node{opcode, a, b, c});
+    positions_.push_back(position);
+    return static_cast<Index>(nodes_.size() - 1);
+}
+
+
+std::size_t FlatAst::ConstantHash::operator()(const Token::Literal& constant) const
+{
+    if (const double* number = std::get_if<double>(&constant))
+    {
+        return std::hash<std::uint64_t>{}(std::bit_cast<std::uint64_t>(*number));
+    }
+    return std::hash<Token::Literal>{}(constant);
+}
+
+
+bool FlatAst::ConstantEqual::operator()(const Token::Literal& left, const Token::Literal& right) const
+{
+    const double* left_number = std::get_if<double>(&left);
+    const double* right_number = std::get_if<double>(&right);
+    if (left_number != nullptr && right_number != nullptr)
+    {
+        return std::bit_cast<std::uint64_t>(*left_number) == std::bit_cast<std::uint64_t>(*right_number);
+    }
+    return left == right;
+}
+
+
+FlatAst::Index FlatAst::add_constant(Token::Literal constant)
+{
+    const auto [entry, is_new] = constant_indices_.try_emplace(constant, static_cast<Index>(constants_.size()));
+    if (is_new)
+    {
+        constants_.push_back(std::move(constant));
+    }
+    return entry->second;
+}
+
+
+FlatAst::Index FlatAst::add_name(std::string_view name)
+{
+    const auto [entry, is_new] = name_indices_.try_emplace(name, static_cast<Index>(names_.size()));
+    if (is_new)
+    {
+        names_.push_back(name);
+    }
+    return entry->second;
+}
+
+
+FlatAst::Index FlatAst::add_temporary_name()
+{
+    temporary_names_.push_back("$" + std::to_string(temporary_names_.size()));
+    return add_name(temporary_names_.back());
+}
+
+
+FlatAst::Index FlatAst::add_list(const std::vector<Index>& nodes)
+{
+    const Index first = static_cast<Index>(lists_.size());
+    lists_.insert(lists_.end(), nodes.begin(), nodes.end());
+    return first;
+}
+
+
+void FlatAst::add_statement(const Index statement)
+{
+    statements_.push_back(statement);
+}
+
+
+void FlatAst::reserve_stack(const std::size_t size)
+{
+    reserved_stack_ = std::max(reserved_stack_, size);
+}
+
+
+void FlatAst::replace(const Index index, const Index replacement)
+{
+    nodes_[index] = nodes_[replacement];
+    positions_[index] = positions_[replacement];
+}
+
+
+const FlatAst::Node& FlatAst::node(const Index index) const
+{
+    return nodes_[index];
+}
+
+
+FlatAst::Node& FlatAst::node(const Index index)
+{
+    return nodes_[index];
+}
+
+
+Token::Position FlatAst::position(const Index index) const
+{
+    return positions_[index];
+}
+
+
+const Token::Literal& FlatAst::constant(const Index index) const
+{
+    return constants_[index];
+}
+
+
+std::string_view FlatAst::name(const Index index) const
+{
+    return names_[index];
+}
+
+
+std::span<const FlatAst::Index> FlatAst::list(const Index first, const Index size) const
+{
+    return std::span<const Index>{lists_}.subspan(first, size);
+}
+
+
+std::span<FlatAst::Index> FlatAst::list(const Index first, const Index size)
+{
+    return std::span<Index>{lists_}.subspan(first, size);
+}
+
+
+std::span<const FlatAst::Index> FlatAst::statements() const
+{
+    return statements_;
+}
+
+
+std::size_t FlatAst::reserved_stack() const
+{
+    return reserved_stack_;
+}
+
+
+std::size_t FlatAst::size() const
+{
+    return nodes_.size();
+}
+
+
+const Source& FlatAst::source() const
+{
+    return source_;
+}
+
+
+static_assert(std::is_trivially_copyable_v<FlatAst::Node> && sizeof(FlatAst::Node) == 16);
+
+
+// Tags of the alternatives of a serialized constant.
+enum struct ConstantTag : std::uint8_t
+{
+    NIL,
+    STRING,
+    NUMBER,
+    BOOLEAN,
+};
+
+
+// Range of the source text that a name refers to.
+struct NameRange
+{
+    std::uint32_t offset;
+    std::uint32_t length;
+};
+
+
+void FlatAst::serialize(std::string& buffer) const
+{
+    const std::string_view text = source_.text();
+    Writer writer{buffer};
+    writer.write(nodes_);
+    writer.write(positions_);
+    writer.write<std::uint64_t>(constants_.size());
+    for (const Token::Literal& constant : constants_)
+    {
+        writer.write(static_cast<ConstantTag>(constant.index()));
+        if (const std::string* string = std::get_if<std::string>(&constant))
+        {
+            writer.write(std::string_view{*string});
+        }
+        else if (const double* number = std::get_if<double>(&constant))
+        {
+            writer.write(*number);
+        }
+        else if (const bool* boolean = std::get_if<bool>(&constant))
+        {
+            writer.write(*boolean);
+        }
+    }
+    std::vector<NameRange> names;
+    names.reserve(names_.size());
+    for (const std::string_view name : names_)
+    {
+        assert(name.data() >= text.data() && name.data() + name.size() <= text.data() + text.size() && "name is not part of the source");
+        names.push_back(NameRange{static_cast<std::uint32_t>(name.data() - text.data()), static_cast<std::uint32_t>(name.size())});
+    }
+    writer.write(names);
+    writer.write(lists_);
+    writer.write(statements_);
+}
+
+
+std::optional<FlatAst> FlatAst::deserialize(const std::string_view data, Source source)
+{
+    FlatAst ast{std::move(source)};
+    const std::string_view text = ast.source_.text();
+    Reader reader{data};
+    if (!reader.read(ast.nodes_) || !reader.read(ast.positions_) || ast.positions_.size() != ast.nodes_.size())
+    {
+        return std::nullopt;
+    }
+    std::uint64_t constants = 0;
+    if (!reader.read(constants))
+    {
+        return std::nullopt;
+    }
+    for (std::uint64_t i = 0; i < constants; ++i)
+    {
+        ConstantTag tag;
+        if (!reader.read(tag))
+        {
+            return std::nullopt;
+        }
+        switch (tag)
+        {
+            case ConstantTag::NIL:
+                ast.add_constant(nullptr);
+                break;
+            case ConstantTag::STRING:
+            {
+                std::string string;
+                if (!reader.read(string))
+                {
+                    return std::nullopt;
+                }
+                ast.add_constant(std::move(string));
+                break;
+            }
+            case ConstantTag::NUMBER:
+            {
+                double number;
+                if (!reader.read(number))
+                {
+                    return std::nullopt;
+                }
+                ast.add_constant(number);
+                break;
+            }
+            case ConstantTag::BOOLEAN:
+            {
+                bool boolean;
+                if (!reader.read(boolean))
+                {
+                    return std::nullopt;
+                }
+                ast.add_constant(boolean);
+                break;
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+    std::vector<NameRange> names;
+    if (!reader.read(names))
+    {
+        return std::nullopt;
+    }
+    ast.names_.reserve(names.size());
+    for (const NameRange& name : names)
+    {
+        if (name.offset > text.size() || name.length > text.size() - name.offset)
+        {
+            return std::nullopt;
+        }
+        ast.add_name(text.substr(name.offset, name.length));
+    }
+    if (ast.constants_.size() != constants || ast.names_.size() != names.size())
+    {
+        return std::nullopt;
+    }
+    if (!reader.read(ast.lists_) || !reader.read(ast.statements_) || !reader.is_done())
+    {
+        return std::nullopt;
+    }
+    return ast;
+}
+
+
+using Opcode = FlatAst::Opcode;
+
+
+Opcode to_binary_opcode(const Token::Type type)
+{
+    switch (type)
+    {
+        case Token::Type::PLUS: return Opcode::ADD;
+        case Token::Type::MINUS: return Opcode::SUBTRACT;
+        case Token::Type::STAR: return Opcode::MULTIPLY;
+        case Token::Type::SLASH: return Opcode::DIVIDE;
+        case Token::Type::GREATER: return Opcode::GREATER;
+        case Token::Type::GREATER_EQUAL: return Opcode::GREATER_EQUAL;
+        case Token::Type::LESS: return Opcode::LESS;
+        case Token::Type::LESS_EQUAL: return Opcode::LESS_EQUAL;
+        case Token::Type::EQUAL_EQUAL: return Opcode::EQUAL;
+        case Token::Type::BANG_EQUAL: return Opcode::NOT_EQUAL;
+        case Token::Type::AND: return Opcode::AND;
+        case Token::Type::OR: return Opcode::OR;
+        default: assert(false && "unhandled binary operator");
+    }
+    return Opcode::ADD;
+}
+
+
+// Returns the token an operator was written as, for rebuilding the tree form.
+Token to_token(const Opcode opcode, const Token::Position& position)
+{
+    switch (opcode)
+    {
+        case Opcode::ADD:
+        case Opcode::ADD_NUMBERS:
+        case Opcode::ADD_NUMBERS_GUARDED:
+        case Opcode::ADD_STRINGS_GUARDED: return Token{Token::Type::PLUS, "+", position};
+        case Opcode::SUBTRACT:
+        case Opcode::SUBTRACT_NUMBERS:
+        case Opcode::SUBTRACT_NUMBERS_GUARDED: return Token{Token::Type::MINUS, "-", position};
+        case Opcode::MULTIPLY:
+        case Opcode::MULTIPLY_NUMBERS:
+        case Opcode::MULTIPLY_NUMBERS_GUARDED: return Token{Token::Type::STAR, "*", position};
+        case Opcode::DIVIDE:
+        case Opcode::DIVIDE_NUMBERS:
+        case Opcode::DIVIDE_NUMBERS_GUARDED: return Token{Token::Type::SLASH, "/", position};
+        case Opcode::GREATER:
+        case Opcode::GREATER_NUMBERS:
+        case Opcode::GREATER_NUMBERS_GUARDED: return Token{Token::Type::GREATER, ">", position};
+        case Opcode::GREATER_EQUAL:
+        case Opcode::GREATER_EQUAL_NUMBERS:
+        case Opcode::GREATER_EQUAL_NUMBERS_GUARDED: return Token{Token::Type::GREATER_EQUAL, ">=", position};
+        case Opcode::LESS:
+        case Opcode::LESS_NUMBERS:
+        case Opcode::LESS_NUMBERS_GUARDED: return Token{Token::Type::LESS, "<", position};
+        case Opcode::LESS_EQUAL:
+        case Opcode::LESS_EQUAL_NUMBERS:
+        case Opcode::LESS_EQUAL_NUMBERS_GUARDED: return Token{Token::Type::LESS_EQUAL, "<=", position};
+        case Opcode::EQUAL: return Token{Token::Type::EQUAL_EQUAL, "==", position};
+        case Opcode::NOT_EQUAL: return Token{Token::Type::BANG_EQUAL, "!=", position};
+        case Opcode::AND:
+        case Opcode::AND_BOOLEANS: return Token{Token::Type::AND, "and", position};
+        case Opcode::OR:
+        case Opcode::OR_BOOLEANS: return Token{Token::Type::OR, "or", position};
+        case Opcode::NEGATE:
+        case Opcode::NEGATE_NUMBER: return Token{Token::Type::MINUS, "-", position};
+        case Opcode::NOT:
+        case Opcode::NOT_BOOLEAN: return Token{Token::Type::BANG, "!", position};
+        case Opcode::PRINT: return Token{Token::Type::PRINT, "print", position};
+        case Opcode::IF_ELSE:
+        case Opcode::IF_ELSE_BOOLEAN: return Token{Token::Type::IF, "if", position};
+        case Opcode::WHILE_LOOP:
+        case Opcode::WHILE_LOOP_BOOLEAN: return Token{Token::Type::WHILE, "while", position};
+        default: assert(false && "opcode has no token");
+    }
+    return Token{Token::Type::END_OF_FILE, "", position};
+}
+
+
+// Lowers tree nodes into a flat AST, appending children before their parents.
+// Nodes are dispatched statically on their kind, and every overload returns
+// the index of the flat node it appended.
+class Lowerer
+{
+public:
+    Lowerer(FlatAst& ast) : ast_{ast} {}
+    FlatAst::Index lower(const Expression& expression)
+    {
+        return dispatch(expression, *this);
+    }
+    FlatAst::Index lower(const Statement& statement)
+    {
+        return dispatch(statement, *this);
+    }
+    FlatAst::Index operator()(const Expression::Binary& binary)
+    {
+        const FlatAst::Index left = lower(*binary.left);
+        const FlatAst::Index right = lower(*binary.right);
+        return ast_.add(to_binary_opcode(binary.op.type), binary.op.position, left, right);
+    }
+    FlatAst::Index operator()(const Expression::Grouping& grouping)
+    {
+        const FlatAst::Index expression = lower(*grouping.expression);
+        return ast_.add(Opcode::GROUPING, ast_.position(expression), expression);
+    }
+    FlatAst::Index operator()(const Expression::Literal& literal)
+    {
+        return ast_.add(Opcode::LITERAL, Token::Position{0, 0}, ast_.add_constant(literal.value));
+    }
+    FlatAst::Index operator()(const Expression::Unary& unary)
+    {
+        const FlatAst::Index right = lower(*unary.right);
+        return ast_.add(unary.op.type == Token::Type::MINUS ? Opcode::NEGATE : Opcode::NOT, unary.op.position, right);
+    }
+    FlatAst::Index operator()(const Expression::Variable& variable)
+    {
+        return ast_.add(Opcode::VARIABLE, variable.name.position, ast_.add_name(variable.name.lexeme));
+    }
+    FlatAst::Index operator()(const Expression::Assignment& assignment)
+    {
+        const FlatAst::Index value = lower(*assignment.value);
+        return ast_.add(Opcode::ASSIGNMENT, assignment.name.position, ast_.add_name(assignment.name.lexeme), value);
+    }
+    FlatAst::Index operator()(const Statement::Expression& expression)
+    {
+        const FlatAst::Index value = lower(*expression.expression);
+        return ast_.add(Opcode::EXPRESSION, ast_.position(value), value);
+    }
+    FlatAst::Index operator()(const Statement::Print& print)
+    {
+        const FlatAst::Index value = lower(*print.expression);
+        return ast_.add(Opcode::PRINT, print.keyword.position, value);
+    }
+    FlatAst::Index operator()(const Statement::VariableDeclaration& variable_declaration)
+    {
+        const FlatAst::Index initializer = variable_declaration.initializer ? lower(*variable_declaration.initializer) : FlatAst::NONE;
+        return ast_.add(Opcode::VARIABLE_DECLARATION, variable_declaration.name.position, ast_.add_name(variable_declaration.name.lexeme), initializer);
+    }
+    FlatAst::Index operator()(const Statement::Block& block)
+    {
+        std::vector<FlatAst::Index> statements;
+        statements.reserve(block.statements.size());
+        for (const Statement* statement : block.statements)
+        {
+            statements.push_back(lower(*statement));
+        }
+        const FlatAst::Index first = ast_.add_list(statements);
+        return ast_.add(Opcode::BLOCK, Token::Position{0, 0}, first, static_cast<FlatAst::Index>(statements.size()));
+    }
+    FlatAst::Index operator()(const Statement::LazyBlock& lazy_block)
+    {
+        std::vector<FlatAst::Index> free_variables;
+        free_variables.reserve(lazy_block.free_variables.size());
+        for (const Expression* free_variable : lazy_block.free_variables)
+        {
+            free_variables.push_back(lower(*free_variable));
+        }
+        const FlatAst::Index first = ast_.add_list(free_variables);
+        const Token::Position& right_brace = lazy_block.right_brace.position;
+        return ast_.add(Opcode::LAZY_BLOCK, lazy_block.left_brace.position, first, static_cast<FlatAst::Index>(free_variables.size()), right_brace.offset + right_brace.length);
+    }
+    FlatAst::Index operator()(const Statement::IfElse& if_else)
+    {
+        const FlatAst::Index condition = lower(*if_else.condition);
+        const FlatAst::Index then_statement = lower(*if_else.then_statement);
+        const FlatAst::Index else_statement = if_else.else_statement ? lower(*if_else.else_statement) : FlatAst::NONE;
+        return ast_.add(Opcode::IF_ELSE, if_else.if_keyword.position, condition, then_statement, else_statement);
+    }
+    FlatAst::Index operator()(const Statement::WhileLoop& while_loop)
+    {
+        const FlatAst::Index condition = lower(*while_loop.condition);
+        const FlatAst::Index body = lower(*while_loop.body);
+        return ast_.add(Opcode::WHILE_LOOP, while_loop.keyword.position, condition, body);
+    }
+private:
+    FlatAst& ast_;
+};
+
+
+FlatAst lower(const Program& program)
+{
+    FlatAst ast{program.source};
+    Lowerer lowerer{ast};
+    for (const Statement* statement : program.statements)
+    {
+        ast.add_statement(lowerer.lower(*statement));
+    }
+    return ast;
+}
+
+
+FlatAst::Index lower(const Statement& statement, FlatAst& ast)
+{
+    return Lowerer{ast}.lower(statement);
+}
+
+
+// Rebuilds the tree form of flat nodes. Tokens are recreated from opcodes,
+// names and positions; else keywords, which the flat form does not keep,
+// are placed at their if keyword.
+class Raiser
+{
+public:
+    Raiser(const FlatAst& ast, Arena& arena) : ast_{ast}, arena_{arena} {}
+    Expression* expression(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        const Token::Position position = ast_.position(index);
+        switch (node.opcode)
+        {
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::NEGATE_NUMBER:
+            case Opcode::NOT_BOOLEAN:
+                return arena_.make<Expression::Unary>(to_token(node.opcode, position), expression(node.a));
+            case Opcode::GROUPING:
+                return arena_.make<Expression::Grouping>(expression(node.a));
+            case Opcode::LITERAL:
+                return arena_.make<Expression::Literal>(ast_.constant(node.a));
+            case Opcode::VARIABLE:
+                return arena_.make<Expression::Variable>(name(node.a, position));
+            case Opcode::ASSIGNMENT:
+                return arena_.make<Expression::Assignment>(name(node.a, position), expression(node.b));
+            case Opcode::INCREMENT:
+            case Opcode::GREATER_CONSTANT:
+            case Opcode::GREATER_EQUAL_CONSTANT:
+            case Opcode::LESS_CONSTANT:
+            case Opcode::LESS_EQUAL_CONSTANT:
+                return expression(node.a);
+            default:
+                return arena_.make<Expression::Binary>(expression(node.a), to_token(node.opcode, position), expression(node.b));
+        }
+    }
+    Statement* statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        const Token::Position position = ast_.position(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+            case Opcode::APPEND:
+                return arena_.make<Statement::Expression>(expression(node.a));
+            case Opcode::PRINT:
+                return arena_.make<Statement::Print>(to_token(node.opcode, position), expression(node.a));
+            case Opcode::VARIABLE_DECLARATION:
+                return arena_.make<Statement::VariableDeclaration>(name(node.a, position), node.b == FlatAst::NONE ? nullptr : expression(node.b));
+            case Opcode::BLOCK:
+            {
+                std::vector<Statement*> statements;
+                for (const FlatAst::Index child : ast_.list(node.a, node.b))
+                {
+                    statements.push_back(statement(child));
+                }
+                return arena_.make<Statement::Block>(arena_.copy(statements));
+            }
+            case Opcode::LAZY_BLOCK:
+            {
+                std::vector<Expression*> free_variables;
+                for (const FlatAst::Index free_variable : ast_.list(node.a, node.b))
+                {
+                    free_variables.push_back(expression(free_variable));
+                }
+                return arena_.make<Statement::LazyBlock>(
+                    Token{Token::Type::LEFT_BRACE, "{", position},
+                    Token{Token::Type::RIGHT_BRACE, "}", Token::Position{node.c - 1, 1}},
+                    arena_.copy(free_variables)
+                );
+            }
+            case Opcode::IF_ELSE:
+            case Opcode::IF_ELSE_BOOLEAN:
+            {
+                std::optional<Token> else_keyword;
+                Statement* else_statement = nullptr;
+                if (node.c != FlatAst::NONE)
+                {
+                    else_keyword = Token{Token::Type::ELSE, "else", position};
+                    else_statement = statement(node.c);
+                }
+                return arena_.make<Statement::IfElse>(expression(node.a), to_token(node.opcode, position), statement(node.b), else_keyword, else_statement);
+            }
+            case Opcode::WHILE_LOOP:
+            case Opcode::WHILE_LOOP_BOOLEAN:
+                return arena_.make<Statement::WhileLoop>(to_token(node.opcode, position), expression(node.a), statement(node.b));
+            default:
+                assert(false && "node is not a statement");
+        }
+        return nullptr;
+    }
+private:
+    const FlatAst& ast_;
+    Arena& arena_;
+    Token name(const FlatAst::Index index, const Token::Position& position) const
+    {
+        return Token{Token::Type::IDENTIFIER, ast_.name(index), position};
+    }
+};
+
+
+std::vector<Statement*> raise(const FlatAst& ast, Arena& arena)
+{
+    Raiser raiser{ast, arena};
+    std::vector<Statement*> statements;
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        statements.push_back(raiser.statement(statement));
+    }
+    return statements;
+}
+
+
+Statement* raise(const FlatAst& ast, const FlatAst::Index statement, Arena& arena)
+{
+    return Raiser{ast, arena}.statement(statement);
+}
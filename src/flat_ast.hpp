@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "source.hpp"
+#include "lexer.hpp"
+#include "program.hpp"
+
+
+// Flat, index-based form of the AST of a program, which the interpreter
+// executes. Nodes are stored contiguously and refer to their children by
+// 32-bit indices, with the operator of an expression folded into its opcode.
+// The position each node reports its runtime errors at lives in a side table,
+// as do constants, names and the statement lists of blocks, so that a node
+// fits in 16 bytes and the nodes of a loop share few cache lines. Names and
+// lazy blocks refer into the source, which the flat AST keeps alive.
+// Variables are lowered unresolved, with NONE for their slots, which the
+// resolver fills in before the flat AST is executed. Names and constants are
+// interned: each distinct one is stored once, so two nodes name the same
+// variable exactly when their name indices are equal.
+class FlatAst
+{
+public:
+    using Index = std::uint32_t;
+    // Marks an absent child, such as a missing else branch.
+    static constexpr Index NONE = std::numeric_limits<Index>::max();
+
+    enum struct Opcode : std::uint8_t
+    {
+        // Expressions. Binary operators take their operands in a and b.
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        GREATER,
+        GREATER_EQUAL,
+        LESS,
+        LESS_EQUAL,
+        EQUAL,
+        NOT_EQUAL,
+        AND,
+        OR,
+        // Unary operators and groupings take their operand in a.
+        NEGATE,
+        NOT,
+        GROUPING,
+        // Constant a.
+        LITERAL,
+        // Name a, slot c.
+        VARIABLE,
+        // Name a, value b, slot c.
+        ASSIGNMENT,
+
+        // Statements.
+        // Expression a.
+        EXPRESSION,
+        // Expression a.
+        PRINT,
+        // Name a, initializer b, which may be NONE, slot c.
+        VARIABLE_DECLARATION,
+        // Statement list starting at a, b statements long, declaring c
+        // variables.
+        BLOCK,
+        // Block whose source runs from its position up to offset c, which is
+        // parsed and lowered into a BLOCK the first time it is executed. The
+        // variables it refers to from outside it are listed from a, b long.
+        LAZY_BLOCK,
+        // Condition a, then statement b, else statement c, which may be NONE.
+        IF_ELSE,
+        // Condition a, body b. The slots from c on are free while it runs.
+        WHILE_LOOP,
+
+        // Forms of the operators and statements above whose operands, or
+        // conditions, type inference has proven to be numbers or booleans,
+        // so that the interpreter does not check them. Passes give nodes
+        // these opcodes after resolving, so they are never serialized.
+        ADD_NUMBERS,
+        SUBTRACT_NUMBERS,
+        MULTIPLY_NUMBERS,
+        DIVIDE_NUMBERS,
+        GREATER_NUMBERS,
+        GREATER_EQUAL_NUMBERS,
+        LESS_NUMBERS,
+        LESS_EQUAL_NUMBERS,
+        AND_BOOLEANS,
+        OR_BOOLEANS,
+        NEGATE_NUMBER,
+        NOT_BOOLEAN,
+        IF_ELSE_BOOLEAN,
+        WHILE_LOOP_BOOLEAN,
+
+        // Superinstructions, which run common shapes of the forms above in a
+        // single step. Each keeps the nodes it stands for in a, which it
+        // falls back on and is raised as, and reads constant b and slot c.
+        // Like the unchecked forms, they are never serialized.
+        // Adds number b to the number in slot c, as in `i = i + 1`.
+        INCREMENT,
+        // Compares the number in slot c to number b, as in `i < 10`.
+        GREATER_CONSTANT,
+        GREATER_EQUAL_CONSTANT,
+        LESS_CONSTANT,
+        LESS_EQUAL_CONSTANT,
+        // Statement appending string b to slot c in place if it holds a
+        // string, as in `s = s + "x"`.
+        APPEND,
+
+        // Guarded forms that the interpreter quickens the generic operators
+        // above into while they run, once their operands have had the same
+        // types many times in a row. Each runs unchecked while its operands
+        // keep those types, and rewrites itself back into the generic
+        // operator for good once they do not. Operands a and b.
+        ADD_NUMBERS_GUARDED,
+        ADD_STRINGS_GUARDED,
+        SUBTRACT_NUMBERS_GUARDED,
+        MULTIPLY_NUMBERS_GUARDED,
+        DIVIDE_NUMBERS_GUARDED,
+        GREATER_NUMBERS_GUARDED,
+        GREATER_EQUAL_NUMBERS_GUARDED,
+        LESS_NUMBERS_GUARDED,
+        LESS_EQUAL_NUMBERS_GUARDED,
+    };
+
+    struct Node
+    {
+        Opcode opcode;
+        Index a;
+        Index b;
+        Index c;
+    };
+
+    FlatAst() = delete;
+    explicit FlatAst(Source source);
+    // Names of temporaries refer into the flat AST itself.
+    FlatAst(const FlatAst&) = delete;
+    FlatAst& operator=(const FlatAst&) = delete;
+    FlatAst(FlatAst&&) = default;
+    FlatAst& operator=(FlatAst&&) = default;
+    // Appends a node with the given operands. Returns its index.
+    Index add(const Opcode opcode, const Token::Position& position, const Index a, const Index b = NONE, const Index c = NONE);
+    // Appends a constant, unless an equal one was appended before. Returns
+    // its index.
+    Index add_constant(Token::Literal constant);
+    // Appends a name, unless it was appended before. Returns its index.
+    Index add_name(std::string_view name);
+    // Appends the name of a temporary that a pass introduces, which no name
+    // in the source can clash with. Returns its index.
+    Index add_temporary_name();
+    // Appends a list of nodes. Returns the index of its first element.
+    Index add_list(const std::vector<Index>& nodes);
+    // Appends a top-level statement.
+    void add_statement(const Index statement);
+    // Notes that the top-level statements need the stack to have at least the
+    // given size while they run, for the temporaries passes give them.
+    void reserve_stack(const std::size_t size);
+    // Overwrites the node at the given index with the node at another index.
+    void replace(const Index index, const Index replacement);
+    const Node& node(const Index index) const;
+    Node& node(const Index index);
+    // Returns the position the node at the given index reports errors at.
+    Token::Position position(const Index index) const;
+    const Token::Literal& constant(const Index index) const;
+    std::string_view name(const Index index) const;
+    std::span<const Index> list(const Index first, const Index size) const;
+    std::span<Index> list(const Index first, const Index size);
+    // Returns the top-level statements in order.
+    std::span<const Index> statements() const;
+    // Returns the size the stack must have while the top-level statements
+    // run, or zero if the globals are all they need.
+    std::size_t reserved_stack() const;
+    // Returns the number of nodes.
+    std::size_t size() const;
+    const Source& source() const;
+    // Appends the binary form of the flat AST to the given buffer. Names are
+    // written as ranges of the source, which is not written itself, so there
+    // must be no temporaries. The form
+    // is meant to be read back on the same machine, so it uses native byte
+    // order.
+    void serialize(std::string& buffer) const;
+    // Reads the binary form written by serialize for the given source.
+    // Returns nothing if the data is truncated, refers outside the source or
+    // repeats a name or constant.
+    static std::optional<FlatAst> deserialize(std::string_view data, Source source);
+private:
+    // Tells constants apart by their bits, so that 0 and -0 stay distinct.
+    struct ConstantHash
+    {
+        std::size_t operator()(const Token::Literal& constant) const;
+    };
+    struct ConstantEqual
+    {
+        bool operator()(const Token::Literal& left, const Token::Literal& right) const;
+    };
+    Source source_;
+    std::vector<Node> nodes_;
+    std::vector<Token::Position> positions_;
+    std::vector<Token::Literal> constants_;
+    std::vector<std::string_view> names_;
+    std::deque<std::string> temporary_names_;
+    std::vector<Index> lists_;
+    std::vector<Index> statements_;
+    std::size_t reserved_stack_{0};
+    std::unordered_map<Token::Literal, Index, ConstantHash, ConstantEqual> constant_indices_;
+    std::unordered_map<std::string_view, Index> name_indices_;
+};
+
+
+// Lowers the tree form of the given program into its flat form, which shares
+// the source of the program but not its arena.
+FlatAst lower(const Program& program);
+
+
+// Lowers the tree form of the given statement into the given flat AST.
+// Returns the index of its flat node.
+FlatAst::Index lower(const Statement& statement, FlatAst& ast);
+
+
+// Rebuilds the tree form of the given flat AST in the given arena, so that
+// tree visitors such as ExpressionToString can walk it. Returns the top-level
+// statements in order.
+std::vector<Statement*> raise(const FlatAst& ast, Arena& arena);
+
+
+// Rebuilds the tree form of the statement at the given index of the given
+// flat AST in the given arena.
+Statement* raise(const FlatAst& ast, const FlatAst::Index statement, Arena& arena);
@@ -0,0 +1,54 @@
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "hash.hpp"
+
+
+constexpr std::uint64_t rotate_left(const std::uint64_t value, const int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+// Final mix of MurmurHash3, after which every input bit affects every
+// output bit.
+constexpr std::uint64_t mix(std::uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+
+// Follows the 64-bit lane of MurmurHash3, consuming eight bytes at a time.
+std::uint64_t hash(const std::string_view data, const std::uint64_t seed)
+{
+    constexpr std::uint64_t C1 = 0x87c37b91114253d5ull;
+    constexpr std::uint64_t C2 = 0x4cf5ad432745937full;
+    std::uint64_t h = seed;
+    auto absorb = [&h](std::uint64_t word) {
+        word *= C1;
+        word = rotate_left(word, 31);
+        word *= C2;
+        h ^= word;
+    };
+    std::size_t offset = 0;
+    for (; offset + sizeof(std::uint64_t) <= data.size(); offset += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data.data() + offset, sizeof(word));
+        absorb(word);
+        h = rotate_left(h, 27) * 5 + 0x52dce729;
+    }
+    if (offset < data.size())
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, data.data() + offset, data.size() - offset);
+        absorb(word);
+    }
+    return mix(h ^ data.size());
+}
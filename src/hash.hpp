@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+
+// Hashes the given bytes into 64 bits. Different seeds give independent
+// hashes of the same bytes. The hash is fast rather than cryptographic: it
+// identifies content, such as the source of a cached program, but offers no
+// protection against deliberately constructed collisions.
+std::uint64_t hash(std::string_view data, const std::uint64_t seed = 0);
@@ -1,279 +1,795 @@
 #include <memory>
+#include <algorithm>
 #include <cassert>
 #include <variant>
 #include <cstddef>
 #include <iostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "beeline.hpp"
 #include "lexer.hpp"
 #include "ast.hpp"
+#include "flat_ast.hpp"
 #include "interpreter.hpp"
-#include "environment.hpp"
-#include "replace.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "pass_manager.hpp"
+#include "type_checker.hpp"
 #include "logging.hpp"
 
 
-// Post-order AST visitor that interprets the program.
-class Interpreter::Impl : public Expression::Visitor, public Statement::Visitor
+using Opcode = FlatAst::Opcode;
+
+
+// Returns the guarded form of the given generic arithmetic or comparison
+// operator, for operands that are strings or numbers.
+Opcode guarded_form(const Opcode opcode, const bool strings)
 {
-public:
-    void visit(const Expression::Binary& binary) override
+    switch (opcode)
     {
-        Token::Literal left;
-        Token::Literal right;
+        case Opcode::ADD: return strings ? Opcode::ADD_STRINGS_GUARDED : Opcode::ADD_NUMBERS_GUARDED;
+        case Opcode::SUBTRACT: return Opcode::SUBTRACT_NUMBERS_GUARDED;
+        case Opcode::MULTIPLY: return Opcode::MULTIPLY_NUMBERS_GUARDED;
+        case Opcode::DIVIDE: return Opcode::DIVIDE_NUMBERS_GUARDED;
+        case Opcode::GREATER: return Opcode::GREATER_NUMBERS_GUARDED;
+        case Opcode::GREATER_EQUAL: return Opcode::GREATER_EQUAL_NUMBERS_GUARDED;
+        case Opcode::LESS: return Opcode::LESS_NUMBERS_GUARDED;
+        case Opcode::LESS_EQUAL: return Opcode::LESS_EQUAL_NUMBERS_GUARDED;
+        default: assert(false && "operator has no guarded form");
+    }
+    return opcode;
+}
+
 
-        switch (binary.op.type)
+// Returns the generic form of the given guarded operator.
+Opcode generic_form(const Opcode opcode)
+{
+    switch (opcode)
+    {
+        case Opcode::ADD_NUMBERS_GUARDED:
+        case Opcode::ADD_STRINGS_GUARDED: return Opcode::ADD;
+        case Opcode::SUBTRACT_NUMBERS_GUARDED: return Opcode::SUBTRACT;
+        case Opcode::MULTIPLY_NUMBERS_GUARDED: return Opcode::MULTIPLY;
+        case Opcode::DIVIDE_NUMBERS_GUARDED: return Opcode::DIVIDE;
+        case Opcode::GREATER_NUMBERS_GUARDED: return Opcode::GREATER;
+        case Opcode::GREATER_EQUAL_NUMBERS_GUARDED: return Opcode::GREATER_EQUAL;
+        case Opcode::LESS_NUMBERS_GUARDED: return Opcode::LESS;
+        case Opcode::LESS_EQUAL_NUMBERS_GUARDED: return Opcode::LESS_EQUAL;
+        default: assert(false && "operator is not guarded");
+    }
+    return opcode;
+}
+
+
+// Interprets programs by walking their flat form. Nodes are dispatched with
+// a switch on their opcode, and expressions return their values directly.
+// Variables live in a stack of values, at the slots the resolver assigns
+// them, and each block grows the stack by its variables while it runs.
+class Interpreter::Impl
+{
+public:
+    explicit Impl(const OptimizationOptions& optimization = {}) : passes_{optimization} {}
+    void interpret(FlatAst& ast)
+    {
+        resolver_.resolve(ast);
+        // The source resolves the positions of runtime errors, and holds the
+        // bodies of lazy blocks.
+        source_ = &ast.source();
+        ast_ = &ast;
+        stack_.resize(resolver_.global_count());
+        const std::span<const FlatAst::Index> statements = ast.statements();
+        std::size_t executed = 0;
+        try
         {
-            case Token::Type::AND:
-                binary.left->accept(*this);
-                left = value_;
-                require<bool>(left, binary.op, "left operand must be a boolean");
-                // short-circuit evaluation
-                if (std::get<bool>(left))
-                {
-                    binary.right->accept(*this);
-                    right = value_;
-                    require<bool>(right, binary.op, "right operand must be a boolean");
-                }
-                break;
-            case Token::Type::OR:
-                binary.left->accept(*this);
-                left = value_;
-                require<bool>(left, binary.op, "left operand must be a boolean");
+            // Whatever passes run, type errors fail the program before any
+            // of it runs.
+            check_types(ast);
+            passes_.run(ast, stack_.size());
+            // The passes may give the top-level statements temporaries above
+            // the globals, which are dropped once the program has run.
+            stack_.resize(std::max(stack_.size(), ast.reserved_stack()));
+            for (; executed < statements.size(); ++executed)
+            {
+                execute(statements[executed]);
+            }
+            stack_.resize(resolver_.global_count());
+        }
+        catch (...)
+        {
+            forget_globals(statements.subspan(executed));
+            throw;
+        }
+    }
+    Token::Literal evaluate_constant(FlatAst& ast, const FlatAst::Index expression)
+    {
+        source_ = &ast.source();
+        ast_ = &ast;
+        return evaluate(expression);
+    }
+private:
+    // Kinds of operands that generic operators record in their slot c.
+    static constexpr FlatAst::Index NUMBERS = 0;
+    static constexpr FlatAst::Index STRINGS = 1;
+    // Times in a row a generic operator must see the same kind of operands
+    // before it is quickened.
+    static constexpr FlatAst::Index QUICKENING_THRESHOLD = 16;
+    // Marks in slot c a generic operator that is not quickened again.
+    static constexpr FlatAst::Index MEGAMORPHIC = FlatAst::NONE - 1;
+    const Source* source_{nullptr};
+    // Grows as lazy blocks are parsed, so nodes are copied rather than
+    // referenced across the execution of statements.
+    FlatAst* ast_{nullptr};
+    Token::Literal evaluate(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_->node(index);
+        switch (node.opcode)
+        {
+            case Opcode::AND:
+            {
+                Token::Literal left = evaluate(node.a);
+                require<bool>(left, index, "left operand must be a boolean");
                 // short-circuit evaluation
                 if (!std::get<bool>(left))
                 {
-                    binary.right->accept(*this);
-                    right = value_;
-                    require<bool>(right, binary.op, "right operand must be a boolean");
+                    return left;
                 }
-                break;
-            case Token::Type::MINUS:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require<double>(left, binary.op, "left operand must be a number");
-                require<double>(right, binary.op, "right operand must be a number");
-                value_ = std::get<double>(left) - std::get<double>(right);
-                break;
-            case Token::Type::SLASH:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require<double>(left, binary.op, "left operand must be a number");
-                require<double>(right, binary.op, "right operand must be a number");
-                if (std::get<double>(right) == 0)
-                {
-                    panic(binary.op, "division by zero");
-                }
-                value_ = std::get<double>(left) / std::get<double>(right);
-                break;
-            case Token::Type::STAR:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require<double>(left, binary.op, "left operand must be a number");
-                require<double>(right, binary.op, "right operand must be a number");
-                value_ = std::get<double>(left) * std::get<double>(right);
-                break;
-            case Token::Type::PLUS:
+                Token::Literal right = evaluate(node.b);
+                require<bool>(right, index, "right operand must be a boolean");
+                return right;
+            }
+            case Opcode::OR:
             {
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require_not<std::nullptr_t>(left, binary.op, "left operand must not be null");
-                require_not<std::nullptr_t>(right, binary.op, "right operand must not be null");
-                if (std::holds_alternative<bool>(left) && std::holds_alternative<bool>(right))
+                Token::Literal left = evaluate(node.a);
+                require<bool>(left, index, "left operand must be a boolean");
+                // short-circuit evaluation
+                if (std::get<bool>(left))
                 {
-                    panic(binary.op, "cannot add two booleans");
+                    return left;
                 }
-                const bool is_concatenation = std::holds_alternative<std::string>(left) || std::holds_alternative<std::string>(right);
-                if (is_concatenation)
+                Token::Literal right = evaluate(node.b);
+                require<bool>(right, index, "right operand must be a boolean");
+                return right;
+            }
+            case Opcode::ADD:
+            case Opcode::SUBTRACT:
+            case Opcode::MULTIPLY:
+            case Opcode::DIVIDE:
+            case Opcode::GREATER:
+            case Opcode::GREATER_EQUAL:
+            case Opcode::LESS:
+            case Opcode::LESS_EQUAL:
+            {
+                Token::Literal left = evaluate(node.a);
+                Token::Literal right = evaluate(node.b);
+                // Observing the operands may quicken the operator.
+                const Opcode opcode = node.opcode;
+                observe(index, left, right);
+                return apply(index, opcode, std::move(left), std::move(right));
+            }
+            case Opcode::NOT_EQUAL:
+                return !equals(index);
+            case Opcode::EQUAL:
+                return equals(index);
+            case Opcode::GROUPING:
+                return evaluate(node.a);
+            case Opcode::LITERAL:
+                return ast_->constant(node.a);
+            case Opcode::NEGATE:
+            {
+                const Token::Literal right = evaluate(node.a);
+                require<double>(right, index, "operand must be a number");
+                return -std::get<double>(right);
+            }
+            case Opcode::NOT:
+            {
+                const Token::Literal right = evaluate(node.a);
+                require<bool>(right, index, "operand must be a boolean");
+                return !std::get<bool>(right);
+            }
+            case Opcode::VARIABLE:
+                return stack_[node.c];
+            case Opcode::ASSIGNMENT:
+            {
+                Token::Literal value = evaluate(node.b);
+                stack_[node.c] = value;
+                return value;
+            }
+            case Opcode::ADD_NUMBERS:
+            case Opcode::SUBTRACT_NUMBERS:
+            case Opcode::MULTIPLY_NUMBERS:
+            case Opcode::DIVIDE_NUMBERS:
+            case Opcode::NEGATE_NUMBER:
+            case Opcode::INCREMENT:
+                return evaluate_number(index);
+            case Opcode::GREATER_NUMBERS:
+            case Opcode::GREATER_EQUAL_NUMBERS:
+            case Opcode::LESS_NUMBERS:
+            case Opcode::LESS_EQUAL_NUMBERS:
+            case Opcode::AND_BOOLEANS:
+            case Opcode::OR_BOOLEANS:
+            case Opcode::NOT_BOOLEAN:
+            case Opcode::GREATER_CONSTANT:
+            case Opcode::GREATER_EQUAL_CONSTANT:
+            case Opcode::LESS_CONSTANT:
+            case Opcode::LESS_EQUAL_CONSTANT:
+                return evaluate_boolean(index);
+            case Opcode::ADD_NUMBERS_GUARDED:
+            case Opcode::SUBTRACT_NUMBERS_GUARDED:
+            case Opcode::MULTIPLY_NUMBERS_GUARDED:
+            case Opcode::DIVIDE_NUMBERS_GUARDED:
+            {
+                double number;
+                Token::Literal value;
+                if (evaluate_guarded_number(index, number, value))
                 {
-                    to_string(left);
-                    to_string(right);
-                    value_ = std::get<std::string>(left) + std::get<std::string>(right);
+                    return number;
                 }
-                else
+                return value;
+            }
+            case Opcode::GREATER_NUMBERS_GUARDED:
+            case Opcode::GREATER_EQUAL_NUMBERS_GUARDED:
+            case Opcode::LESS_NUMBERS_GUARDED:
+            case Opcode::LESS_EQUAL_NUMBERS_GUARDED:
+                return evaluate_guarded_comparison(index);
+            case Opcode::ADD_STRINGS_GUARDED:
+                return evaluate_guarded_concatenation(index);
+            default:
+                assert(false && "node is not an expression");
+        }
+        return nullptr;
+    }
+    // Evaluates an expression that type inference has proven to be a number,
+    // without checking it. Unchecked operators compute their operands as
+    // numbers too, without making values of them.
+    double evaluate_number(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_->node(index);
+        switch (node.opcode)
+        {
+            case Opcode::ADD_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                return left + evaluate_number(node.b);
+            }
+            case Opcode::SUBTRACT_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                return left - evaluate_number(node.b);
+            }
+            case Opcode::MULTIPLY_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                return left * evaluate_number(node.b);
+            }
+            case Opcode::DIVIDE_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                const double right = evaluate_number(node.b);
+                if (right == 0)
                 {
-                    require<double>(left, binary.op, "left operand must be a number to participate in addition");
-                    require<double>(right, binary.op, "right operand must be a number to participate in addition");
-                    value_ = std::get<double>(left) + std::get<double>(right);
+                    panic(index, "division by zero");
                 }
-                break;
+                return left / right;
             }
-            case Token::Type::GREATER:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require<double>(left, binary.op, "left operand must be a number");
-                require<double>(right, binary.op, "right operand must be a number");
-                value_ = std::get<double>(left) > std::get<double>(right);
-                break;
-            case Token::Type::GREATER_EQUAL:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require<double>(left, binary.op, "left operand must be a number");
-                require<double>(right, binary.op, "right operand must be a number");
-                value_ = std::get<double>(left) >= std::get<double>(right);
-                break;
-            case Token::Type::LESS:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require<double>(left, binary.op, "left operand must be a number");
-                require<double>(right, binary.op, "right operand must be a number");
-                value_ = std::get<double>(left) < std::get<double>(right);
-                break;
-            case Token::Type::LESS_EQUAL:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                require<double>(left, binary.op, "left operand must be a number");
-                require<double>(right, binary.op, "right operand must be a number");
-                value_ = std::get<double>(left) <= std::get<double>(right);
-                break;
-            case Token::Type::BANG_EQUAL:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                value_ = left != right;
-                break;
-            case Token::Type::EQUAL_EQUAL:
-                binary.left->accept(*this);
-                left = value_;
-                binary.right->accept(*this);
-                right = value_;
-                value_ = left == right;
-                break;
+            case Opcode::NEGATE_NUMBER:
+                return -evaluate_number(node.a);
+            case Opcode::INCREMENT:
+                return *std::get_if<double>(&stack_[node.c]) += *std::get_if<double>(&ast_->constant(node.b));
+            case Opcode::ADD_NUMBERS_GUARDED:
+            case Opcode::SUBTRACT_NUMBERS_GUARDED:
+            case Opcode::MULTIPLY_NUMBERS_GUARDED:
+            case Opcode::DIVIDE_NUMBERS_GUARDED:
+            {
+                // Proven to be a number even if its guard fails.
+                double number;
+                Token::Literal value;
+                evaluate_guarded_number(index, number, value);
+                return number;
+            }
+            case Opcode::LITERAL:
+                return *std::get_if<double>(&ast_->constant(node.a));
+            case Opcode::VARIABLE:
+                return *std::get_if<double>(&stack_[node.c]);
             default:
-                assert(false && "unhandled binary operator");
+            {
+                const Token::Literal value = evaluate(index);
+                return *std::get_if<double>(&value);
+            }
         }
     }
-    void visit(const Expression::Grouping& grouping) override
+    // Evaluates an expression that type inference has proven to be a
+    // boolean, without checking it.
+    bool evaluate_boolean(const FlatAst::Index index)
     {
-        grouping.expression->accept(*this);
+        const FlatAst::Node& node = ast_->node(index);
+        switch (node.opcode)
+        {
+            case Opcode::GREATER_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                return left > evaluate_number(node.b);
+            }
+            case Opcode::GREATER_EQUAL_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                return left >= evaluate_number(node.b);
+            }
+            case Opcode::LESS_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                return left < evaluate_number(node.b);
+            }
+            case Opcode::LESS_EQUAL_NUMBERS:
+            {
+                const double left = evaluate_number(node.a);
+                return left <= evaluate_number(node.b);
+            }
+            case Opcode::AND_BOOLEANS:
+                return evaluate_boolean(node.a) && evaluate_boolean(node.b);
+            case Opcode::OR_BOOLEANS:
+                return evaluate_boolean(node.a) || evaluate_boolean(node.b);
+            case Opcode::NOT_BOOLEAN:
+                return !evaluate_boolean(node.a);
+            case Opcode::GREATER_CONSTANT:
+                return *std::get_if<double>(&stack_[node.c]) > *std::get_if<double>(&ast_->constant(node.b));
+            case Opcode::GREATER_EQUAL_CONSTANT:
+                return *std::get_if<double>(&stack_[node.c]) >= *std::get_if<double>(&ast_->constant(node.b));
+            case Opcode::LESS_CONSTANT:
+                return *std::get_if<double>(&stack_[node.c]) < *std::get_if<double>(&ast_->constant(node.b));
+            case Opcode::LESS_EQUAL_CONSTANT:
+                return *std::get_if<double>(&stack_[node.c]) <= *std::get_if<double>(&ast_->constant(node.b));
+            case Opcode::LITERAL:
+                return *std::get_if<bool>(&ast_->constant(node.a));
+            case Opcode::VARIABLE:
+                return *std::get_if<bool>(&stack_[node.c]);
+            default:
+            {
+                const Token::Literal value = evaluate(index);
+                return *std::get_if<bool>(&value);
+            }
+        }
     }
-    void visit(const Expression::Literal& literal) override
+    // Returns where the value of the expression at the given index is stored,
+    // if it is a literal or a variable, or nullptr otherwise.
+    const Token::Literal* stored(const FlatAst::Index index) const
     {
-        value_ = literal.value;
+        const FlatAst::Node& node = ast_->node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                return &ast_->constant(node.a);
+            case Opcode::VARIABLE:
+                return &stack_[node.c];
+            case Opcode::GROUPING:
+                return stored(node.a);
+            default:
+                return nullptr;
+        }
     }
-    void visit(const Expression::Unary& unary) override
+    // Compares the operands of an equality node, reading literals and
+    // variables where they are stored instead of copying them. Constants are
+    // interned, so equal string literals are the same object.
+    bool equals(const FlatAst::Index index)
     {
-        unary.right->accept(*this);
-        switch (unary.op.type)
+        const FlatAst::Node& node = ast_->node(index);
+        const Token::Literal* right = stored(node.b);
+        if (right == nullptr)
         {
-            case Token::Type::MINUS:
-                require<double>(value_, unary.op, "operand must be a number");
-                value_ = -(std::get<double>(value_));
-                break;
-            case Token::Type::BANG:
-                require<bool>(value_, unary.op, "operand must be a boolean");
-                value_ = !(std::get<bool>(value_));
-                break;
+            const Token::Literal left = evaluate(node.a);
+            return left == evaluate(node.b);
+        }
+        // Reading the right operand has no side effects, so it is still
+        // current after the left one is evaluated.
+        const Token::Literal* left = stored(node.a);
+        if (left == nullptr)
+        {
+            return evaluate(node.a) == *right;
+        }
+        // Strings only, as NaN is not equal to itself.
+        if (left == right && std::holds_alternative<std::string>(*left))
+        {
+            return true;
+        }
+        return *left == *right;
+    }
+    // Applies the given generic arithmetic or comparison operator, at the
+    // given index, to the given operands, checking their types.
+    Token::Literal apply(const FlatAst::Index index, const Opcode opcode, Token::Literal left, Token::Literal right)
+    {
+        if (opcode == Opcode::ADD)
+        {
+            require_not<std::nullptr_t>(left, index, "left operand must not be null");
+            require_not<std::nullptr_t>(right, index, "right operand must not be null");
+            if (std::holds_alternative<bool>(left) && std::holds_alternative<bool>(right))
+            {
+                panic(index, "cannot add two booleans");
+            }
+            const bool is_concatenation = std::holds_alternative<std::string>(left) || std::holds_alternative<std::string>(right);
+            if (is_concatenation)
+            {
+                to_string(left);
+                to_string(right);
+                return std::get<std::string>(left) + std::get<std::string>(right);
+            }
+            require<double>(left, index, "left operand must be a number to participate in addition");
+            require<double>(right, index, "right operand must be a number to participate in addition");
+            return std::get<double>(left) + std::get<double>(right);
+        }
+        require<double>(left, index, "left operand must be a number");
+        require<double>(right, index, "right operand must be a number");
+        const double left_number = std::get<double>(left);
+        const double right_number = std::get<double>(right);
+        switch (opcode)
+        {
+            case Opcode::SUBTRACT:
+                return left_number - right_number;
+            case Opcode::MULTIPLY:
+                return left_number * right_number;
+            case Opcode::DIVIDE:
+                if (right_number == 0)
+                {
+                    panic(index, "division by zero");
+                }
+                return left_number / right_number;
+            case Opcode::GREATER:
+                return left_number > right_number;
+            case Opcode::GREATER_EQUAL:
+                return left_number >= right_number;
+            case Opcode::LESS:
+                return left_number < right_number;
+            case Opcode::LESS_EQUAL:
+                return left_number <= right_number;
             default:
-                assert(false && "unhandled unary operator");
+                assert(false && "node is not an arithmetic or comparison operator");
         }
+        return nullptr;
     }
-    void visit(const Expression::Variable& variable) override
+    // Records the types of the operands of the generic operator at the given
+    // index in its slot c, which counts how many times in a row they have
+    // been numbers, or strings for additions, and is NONE before they have
+    // been either. Once they have been the same often enough, the operator
+    // is quickened: it rewrites itself into the guarded form for them.
+    void observe(const FlatAst::Index index, const Token::Literal& left, const Token::Literal& right)
     {
-        value_ = environment_.get(variable.name.lexeme, variable.name.position);
+        FlatAst::Node& node = ast_->node(index);
+        if (node.c == MEGAMORPHIC)
+        {
+            return;
+        }
+        FlatAst::Index feedback;
+        if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right))
+        {
+            feedback = NUMBERS;
+        }
+        else if (node.opcode == Opcode::ADD && std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right))
+        {
+            feedback = STRINGS;
+        }
+        else
+        {
+            node.c = FlatAst::NONE;
+            return;
+        }
+        const FlatAst::Index count = node.c != FlatAst::NONE && (node.c & 1) == feedback ? (node.c >> 1) + 1 : 1;
+        if (count < QUICKENING_THRESHOLD)
+        {
+            node.c = count << 1 | feedback;
+            return;
+        }
+        node.opcode = guarded_form(node.opcode, feedback == STRINGS);
+        node.c = FlatAst::NONE;
     }
-    void visit(const Expression::Assignment& assignment) override
+    // Rewrites the guarded operator at the given index, whose guard failed,
+    // back into its generic form for good, as its operands change types.
+    void deoptimize(const FlatAst::Index index)
     {
-        assignment.value->accept(*this);
-        environment_.assign(assignment.name.lexeme, value_, assignment.name.position);
+        FlatAst::Node& node = ast_->node(index);
+        node.opcode = generic_form(node.opcode);
+        node.c = MEGAMORPHIC;
     }
-    void visit(const Statement::Expression& expression) override
+    // Evaluates the expression at the given index into the given number if
+    // it is one, without making a value of it where it can, or into the given
+    // value otherwise. Returns whether it is a number.
+    bool speculate_number(const FlatAst::Index index, double& number, Token::Literal& value)
     {
-        expression.expression->accept(*this);
+        const FlatAst::Node& node = ast_->node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+            case Opcode::VARIABLE:
+            {
+                const Token::Literal& stored_value = *stored(index);
+                if (const double* stored_number = std::get_if<double>(&stored_value))
+                {
+                    number = *stored_number;
+                    return true;
+                }
+                value = stored_value;
+                return false;
+            }
+            case Opcode::ADD_NUMBERS:
+            case Opcode::SUBTRACT_NUMBERS:
+            case Opcode::MULTIPLY_NUMBERS:
+            case Opcode::DIVIDE_NUMBERS:
+            case Opcode::NEGATE_NUMBER:
+            case Opcode::INCREMENT:
+                number = evaluate_number(index);
+                return true;
+            case Opcode::ADD_NUMBERS_GUARDED:
+            case Opcode::SUBTRACT_NUMBERS_GUARDED:
+            case Opcode::MULTIPLY_NUMBERS_GUARDED:
+            case Opcode::DIVIDE_NUMBERS_GUARDED:
+                return evaluate_guarded_number(index, number, value);
+            default:
+                value = evaluate(index);
+                if (const double* evaluated_number = std::get_if<double>(&value))
+                {
+                    number = *evaluated_number;
+                    return true;
+                }
+                return false;
+        }
     }
-    void visit(const Statement::Print& print) override
+    // Evaluates the operands of the guarded operator at the given index as
+    // numbers. Returns whether both are, or deoptimizes the operator and
+    // puts them in the given values otherwise.
+    bool speculate_numbers(const FlatAst::Index index, double& left, double& right, Token::Literal& left_value, Token::Literal& right_value)
     {
-        print.expression->accept(*this);
-        require<std::string>(value_, print.keyword, "operand must be a string");
-        std::cout << std::get<std::string>(value_);
+        const FlatAst::Node& node = ast_->node(index);
+        const FlatAst::Index right_operand = node.b;
+        const bool is_left_number = speculate_number(node.a, left, left_value);
+        const bool is_right_number = speculate_number(right_operand, right, right_value);
+        if (is_left_number && is_right_number)
+        {
+            return true;
+        }
+        deoptimize(index);
+        if (is_left_number)
+        {
+            left_value = left;
+        }
+        if (is_right_number)
+        {
+            right_value = right;
+        }
+        return false;
     }
-    void visit(const Statement::VariableDeclaration& variable_declaration) override
+    // Evaluates the guarded arithmetic operator at the given index into the
+    // given number, or into the given value through the generic operator if
+    // its guard fails. Returns whether the result is a number.
+    bool evaluate_guarded_number(const FlatAst::Index index, double& number, Token::Literal& value)
     {
-        value_ = nullptr;
-        if (variable_declaration.initializer)
+        const Opcode opcode = ast_->node(index).opcode;
+        double left;
+        double right;
+        Token::Literal left_value;
+        Token::Literal right_value;
+        if (!speculate_numbers(index, left, right, left_value, right_value))
+        {
+            value = apply(index, generic_form(opcode), std::move(left_value), std::move(right_value));
+            if (const double* result = std::get_if<double>(&value))
+            {
+                number = *result;
+                return true;
+            }
+            return false;
+        }
+        switch (opcode)
         {
-            variable_declaration.initializer->accept(*this);
+            case Opcode::ADD_NUMBERS_GUARDED:
+                number = left + right;
+                break;
+            case Opcode::SUBTRACT_NUMBERS_GUARDED:
+                number = left - right;
+                break;
+            case Opcode::MULTIPLY_NUMBERS_GUARDED:
+                number = left * right;
+                break;
+            default:
+                if (right == 0)
+                {
+                    panic(index, "division by zero");
+                }
+                number = left / right;
+                break;
         }
-        environment_.define(variable_declaration.name.lexeme, value_, variable_declaration.name.position);
+        return true;
     }
-    void visit(const Statement::Block& block) override
+    // Evaluates the guarded comparison at the given index, or the generic
+    // comparison if its guard fails.
+    Token::Literal evaluate_guarded_comparison(const FlatAst::Index index)
     {
-        // Replaces the current environment with a new one that is nested within the current one.
-        // After the block is executed, the old environment is restored.
-        ScopedReplace replacer(environment_, Environment{}.nested(environment_));
-        for (const std::unique_ptr<Statement>& statement : block.statements)
+        const Opcode opcode = ast_->node(index).opcode;
+        double left;
+        double right;
+        Token::Literal left_value;
+        Token::Literal right_value;
+        if (!speculate_numbers(index, left, right, left_value, right_value))
+        {
+            return apply(index, generic_form(opcode), std::move(left_value), std::move(right_value));
+        }
+        switch (opcode)
         {
-            statement->accept(*this);
+            case Opcode::GREATER_NUMBERS_GUARDED:
+                return left > right;
+            case Opcode::GREATER_EQUAL_NUMBERS_GUARDED:
+                return left >= right;
+            case Opcode::LESS_NUMBERS_GUARDED:
+                return left < right;
+            default:
+                return left <= right;
         }
-        value_ = nullptr;
     }
-    void visit(const Statement::IfElse& if_else) override
+    // Evaluates the guarded concatenation at the given index, or the generic
+    // addition if its guard fails. The left operand is appended to in place,
+    // and read where it is stored if the right one cannot change it.
+    Token::Literal evaluate_guarded_concatenation(const FlatAst::Index index)
     {
-        if_else.condition->accept(*this);
-        require<bool>(value_, if_else.if_keyword, "condition must evaluate to a boolean");
-        if (std::get<bool>(value_))
+        const FlatAst::Node& node = ast_->node(index);
+        const FlatAst::Index right_operand = node.b;
+        if (const Token::Literal* right = stored(right_operand))
         {
-            if_else.then_statement->accept(*this);
+            if (const Token::Literal* left = stored(node.a))
+            {
+                const std::string* left_string = std::get_if<std::string>(left);
+                const std::string* right_string = std::get_if<std::string>(right);
+                if (left_string && right_string)
+                {
+                    return *left_string + *right_string;
+                }
+            }
         }
-        else if (if_else.else_statement)
+        Token::Literal left = evaluate(node.a);
+        Token::Literal right = evaluate(right_operand);
+        std::string* left_string = std::get_if<std::string>(&left);
+        const std::string* right_string = std::get_if<std::string>(&right);
+        if (left_string && right_string)
         {
-            if_else.else_statement->accept(*this);
+            *left_string += *right_string;
+            return left;
         }
-        value_ = nullptr;
+        deoptimize(index);
+        return apply(index, Opcode::ADD, std::move(left), std::move(right));
     }
-    void visit(const Statement::WhileLoop& while_loop) override
+    void execute(const FlatAst::Index index)
     {
-        auto check_condition = [&]() -> bool
+        const FlatAst::Node node = ast_->node(index);
+        switch (node.opcode)
         {
-            while_loop.condition->accept(*this);
-            require<bool>(value_, while_loop.keyword, "condition must evaluate to a boolean");
-            return std::get<bool>(value_);
-        };
-        while (check_condition())
+            case Opcode::EXPRESSION:
+                evaluate(node.a);
+                break;
+            case Opcode::APPEND:
+                // Appending in place spares copying the string twice.
+                if (std::string* value = std::get_if<std::string>(&stack_[node.c]))
+                {
+                    *value += *std::get_if<std::string>(&ast_->constant(node.b));
+                }
+                else
+                {
+                    evaluate(node.a);
+                }
+                break;
+            case Opcode::PRINT:
+            {
+                const Token::Literal value = evaluate(node.a);
+                require<std::string>(value, index, "operand must be a string");
+                std::cout << std::get<std::string>(value);
+                break;
+            }
+            case Opcode::VARIABLE_DECLARATION:
+                stack_[node.c] = node.b == FlatAst::NONE ? Token::Literal{nullptr} : evaluate(node.b);
+                break;
+            case Opcode::BLOCK:
+            {
+                // The variables of the block are dropped when it ends.
+                const std::size_t stack_size = stack_.size();
+                stack_.resize(stack_size + node.c);
+                for (FlatAst::Index i = 0; i < node.b; ++i)
+                {
+                    execute(ast_->list(node.a, node.b)[i]);
+                }
+                stack_.resize(stack_size);
+                break;
+            }
+            case Opcode::LAZY_BLOCK:
+                expand(index);
+                execute(index);
+                break;
+            case Opcode::IF_ELSE:
+                if (check_condition(index))
+                {
+                    execute(node.b);
+                }
+                else if (node.c != FlatAst::NONE)
+                {
+                    execute(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                while (check_condition(index))
+                {
+                    execute(node.b);
+                }
+                break;
+            case Opcode::IF_ELSE_BOOLEAN:
+                if (evaluate_boolean(node.a))
+                {
+                    execute(node.b);
+                }
+                else if (node.c != FlatAst::NONE)
+                {
+                    execute(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP_BOOLEAN:
+                while (evaluate_boolean(node.a))
+                {
+                    execute(node.b);
+                }
+                break;
+            default:
+                assert(false && "node is not a statement");
+        }
+    }
+    // Parses, lowers, resolves, checks and optimizes the lazy block at the
+    // given index, which becomes the block it stands for. Its syntax was
+    // checked and the variables it uses from outside were resolved along with
+    // the program.
+    void expand(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_->node(index);
+        const Program body = Parser{Lexer{*source_, ast_->position(index).offset, node.c}.scan(), true}.parse();
+        assert(body.statements.size() == 1 && body.statements.front()->kind == Statement::Kind::BLOCK);
+        const FlatAst::Index block = lower(*body.statements.front(), *ast_);
+        resolver_.resolve(*ast_, block, index, stack_.size());
+        check_types(*ast_, block);
+        passes_.run(*ast_, block, stack_.size());
+        ast_->replace(index, block);
+    }
+    // Forgets the globals declared by the given top-level statements, which
+    // did not run, and drops the variables of the blocks that were running.
+    void forget_globals(const std::span<const FlatAst::Index> statements)
+    {
+        const auto declaration = std::find_if(statements.begin(), statements.end(), [this](const FlatAst::Index statement) {
+            return ast_->node(statement).opcode == Opcode::VARIABLE_DECLARATION;
+        });
+        if (declaration != statements.end())
         {
-            while_loop.body->accept(*this);
+            resolver_.forget_globals(ast_->node(*declaration).c);
         }
-        value_ = nullptr;
+        stack_.resize(resolver_.global_count());
     }
-private:
-    Token::Literal value_;
-    void panic(const Token& token, const std::string& message) const
+    // Evaluates the condition of an if or while statement, which must be a boolean.
+    bool check_condition(const FlatAst::Index index)
     {
-        BeelineRuntimeError bre{message, token.position};
+        const Token::Literal condition = evaluate(ast_->node(index).a);
+        require<bool>(condition, index, "condition must evaluate to a boolean");
+        return std::get<bool>(condition);
+    }
+    void panic(const FlatAst::Index index, const std::string& message) const
+    {
+        BeelineRuntimeError bre{message, *source_, ast_->position(index)};
         log(LoggingLevel::ERROR) << bre;
         throw bre;
     }
     template <typename T>
-    void require(const Token::Literal& value, const Token& token, const std::string& message) const
+    void require(const Token::Literal& value, const FlatAst::Index index, const std::string& message) const
     {
         if (!std::holds_alternative<T>(value))
         {
-            panic(token, message);
+            panic(index, message);
         }
     }
     template <typename T>
-    void require_not(const Token::Literal& value, const Token& token, const std::string& message) const
+    void require_not(const Token::Literal& value, const FlatAst::Index index, const std::string& message) const
     {
         if (std::holds_alternative<T>(value))
         {
-            panic(token, message);
+            panic(index, message);
         }
     }
     void to_string(Token::Literal& value) const
@@ -298,25 +814,35 @@ private:
         }
     }
 private:
-    Environment environment_;
+    PassManager passes_;
+    Resolver resolver_;
+    std::vector<Token::Literal> stack_;
 };
 
 
-Interpreter::Interpreter() : impl_{std::make_unique<Impl>()} {}
+Interpreter::Interpreter(const OptimizationOptions& optimization) : impl_{std::make_unique<Impl>(optimization)} {}
 Interpreter::~Interpreter() = default;
-void Interpreter::interpret(const std::vector<std::unique_ptr<Statement>> statements)
+void Interpreter::interpret(Program&& program)
 {
-    for (const std::unique_ptr<Statement>& statement : statements)
-    {
-        statement->accept(*impl_);
-    }
+    FlatAst ast = lower(program);
+    impl_->interpret(ast);
+}
+void Interpreter::interpret(FlatAst&& ast)
+{
+    impl_->interpret(ast);
+}
+Token::Literal Interpreter::evaluate_constant(FlatAst& ast, const FlatAst::Index expression)
+{
+    const LoggingSilencer silencer;
+    return Impl{}.evaluate_constant(ast, expression);
 }
 
 
-BeelineRuntimeError::BeelineRuntimeError(const std::string& message, const Token::Position& position) : BeelineError{message}, position{position} {}
+BeelineRuntimeError::BeelineRuntimeError(const std::string& message, const Source& source, const Token::Position& position) : BeelineError{message}, source{source}, position{position} {}
 
 
 std::ostream& operator<<(std::ostream& os, const BeelineRuntimeError& bre)
 {
-    return os << "BeelineRuntimeError: " << bre.what() << " at " << bre.position;
+    return os << "BeelineRuntimeError: " << bre.what() << " at " << to_string(bre.source, bre.position);
 }
+
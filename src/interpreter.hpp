@@ -8,16 +8,32 @@
 #include "beeline.hpp"
 #include "lexer.hpp"
 #include "ast.hpp"
-
-
-// Interprets a list of statements.
+#include "program.hpp"
+#include "flat_ast.hpp"
+
+
+// Interprets programs. Variables defined by one program remain visible
+// to the programs interpreted after it. Each program is resolved and its
+// types checked before it runs, so one that uses an undefined variable, or
+// always runs an operation its operands can never have the types for, fails
+// without running. It is then optimized by the passes the given options
+// enable: constant expressions are folded, identities simplified, loop
+// invariants moved out of loops, repeated expressions computed once, the
+// types that are proven not checked and common shapes of nodes fused into
+// superinstructions.
 class Interpreter
 {
 public:
-    Interpreter();
+    explicit Interpreter(const OptimizationOptions& optimization = {});
     ~Interpreter();
-    // Interprets the given list of statements.
-    void interpret(const std::vector<std::unique_ptr<Statement>> statements);
+    // Interprets the given program, which must be moved in.
+    void interpret(Program&& program);
+    // Interprets the given flat form of a program, which must be moved in.
+    void interpret(FlatAst&& ast);
+    // Evaluates the expression at the given index of the given flat AST,
+    // which must not read variables. Throws a BeelineRuntimeError if the
+    // expression fails, without logging it.
+    static Token::Literal evaluate_constant(FlatAst& ast, const FlatAst::Index expression);
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
@@ -28,7 +44,8 @@ private:
 class BeelineRuntimeError : public BeelineError
 {
 public:
-    BeelineRuntimeError(const std::string& message, const Token::Position& position);
+    BeelineRuntimeError(const std::string& message, const Source& source, const Token::Position& position);
+    Source source;
     Token::Position position;
 };
 
@@ -1,25 +1,46 @@
-#include <unordered_map>
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
 #include <sstream>
 #include <cassert>
 #include <optional>
+#include <string_view>
+#include <limits>
+#include <cstdint>
+#include <system_error>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "lexer.hpp"
 #include "logging.hpp"
 
 
-constexpr char EOT = '\x04';
-
-
 BeelineSyntaxError::BeelineSyntaxError(
     const std::string& message,
+    const Source& source,
     const Token::Position& position
-) : BeelineError(message), position(position) {}
+) : BeelineError(message), source(source), position(position) {}
 
 
 std::ostream& operator<<(std::ostream& os, const BeelineSyntaxError& bse)
 {
-    return os << "BeelineSyntaxError: " << bse.what() << " at " << bse.position;
+    return os << "BeelineSyntaxError: " << bse.what() << " at " << to_string(bse.source, bse.position);
+}
+
+
+std::string to_string(const Source& source, const Token::Position& position)
+{
+    const Source::Location location = source.locate(position.offset);
+    std::ostringstream ss;
+    if (!source.name().empty())
+    {
+        ss << source.name() << ":";
+    }
+    ss << location.line << ":" << location.column << "-" << (location.column + position.length - 1);
+    return ss.str();
 }
 
 
@@ -65,7 +86,7 @@ std::ostream& operator<<(std::ostream& os, const Token::Type& type)
 
 std::ostream& operator<<(std::ostream& os, const Token::Position& position)
 {
-    return os << position.line << ":" << position.column << "-" << (position.column + position.length - 1);
+    return os << "@" << position.offset << "+" << position.length;
 }
 
 
@@ -95,16 +116,281 @@ std::ostream& operator<<(std::ostream& os, const Token::Literal& literal)
 
 std::ostream& operator<<(std::ostream& os, const Token& token)
 {
-    return os << token.type << " " << token.lexeme << " " << token.literal << " " << token.position;
+    return os << token.type << " " << token.lexeme << " " << token.position;
+}
+
+
+TokenStream::TokenStream(Source source) : source_{std::move(source)} {}
+
+
+void TokenStream::push_back(const Token::Type type, const Token::Position& position)
+{
+    types_.push_back(type);
+    offsets_.push_back(position.offset);
+    lengths_.push_back(position.length);
+}
+
+
+void TokenStream::reserve(const std::size_t size)
+{
+    types_.reserve(size);
+    offsets_.reserve(size);
+    lengths_.reserve(size);
+}
+
+
+void TokenStream::push_back(const Token::Position& position, const double number)
+{
+    number_indices_.push_back(static_cast<std::uint32_t>(types_.size()));
+    numbers_.push_back(number);
+    push_back(Token::Type::NUMBER, position);
+}
+
+
+std::size_t TokenStream::size() const
+{
+    return types_.size();
+}
+
+
+Token TokenStream::operator[](const std::size_t index) const
+{
+    return Token{type(index), lexeme(index), position(index)};
+}
+
+
+Token::Type TokenStream::type(const std::size_t index) const
+{
+    return types_[clamp(index)];
+}
+
+
+Token::Position TokenStream::position(const std::size_t index) const
+{
+    const std::size_t i = clamp(index);
+    return Token::Position{offsets_[i], lengths_[i]};
+}
+
+
+std::string_view TokenStream::lexeme(const std::size_t index) const
+{
+    const std::size_t i = clamp(index);
+    if (types_[i] == Token::Type::END_OF_FILE)
+    {
+        return {};
+    }
+    return source_.text().substr(offsets_[i], lengths_[i]);
+}
+
+
+Token::Literal TokenStream::literal(const std::size_t index) const
+{
+    const std::uint32_t i = static_cast<std::uint32_t>(clamp(index));
+    switch (types_[i])
+    {
+        case Token::Type::STRING:
+            // The value of a string is its lexeme without the quotes.
+            return std::string{source_.text().substr(offsets_[i] + 1, lengths_[i] - 2)};
+        case Token::Type::NUMBER:
+            return numbers_[std::lower_bound(number_indices_.begin(), number_indices_.end(), i) - number_indices_.begin()];
+        default:
+            return nullptr;
+    }
 }
 
 
+const Source& TokenStream::source() const
+{
+    return source_;
+}
+
+
+std::size_t TokenStream::clamp(const std::size_t index) const
+{
+    assert(!types_.empty() && "token stream must not be empty");
+    return std::min(index, types_.size() - 1);
+}
+
+
+// Classes of characters, combined as bit flags in CHARACTER_CLASSES.
+enum CharacterClass : std::uint8_t
+{
+    DIGIT = 1 << 0,
+    ALPHA = 1 << 1,
+    // Whitespace skipped between tokens. Newlines are tokens of their own.
+    BLANK = 1 << 2,
+};
+
+
+constexpr std::array<std::uint8_t, 256> build_character_classes()
+{
+    std::array<std::uint8_t, 256> classes{};
+    for (char c = '0'; c <= '9'; ++c)
+    {
+        classes[static_cast<unsigned char>(c)] |= DIGIT;
+    }
+    for (char c = 'a'; c <= 'z'; ++c)
+    {
+        classes[static_cast<unsigned char>(c)] |= ALPHA;
+        classes[static_cast<unsigned char>(c - 'a' + 'A')] |= ALPHA;
+    }
+    classes[static_cast<unsigned char>('_')] |= ALPHA;
+    classes[static_cast<unsigned char>(' ')] |= BLANK;
+    classes[static_cast<unsigned char>('\r')] |= BLANK;
+    classes[static_cast<unsigned char>('\t')] |= BLANK;
+    return classes;
+}
+
+
+// Locale-independent replacement for std::isdigit, std::isalpha and friends.
+constexpr std::array<std::uint8_t, 256> CHARACTER_CLASSES = build_character_classes();
+
+
+constexpr bool is_class(const char c, const std::uint8_t character_class)
+{
+    return CHARACTER_CLASSES[static_cast<unsigned char>(c)] & character_class;
+}
+
+
+struct Keyword
+{
+    std::string_view lexeme;
+    Token::Type type;
+};
+
+
+constexpr std::array<Keyword, 10> KEYWORDS{{
+    {"and", Token::Type::AND},
+    {"or", Token::Type::OR},
+    {"if", Token::Type::IF},
+    {"else", Token::Type::ELSE},
+    {"true", Token::Type::TRUE},
+    {"false", Token::Type::FALSE},
+    {"null", Token::Type::NIL},
+    {"print", Token::Type::PRINT},
+    {"var", Token::Type::VAR},
+    {"while", Token::Type::WHILE},
+}};
+
+
+// Perfect hash over the keywords, computed from the first and last characters
+// and the length of a (non-empty) identifier.
+constexpr std::size_t hash_keyword(const std::string_view lexeme)
+{
+    return ((static_cast<unsigned char>(lexeme.front()) << 1) ^ (static_cast<unsigned char>(lexeme.back()) << 1) ^ lexeme.size()) & 15;
+}
+
+
+constexpr std::array<std::optional<Keyword>, 16> build_keyword_table()
+{
+    std::array<std::optional<Keyword>, 16> table{};
+    for (const Keyword& keyword : KEYWORDS)
+    {
+        // A collision fails constant evaluation, so the hash is proven perfect at compile time.
+        if (table[hash_keyword(keyword.lexeme)])
+        {
+            throw "keyword hash collision";
+        }
+        table[hash_keyword(keyword.lexeme)] = keyword;
+    }
+    return table;
+}
+
+
+constexpr std::array<std::optional<Keyword>, 16> KEYWORD_TABLE = build_keyword_table();
+
+
+// Returns the type of the given identifier: the keyword type if it is a keyword,
+// and IDENTIFIER otherwise. Costs one hash and at most one comparison.
+constexpr Token::Type identifier_type(const std::string_view lexeme)
+{
+    const std::optional<Keyword>& keyword = KEYWORD_TABLE[hash_keyword(lexeme)];
+    return (keyword && keyword->lexeme == lexeme) ? keyword->type : Token::Type::IDENTIFIER;
+}
+
+
+static_assert(identifier_type("while") == Token::Type::WHILE);
+static_assert(identifier_type("whilst") == Token::Type::IDENTIFIER);
+
+
+#if defined(__SSE2__)
+// Returns a mask with one bit per byte of the given block, set where
+// the byte equals the given character.
+inline unsigned match_mask(const __m128i block, const char c)
+{
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c))));
+}
+#endif
+
+
+// Returns a pointer to the first occurrence of the given character in
+// [begin, end), or end if there is none. Compares 16 bytes at a time.
+inline const char* find_char(const char* begin, const char* const end, const char c)
+{
+#if defined(__SSE2__)
+    for (; end - begin >= 16; begin += 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        if (const unsigned mask = match_mask(block, c))
+        {
+            return begin + std::countr_zero(mask);
+        }
+    }
+#endif
+    for (; begin != end && *begin != c; ++begin) {}
+    return begin;
+}
+
+
+// Returns a pointer to the first non-blank character in [begin, end), or end
+// if there is none. Runs of indentation are skipped 16 bytes at a time.
+inline const char* skip_blanks(const char* begin, const char* const end)
+{
+#if defined(__SSE2__)
+    // Most runs are a single space, which is not worth a vector load.
+    if (end - begin >= 16 && is_class(begin[0], BLANK) && is_class(begin[1], BLANK))
+    {
+        for (; end - begin >= 16; begin += 16)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            const unsigned blanks = match_mask(block, ' ') | match_mask(block, '\t') | match_mask(block, '\r');
+            if (blanks != 0xFFFF)
+            {
+                return begin + std::countr_one(blanks);
+            }
+        }
+    }
+#endif
+    for (; begin != end && is_class(*begin, BLANK); ++begin) {}
+    return begin;
+}
+
+
+// Table-driven lexer. Blanks, comments and string bodies are skipped with
+// vectorized searches, keywords are recognized with a perfect hash and
+// numbers are converted with std::from_chars.
 class Lexer::Impl
 {
 public:
     Impl() = delete;
-    Impl(const std::string& input) : input_(input) {}
-    const std::vector<Token>& scan()
+    Impl(Source source, const std::size_t begin, const std::size_t end) :
+        source_(source),
+        input_(source_.text()),
+        tokens_(std::move(source)),
+        current_(begin_ + begin),
+        end_(begin_ + end)
+    {
+        if (input_.size() > std::numeric_limits<std::uint32_t>::max())
+        {
+            BeelineError be{"source must be smaller than 4 GiB"};
+            log(LoggingLevel::ERROR) << be;
+            throw be;
+        }
+        // Typical code has a token every five or so characters. Only the pages
+        // that end up being written to are committed, so overestimating is cheap.
+        tokens_.reserve((end - begin) / 4 + 1);
+    }
+    TokenStream scan()
     {
         std::optional<Token::Position> first_bad_position;
         while(!is_done())
@@ -122,44 +408,40 @@ public:
                 log(LoggingLevel::ERROR) << bse;
             }
         }
-        add_token(Token::Type::END_OF_FILE);
+        tokens_.push_back(Token::Type::END_OF_FILE, Token::Position{static_cast<std::uint32_t>(end_ - begin_), 1});
         if (first_bad_position)
         {
             panic("encountered one or more syntax errors", *first_bad_position);
         }
-        return tokens_;
+        return std::move(tokens_);
     }
 private:
-    static const std::unordered_map<std::string, Token::Type> keyword_to_type_;
-    std::string input_;
-    std::vector<Token> tokens_{};
-    std::size_t current_offset_{0};
-    std::size_t starting_offset_of_current_token_{0};
-    std::size_t current_line_{1};
-    std::size_t starting_line_of_current_token_{1};
-    std::size_t current_column_{1};
-    std::size_t starting_column_of_current_token_{1};
+    Source source_;
+    std::string_view input_;
+    TokenStream tokens_;
+    const char* const begin_{input_.data()};
+    const char* current_;
+    const char* const end_;
+    const char* start_of_current_token_{current_};
     void panic(const std::string& message) const
     {
         panic(message, current_token_position());
     }
     void panic(const std::string& message, const Token::Position& position) const
     {
-        throw BeelineSyntaxError(message, position);
+        throw BeelineSyntaxError(message, source_, position);
     }
     void scan_remaining_tokens()
     {
-        while(!is_done())
+        while ((current_ = skip_blanks(current_, end_)) != end_)
         {
-            starting_offset_of_current_token_ = current_offset_;
-            starting_line_of_current_token_ = current_line_;
-            starting_column_of_current_token_ = current_column_;
+            start_of_current_token_ = current_;
             scan_next_token();
         }
     }
     void scan_next_token()
     {
-        char c = advance();
+        const char c = *current_++;
         switch (c)
         {
             case '(': add_token(Token::Type::LEFT_PARENTHESIS); break;
@@ -175,7 +457,7 @@ private:
             case '<': add_token(try_consume_match('=') ? Token::Type::LESS_EQUAL : Token::Type::LESS); break;
             case '>': add_token(try_consume_match('=') ? Token::Type::GREATER_EQUAL : Token::Type::GREATER); break;
             case '.':
-                if (!std::isdigit(peek()))
+                if (current_ == end_ || !is_class(*current_, DIGIT))
                 {
                     panic("missing digit after decimal point");
                 }
@@ -184,27 +466,21 @@ private:
             case '/':
                 if (try_consume_match('/'))
                 {
-                    while (peek() != '\n' && !is_done())
-                    {
-                        advance();
-                    }
+                    // The newline ending the comment is a token of its own.
+                    current_ = find_char(current_, end_, '\n');
                 }
                 else
                 {
                     add_token(Token::Type::SLASH);
                 }
                 break;
-            case ' ':
-            case '\r':
-            case '\t':
-                break;
             case '"': string(); break;
             default:
-                if (std::isdigit(c))
+                if (is_class(c, DIGIT))
                 {
                     number();
                 }
-                else if (std::isalpha(c) || c == '_')
+                else if (is_class(c, ALPHA))
                 {
                     identifier();
                 }
@@ -214,168 +490,91 @@ private:
                 }
         }
     }
-    char advance()
-    {
-        if (peek() == '\n')
-        {
-            ++current_line_;
-            current_column_ = 1;
-        }
-        else
-        {
-            ++current_column_;
-        }
-        return input_[current_offset_++];
-    }
     void add_token(const Token::Type type)
     {
-        add_token(type, Token::Literal{nullptr});
+        tokens_.push_back(type, current_token_position());
     }
-    void add_token(const Token::Type type, const Token::Literal& literal)
+    bool try_consume_match(const char expected)
     {
-        Token::Position position{current_token_position()};
-        std::string lexeme{current_token_lexeme()};
-        if (type == Token::Type::END_OF_FILE)
+        if (current_ != end_ && *current_ == expected)
         {
-            assert((current_offset_ == input_.size()) && "must be at end of input when adding EOF token");
-            position = current_position();
-            lexeme = "";
+            ++current_;
+            return true;
         }
-        tokens_.emplace_back(type, lexeme, literal, position);
-    }
-    bool try_consume_match(const char& expected)
-    {
-        return try_consume_match(std::string{expected});
-    }
-    bool try_consume_match(std::string expected)
-    {
-        if (is_done())
-        {
-            return false;
-        }
-        for (std::size_t c{current_offset_}, e{0}; e < expected.size(); ++c, ++e)
-        {
-            if (is_past_end(c) || input_[c] != expected[e])
-            {
-                return false;
-            }
-        }
-        for (std::size_t i{0}; i < expected.size(); ++i)
-        {
-            advance();
-        }
-        return true;
-    }
-    char peek() const
-    {
-        return peek(0);
-    }
-    char peek(std::size_t ahead) const
-    {
-        if (is_past_end(current_offset_ + ahead))
-        {
-            return EOT;
-        }
-        return input_[current_offset_ + ahead];
+        return false;
     }
     bool is_done() const
     {
-        return is_past_end(current_offset_);
-    }
-    bool is_past_end(std::size_t offset) const
-    {
-        return offset >= input_.size();
+        return current_ == end_;
     }
     void string()
     {
-        while (peek() != '"' && !is_done())
-        {
-            advance();
-        }
+        current_ = find_char(current_, end_, '"');
         if (is_done())
         {
             panic("unterminated string");
         }
-        advance();
-        const std::string quoted_string_literal{current_token_lexeme()};
-        const std::string string_literal = quoted_string_literal.substr(1, quoted_string_literal.size() - 2);
-        add_token(Token::Type::STRING, string_literal);
+        ++current_;
+        add_token(Token::Type::STRING);
     }
-    void number()
+    void skip_digits()
     {
-        while (std::isdigit(peek()))
+        while (current_ != end_ && is_class(*current_, DIGIT))
         {
-            advance();
+            ++current_;
         }
-        if (peek() == '.' && std::isdigit(peek(1)))
+    }
+    void number()
+    {
+        skip_digits();
+        if (end_ - current_ >= 2 && current_[0] == '.' && is_class(current_[1], DIGIT))
         {
-            advance();
+            ++current_;
             return number_after_decimal_point();
         }
-        add_token(Token::Type::NUMBER, std::stod(current_token_lexeme()));
+        add_number_token();
     }
     void number_after_decimal_point()
     {
-        while (std::isdigit(peek()))
+        skip_digits();
+        add_number_token();
+    }
+    void add_number_token()
+    {
+        double value = 0;
+        if (std::from_chars(start_of_current_token_, current_, value).ec == std::errc::result_out_of_range)
         {
-            advance();
+            // Literals have no exponent, so one out of range is too large
+            // unless its digits before the decimal point are all zeros.
+            const char* const point = std::find(start_of_current_token_, current_, '.');
+            const bool is_small = std::all_of(start_of_current_token_, point, [](const char c) { return c == '0'; });
+            value = is_small ? 0.0 : std::numeric_limits<double>::infinity();
         }
-        add_token(Token::Type::NUMBER, std::stod(current_token_lexeme()));
+        tokens_.push_back(current_token_position(), value);
     }
     void identifier()
     {
-        while (std::isalnum(peek()) || peek() == '_')
-        {
-            advance();
-        }
-        auto type_iter = keyword_to_type_.find(current_token_lexeme());
-        Token::Type type = Token::Type::IDENTIFIER;
-        if (type_iter != keyword_to_type_.end())
+        while (current_ != end_ && is_class(*current_, ALPHA | DIGIT))
         {
-            type = type_iter->second;
+            ++current_;
         }
-        add_token(type);
+        add_token(identifier_type(current_token_lexeme()));
     }
     Token::Position current_token_position() const
     {
         return Token::Position{
-            starting_offset_of_current_token_,
-            starting_line_of_current_token_,
-            starting_column_of_current_token_,
-            current_offset_ - starting_offset_of_current_token_,
-        };
-    }
-    Token::Position current_position() const
-    {
-        return Token::Position{
-            current_offset_,
-            current_line_,
-            current_column_,
-            1,
+            static_cast<std::uint32_t>(start_of_current_token_ - begin_),
+            static_cast<std::uint32_t>(current_ - start_of_current_token_),
         };
     }
-    std::string current_token_lexeme() const
+    std::string_view current_token_lexeme() const
     {
-        Token::Position position = current_token_position();
-        return input_.substr(position.offset, position.length);
+        return std::string_view(start_of_current_token_, current_ - start_of_current_token_);
     }
 };
 
 
-const std::unordered_map<std::string, Token::Type> Lexer::Impl::keyword_to_type_ = {
-    {"and", Token::Type::AND},
-    {"or", Token::Type::OR},
-    {"if", Token::Type::IF},
-    {"else", Token::Type::ELSE},
-    {"true", Token::Type::TRUE},
-    {"false", Token::Type::FALSE},
-    {"null", Token::Type::NIL},
-    {"print", Token::Type::PRINT},
-    {"var", Token::Type::VAR},
-    {"while", Token::Type::WHILE},
-};
-
-
-Lexer::Lexer(const std::string& input) : impl_(std::make_unique<Impl>(input)) {}
+Lexer::Lexer(Source source) : Lexer(source, 0, source.text().size()) {}
+Lexer::Lexer(Source source, const std::size_t begin, const std::size_t end) : impl_(std::make_unique<Impl>(std::move(source), begin, end)) {}
 Lexer::~Lexer() = default;
-const std::vector<Token>& Lexer::scan() { return impl_->scan(); }
+TokenStream Lexer::scan() { return impl_->scan(); }
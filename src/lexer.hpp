@@ -4,14 +4,17 @@
 #include <variant>
 #include <memory>
 #include <cstddef>
+#include <cstdint>
+#include <string_view>
 
 #include "beeline.hpp"
+#include "source.hpp"
 
 
 // Represents a token in the beeline language.
 struct Token
 {
-    enum struct Type
+    enum struct Type : std::uint8_t
     {
         // Single-character tokens.
         LEFT_PARENTHESIS,
@@ -55,32 +58,80 @@ struct Token
         END_OF_FILE,
     };
 
+    // Span of the token in its source. Lines and columns are resolved from
+    // the offset through the source only when an error is reported.
     struct Position
     {
-        std::size_t offset;
-        std::size_t line;
-        std::size_t column;
-        std::size_t length;
+        std::uint32_t offset;
+        std::uint32_t length;
     };
 
     using Literal = std::variant<std::nullptr_t, std::string, double, bool>;
 
     Type type;
-    std::string lexeme;
-    Literal literal;
+    // Refers into the source the token was scanned from.
+    std::string_view lexeme;
     Position position;
 };
 
 
-// Creates Beeline tokens from the given input.
+// Compact, struct-of-arrays sequence of tokens. Types, offsets and lengths
+// live in separate dense arrays. The values of NUMBER tokens are kept in a
+// side table, while the values of STRING tokens are derived from their
+// lexemes when requested. Tokens are materialized on access; accessing past
+// the end yields the last token.
+class TokenStream
+{
+public:
+    TokenStream() = delete;
+    TokenStream(Source source);
+    // Reserves space for the given number of tokens.
+    void reserve(const std::size_t size);
+    // Appends a token whose literal, if any, is derived from its lexeme.
+    void push_back(const Token::Type type, const Token::Position& position);
+    // Appends a NUMBER token with the given value.
+    void push_back(const Token::Position& position, const double number);
+    // Returns the number of tokens.
+    std::size_t size() const;
+    // Returns the token at the given index.
+    Token operator[](const std::size_t index) const;
+    Token::Type type(const std::size_t index) const;
+    Token::Position position(const std::size_t index) const;
+    std::string_view lexeme(const std::size_t index) const;
+    // Returns the literal of the token at the given index, or null if
+    // the token does not carry a literal.
+    Token::Literal literal(const std::size_t index) const;
+    // Returns the source the tokens refer into.
+    const Source& source() const;
+private:
+    Source source_;
+    std::vector<Token::Type> types_;
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::uint32_t> lengths_;
+    // Sorted indices of the NUMBER tokens, parallel to numbers_.
+    std::vector<std::uint32_t> number_indices_;
+    std::vector<double> numbers_;
+    std::size_t clamp(const std::size_t index) const;
+};
+
+
+// Creates Beeline tokens from the given source. The lexemes of the
+// tokens refer into the source, which must outlive them. Sources must
+// be smaller than 4 GiB so that positions fit in 32 bits.
 class Lexer
 {
 public:
     Lexer() = delete;
-    Lexer(const std::string& input);
+    Lexer(Source source);
+    // Creates a lexer for the characters of the source in [begin, end),
+    // which must not start or end inside a token. Positions remain
+    // relative to the start of the whole source, and the END_OF_FILE
+    // token is placed at end.
+    Lexer(Source source, const std::size_t begin, const std::size_t end);
     ~Lexer();
-    // Tokenizes the given input.
-    const std::vector<Token>& scan();
+    // Tokenizes the source. The tokens are moved out of the lexer,
+    // so scan may only be called once.
+    TokenStream scan();
 private:
     // PIMPL idiom
     class Impl;
@@ -92,11 +143,18 @@ private:
 class BeelineSyntaxError : public BeelineError
 {
 public:
-    BeelineSyntaxError(const std::string& message, const Token::Position& position);
+    BeelineSyntaxError(const std::string& message, const Source& source, const Token::Position& position);
+    Source source;
     Token::Position position;
 };
 
 
+// Formats the position as <line>:<start column>-<end column>, resolving
+// the line and column through the source the position refers into. The
+// position is prefixed with <name>: if the source is named.
+std::string to_string(const Source& source, const Token::Position& position);
+
+
 std::ostream& operator<<(std::ostream& os, const Token::Type& type);
 std::ostream& operator<<(std::ostream& os, const Token::Position& position);
 std::ostream& operator<<(std::ostream& os, const Token::Literal& literal);
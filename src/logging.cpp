@@ -10,6 +10,18 @@
 namespace logging = boost::log;
 
 
+// Lowest logging level that is printed. Everything is printed until logging is initialized.
+LoggingLevel minimum_logging_level = LoggingLevel::TRACE;
+
+
+// Whether log messages written by the current thread are discarded.
+thread_local bool is_thread_silenced = false;
+
+
+// Where the error messages logged by the current thread are recorded, if anywhere.
+thread_local std::vector<LoggedMessage>* thread_recorded_messages = nullptr;
+
+
 logging::trivial::severity_level to_boost_logging_level(const LoggingLevel logging_level)
 {
     switch (logging_level)
@@ -28,6 +40,7 @@ logging::trivial::severity_level to_boost_logging_level(const LoggingLevel loggi
 void init_logging(const LoggingLevel logging_level)
 {
     // sets the output stream to std::clog
+    minimum_logging_level = logging_level;
     logging::add_console_log();
     logging::core::get()->set_filter(
         logging::trivial::severity >= to_boost_logging_level(logging_level)
@@ -35,7 +48,49 @@ void init_logging(const LoggingLevel logging_level)
 }
 
 
-LoggingStream::LoggingStream(const LoggingLevel logging_level) : logging_level_{logging_level} {}
+bool is_logging_enabled(const LoggingLevel logging_level)
+{
+    return logging_level >= minimum_logging_level;
+}
+
+
+LoggingSilencer::LoggingSilencer() : was_silenced_{is_thread_silenced}
+{
+    is_thread_silenced = true;
+}
+
+
+LoggingSilencer::~LoggingSilencer()
+{
+    is_thread_silenced = was_silenced_;
+}
+
+
+LoggingRecorder::LoggingRecorder(std::vector<LoggedMessage>& messages) : previous_messages_{thread_recorded_messages}
+{
+    thread_recorded_messages = &messages;
+}
+
+
+LoggingRecorder::~LoggingRecorder()
+{
+    thread_recorded_messages = previous_messages_;
+}
+
+
+UnrecordedLogging::UnrecordedLogging() : previous_messages_{thread_recorded_messages}
+{
+    thread_recorded_messages = nullptr;
+}
+
+
+UnrecordedLogging::~UnrecordedLogging()
+{
+    thread_recorded_messages = previous_messages_;
+}
+
+
+LoggingStream::LoggingStream(const LoggingLevel logging_level) : logging_level_{logging_level}, silenced_{is_thread_silenced}, recorded_messages_{thread_recorded_messages} {}
 
 
 LoggingStream log(const LoggingLevel logging_level)
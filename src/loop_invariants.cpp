@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <span>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "loop_invariants.hpp"
+#include "flat_ast.hpp"
+#include "type_inference.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Moves loop invariants out of loops from the outermost loop inwards, so that
+// an expression the same on every iteration of several nested loops leaves
+// all of them. The temporaries of each loop take the slots after those its
+// body uses, and after those of the loops around it.
+class LoopInvariantMover
+{
+public:
+    LoopInvariantMover(FlatAst& ast, const std::span<const FlatAst::Index> statements) : ast_{ast}, variable_types_{ast, statements} {}
+    // Moves the invariants of the loops in the statement at the given index,
+    // where the temporaries of the loops around it take the slots before the
+    // given one.
+    void move_statement(const FlatAst::Index index, const FlatAst::Index first_free_slot)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::BLOCK:
+            {
+                // Moving invariants appends to the lists of the flat AST.
+                const std::span<const FlatAst::Index> list = ast_.list(node.a, node.b);
+                for (const FlatAst::Index statement : std::vector<FlatAst::Index>{list.begin(), list.end()})
+                {
+                    move_statement(statement, first_free_slot);
+                }
+                break;
+            }
+            case Opcode::IF_ELSE:
+                move_statement(node.b, first_free_slot);
+                if (node.c != FlatAst::NONE)
+                {
+                    move_statement(node.c, first_free_slot);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                move_loop(index, first_free_slot);
+                break;
+            default:
+                break;
+        }
+    }
+private:
+    // Whether an expression is a loop invariant, and its types.
+    struct Operand
+    {
+        bool is_invariant;
+        Types types;
+    };
+    FlatAst& ast_;
+    VariableTypes variable_types_;
+    // Slots the loop being moved out of assigns.
+    std::unordered_set<FlatAst::Index> assigned_slots_;
+    // First slot after those the loop being moved out of uses.
+    FlatAst::Index first_unused_slot_{0};
+    // Invariants of the loop being moved out of, in evaluation order.
+    std::vector<std::pair<FlatAst::Index, Types>> invariants_;
+    void move_loop(const FlatAst::Index index, const FlatAst::Index first_free_slot)
+    {
+        const FlatAst::Node loop = ast_.node(index);
+        assigned_slots_.clear();
+        first_unused_slot_ = loop.c;
+        scan_expression(loop.a);
+        scan_statement(loop.b);
+        invariants_.clear();
+        find_invariants(loop.a);
+        find_statement_invariants(loop.b);
+        if (invariants_.empty())
+        {
+            move_statement(loop.b, first_free_slot);
+            return;
+        }
+        // The loop moves into a block that declares the temporaries first.
+        const FlatAst::Index first_temporary = std::max(first_unused_slot_, first_free_slot);
+        std::vector<FlatAst::Index> statements;
+        for (const auto& [invariant, types] : invariants_)
+        {
+            const FlatAst::Node expression = ast_.node(invariant);
+            const Token::Position position = ast_.position(invariant);
+            const FlatAst::Index slot = first_temporary + static_cast<FlatAst::Index>(statements.size());
+            const FlatAst::Index name = ast_.add_temporary_name();
+            const FlatAst::Index value = ast_.add(expression.opcode, position, expression.a, expression.b, expression.c);
+            ast_.node(invariant) = FlatAst::Node{Opcode::VARIABLE, name, FlatAst::NONE, slot};
+            statements.push_back(ast_.add(Opcode::VARIABLE_DECLARATION, position, name, value, slot));
+            variable_types_.add(slot, types);
+        }
+        const FlatAst::Index first_free_temporary = first_temporary + static_cast<FlatAst::Index>(statements.size());
+        statements.push_back(ast_.add(Opcode::WHILE_LOOP, ast_.position(index), loop.a, loop.b, loop.c));
+        ast_.node(index) = FlatAst::Node{Opcode::BLOCK, ast_.add_list(statements), static_cast<FlatAst::Index>(statements.size()), first_free_temporary - loop.c};
+        move_statement(loop.b, first_free_temporary);
+    }
+    void scan_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+                scan_expression(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                assign(node.c);
+                if (node.b != FlatAst::NONE)
+                {
+                    scan_expression(node.b);
+                }
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    scan_statement(statement);
+                }
+                break;
+            case Opcode::LAZY_BLOCK:
+                // The code of lazy blocks is not known yet, so they may assign
+                // every variable they refer to.
+                for (const FlatAst::Index free_variable : ast_.list(node.a, node.b))
+                {
+                    assign(ast_.node(free_variable).c);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                scan_expression(node.a);
+                scan_statement(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    scan_statement(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                scan_expression(node.a);
+                scan_statement(node.b);
+                break;
+            default:
+                break;
+        }
+    }
+    void scan_expression(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                break;
+            case Opcode::VARIABLE:
+                use(node.c);
+                break;
+            case Opcode::ASSIGNMENT:
+                assign(node.c);
+                scan_expression(node.b);
+                break;
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+                scan_expression(node.a);
+                break;
+            default:
+                scan_expression(node.a);
+                scan_expression(node.b);
+                break;
+        }
+    }
+    void use(const FlatAst::Index slot)
+    {
+        first_unused_slot_ = std::max(first_unused_slot_, slot + 1);
+    }
+    void assign(const FlatAst::Index slot)
+    {
+        use(slot);
+        assigned_slots_.insert(slot);
+    }
+    void find_statement_invariants(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+                find_invariants(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                if (node.b != FlatAst::NONE)
+                {
+                    find_invariants(node.b);
+                }
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    find_statement_invariants(statement);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                find_invariants(node.a);
+                find_statement_invariants(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    find_statement_invariants(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                find_invariants(node.a);
+                find_statement_invariants(node.b);
+                break;
+            default:
+                break;
+        }
+    }
+    // Finds the largest invariants in the expression at the given index.
+    void find_invariants(const FlatAst::Index index)
+    {
+        add_invariant(index, visit(index));
+    }
+    // Returns whether the expression at the given index is an invariant.
+    // Otherwise, adds the largest invariants in it.
+    Operand visit(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                return Operand{true, type_of(ast_.constant(node.a))};
+            case Opcode::VARIABLE:
+                return Operand{!assigned_slots_.contains(node.c), variable_types_.at(node.c)};
+            case Opcode::ASSIGNMENT:
+            {
+                const Operand value = visit(node.b);
+                add_invariant(node.b, value);
+                return Operand{false, value.types};
+            }
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+            {
+                const Operand operand = visit(node.a);
+                const Types types = result_types(node.opcode, operand.types, 0);
+                if (operand.is_invariant && !can_fail(node, operand.types, 0))
+                {
+                    return Operand{true, types};
+                }
+                add_invariant(node.a, operand);
+                return Operand{false, types};
+            }
+            default:
+            {
+                const Operand left = visit(node.a);
+                const Operand right = visit(node.b);
+                const Types types = result_types(node.opcode, left.types, right.types);
+                if (left.is_invariant && right.is_invariant && !can_fail(node, left.types, right.types))
+                {
+                    return Operand{true, types};
+                }
+                add_invariant(node.a, left);
+                add_invariant(node.b, right);
+                return Operand{false, types};
+            }
+        }
+    }
+    // Adds the expression at the given index if it is an invariant that
+    // computes something.
+    void add_invariant(const FlatAst::Index index, const Operand& operand)
+    {
+        const Opcode opcode = ast_.node(index).opcode;
+        if (operand.is_invariant && opcode != Opcode::LITERAL && opcode != Opcode::VARIABLE)
+        {
+            invariants_.emplace_back(index, operand.types);
+        }
+    }
+    // Returns whether the given operator may fail on operands of the given
+    // types, as the interpreter checks them.
+    bool can_fail(const FlatAst::Node& node, const Types left, const Types right) const
+    {
+        switch (node.opcode)
+        {
+            case Opcode::ADD:
+                // Numbers add up, and strings concatenate with anything but
+                // null.
+                return !((left == NUMBER && right == NUMBER) || (left == STRING && !(right & NULL_TYPE)) || (right == STRING && !(left & NULL_TYPE)));
+            case Opcode::DIVIDE:
+            {
+                const FlatAst::Node& divisor = ast_.node(node.b);
+                const double* number = divisor.opcode == Opcode::LITERAL ? std::get_if<double>(&ast_.constant(divisor.a)) : nullptr;
+                return left != NUMBER || number == nullptr || *number == 0;
+            }
+            case Opcode::SUBTRACT:
+            case Opcode::MULTIPLY:
+            case Opcode::GREATER:
+            case Opcode::GREATER_EQUAL:
+            case Opcode::LESS:
+            case Opcode::LESS_EQUAL:
+                return left != NUMBER || right != NUMBER;
+            case Opcode::AND:
+            case Opcode::OR:
+                return left != BOOLEAN || right != BOOLEAN;
+            case Opcode::NEGATE:
+                return left != NUMBER;
+            case Opcode::NOT:
+                return left != BOOLEAN;
+            default:
+                return false;
+        }
+    }
+};
+
+
+void hoist_loop_invariants(FlatAst& ast)
+{
+    LoopInvariantMover mover{ast, ast.statements()};
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        mover.move_statement(statement, 0);
+    }
+}
+
+
+void hoist_loop_invariants(FlatAst& ast, const FlatAst::Index statement)
+{
+    LoopInvariantMover{ast, std::span<const FlatAst::Index>{&statement, 1}}.move_statement(statement, 0);
+}
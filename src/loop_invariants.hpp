@@ -0,0 +1,18 @@
+#pragma once
+
+#include "flat_ast.hpp"
+
+
+// Moves the expressions of the while loops of the given resolved flat AST
+// that are the same on every iteration out of them. Each is computed once,
+// into a temporary declared in a block that wraps the loop, and read from it
+// inside the loop. An expression is only moved if it reads no variable that
+// the loop assigns, assigns none itself, and cannot fail, as judged by the
+// types of its operands, so that moving it does not change which errors are
+// raised or when.
+void hoist_loop_invariants(FlatAst& ast);
+
+
+// Moves the loop invariants of the statement at the given index of the given
+// resolved flat AST, as above.
+void hoist_loop_invariants(FlatAst& ast, const FlatAst::Index statement);
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "beeline.hpp"
+#include "output_cache.hpp"
+#include "cache_file.hpp"
+#include "hash.hpp"
+#include "serialization.hpp"
+#include "logging.hpp"
+
+
+// Identifies entry files, and changes whenever their layout or the way they
+// are keyed does.
+constexpr char MAGIC[8] = {'B', 'E', 'E', 'L', 'I', 'N', 'E', 'O'};
+constexpr std::uint32_t FORMAT_VERSION = 3;
+constexpr const char* EXTENSION = ".boc";
+// Seed of the hash that verifies the sources, which is independent of the
+// one naming the entry.
+constexpr std::uint64_t SOURCE_CHECK_SEED = 0x5eed;
+
+
+struct OutputCacheHeader
+{
+    char magic[sizeof(MAGIC)];
+    std::uint32_t format_version;
+    std::uint32_t reserved;
+    std::uint64_t sources_size;
+    std::uint64_t sources_hash;
+    std::uint64_t contents_size;
+    std::uint64_t contents_hash;
+};
+
+
+// Hashes the names and texts of the given sources in order.
+std::uint64_t hash(const std::vector<Source>& sources, std::uint64_t seed)
+{
+    for (const Source& source : sources)
+    {
+        seed = hash(source.name(), seed);
+        seed = hash(source.text(), seed);
+    }
+    return seed;
+}
+
+
+// Hashes the optimization level and the passes enabled and disabled whatever
+// the level. The number of passes in each list is hashed too, so that a pass
+// enabled is told apart from the same pass disabled.
+std::uint64_t hash(const OptimizationOptions& optimization, std::uint64_t seed)
+{
+    seed = hash(std::to_string(optimization.level), seed);
+    for (const std::vector<std::string>* passes : {&optimization.enabled_passes, &optimization.disabled_passes})
+    {
+        seed = hash(std::to_string(passes->size()), seed);
+        for (const std::string& name : *passes)
+        {
+            seed = hash(name, seed);
+        }
+    }
+    return seed;
+}
+
+
+std::uint64_t total_size(const std::vector<Source>& sources)
+{
+    std::uint64_t size = 0;
+    for (const Source& source : sources)
+    {
+        size += source.name().size() + source.text().size();
+    }
+    return size;
+}
+
+
+OutputCache::OutputCache(std::filesystem::path directory, const std::uintmax_t capacity, const OptimizationOptions& optimization) : directory_{std::move(directory)}, capacity_{capacity}, key_seed_{hash(optimization, hash(BEELINE_VERSION))} {}
+
+
+std::optional<OutputCache::Result> OutputCache::load(const std::vector<Source>& sources) const
+{
+    const std::filesystem::path entry = path(sources);
+    const std::optional<Source> mapping = map_cache_file(entry);
+    if (!mapping)
+    {
+        return std::nullopt;
+    }
+    const std::string_view data = mapping->text();
+    OutputCacheHeader header;
+    std::optional<Result> result;
+    if (data.size() >= sizeof(header))
+    {
+        std::memcpy(&header, data.data(), sizeof(header));
+        const std::string_view contents = data.substr(sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+            && header.format_version == FORMAT_VERSION
+            && header.sources_size == total_size(sources)
+            && header.contents_size == contents.size()
+            && header.contents_hash == hash(contents)
+            && header.sources_hash == hash(sources, SOURCE_CHECK_SEED))
+        {
+            Reader reader{contents};
+            Result candidate;
+            std::uint8_t failed = 0;
+            std::uint64_t messages = 0;
+            bool is_valid = reader.read(candidate.output) && reader.read(failed) && reader.read(messages);
+            if (is_valid && failed)
+            {
+                is_valid = reader.read(candidate.failure.emplace());
+            }
+            for (std::uint64_t i = 0; is_valid && i < messages; ++i)
+            {
+                LoggedMessage message;
+                is_valid = reader.read(message.logging_level) && reader.read(message.text);
+                candidate.messages.push_back(std::move(message));
+            }
+            if (is_valid && reader.is_done())
+            {
+                result = std::move(candidate);
+            }
+        }
+    }
+    if (!result)
+    {
+        log(LoggingLevel::WARN) << "ignoring invalid output cache entry '" + entry.string() + "'";
+        return std::nullopt;
+    }
+    // Recency is tracked through the modification time, since access times
+    // are often not updated.
+    std::error_code error;
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+    return result;
+}
+
+
+void OutputCache::store(const std::vector<Source>& sources, const Result& result) const
+{
+    std::string data(sizeof(OutputCacheHeader), '\0');
+    Writer writer{data};
+    writer.write(std::string_view{result.output});
+    writer.write<std::uint8_t>(result.failure.has_value());
+    writer.write<std::uint64_t>(result.messages.size());
+    if (result.failure)
+    {
+        writer.write(std::string_view{*result.failure});
+    }
+    for (const LoggedMessage& message : result.messages)
+    {
+        writer.write(message.logging_level);
+        writer.write(std::string_view{message.text});
+    }
+    if (data.size() > capacity_)
+    {
+        return;
+    }
+    const std::string_view contents = std::string_view{data}.substr(sizeof(OutputCacheHeader));
+    OutputCacheHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format_version = FORMAT_VERSION;
+    header.sources_size = total_size(sources);
+    header.sources_hash = hash(sources, SOURCE_CHECK_SEED);
+    header.contents_size = contents.size();
+    header.contents_hash = hash(contents);
+    std::memcpy(data.data(), &header, sizeof(header));
+    if (write_cache_file(path(sources), data))
+    {
+        evict();
+    }
+}
+
+
+std::uintmax_t OutputCache::capacity() const
+{
+    return capacity_;
+}
+
+
+std::filesystem::path OutputCache::path(const std::vector<Source>& sources) const
+{
+    return directory_ / cache_file_name(hash(sources, key_seed_), EXTENSION);
+}
+
+
+void OutputCache::evict() const
+{
+    struct Entry
+    {
+        std::filesystem::path path;
+        std::uintmax_t size;
+        std::filesystem::file_time_type last_used;
+    };
+    std::vector<Entry> entries;
+    std::uintmax_t size = 0;
+    std::error_code error;
+    for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator{directory_, error})
+    {
+        if (file.path().extension() != EXTENSION || !file.is_regular_file(error))
+        {
+            continue;
+        }
+        Entry entry{file.path(), file.file_size(error), file.last_write_time(error)};
+        if (!error)
+        {
+            size += entry.size;
+            entries.push_back(std::move(entry));
+        }
+    }
+    if (size <= capacity_)
+    {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+    for (const Entry& entry : entries)
+    {
+        if (size <= capacity_)
+        {
+            break;
+        }
+        if (std::filesystem::remove(entry.path, error))
+        {
+            size -= entry.size;
+        }
+    }
+}
+
+
+OutputRecorder::OutputRecorder(std::ostream& stream, std::string& output, const std::size_t maximum_size)
+    : stream_{stream}, destination_{stream.rdbuf(this)}, output_{output}, maximum_size_{maximum_size} {}
+
+
+OutputRecorder::~OutputRecorder()
+{
+    stream_.rdbuf(destination_);
+}
+
+
+bool OutputRecorder::overflowed() const
+{
+    return overflowed_;
+}
+
+
+OutputRecorder::int_type OutputRecorder::overflow(const int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+    const char character = traits_type::to_char_type(c);
+    record(&character, 1);
+    return destination_->sputc(character);
+}
+
+
+std::streamsize OutputRecorder::xsputn(const char* s, const std::streamsize n)
+{
+    record(s, n);
+    return destination_->sputn(s, n);
+}
+
+
+int OutputRecorder::sync()
+{
+    return destination_->pubsync();
+}
+
+
+void OutputRecorder::record(const char* s, const std::size_t n)
+{
+    if (overflowed_ || output_.size() + n > maximum_size_)
+    {
+        overflowed_ = true;
+        return;
+    }
+    output_.append(s, n);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "beeline.hpp"
+#include "source.hpp"
+#include "logging.hpp"
+
+
+// Cache of the results of running programs on disk, which lets unchanged
+// programs skip running. Beeline programs read no input, clock or
+// randomness, so the result of a run depends only on the sources run, whose
+// names and texts key the entries together with the interpreter version and
+// the optimization options, as the passes that run may change how a program
+// that fails does.
+// The total size of the entries is capped by evicting the least recently
+// used ones.
+class OutputCache
+{
+public:
+    struct Result
+    {
+        // Everything the run wrote to standard output.
+        std::string output;
+        // The warnings and errors the run logged, in order, whether or not
+        // they were printed.
+        std::vector<LoggedMessage> messages;
+        // The message of the error the run failed with, if it failed.
+        std::optional<std::string> failure;
+    };
+    OutputCache(std::filesystem::path directory, const std::uintmax_t capacity, const OptimizationOptions& optimization = {});
+    // Returns the result of running the given sources in order, if there is
+    // a valid entry for them, and marks the entry as recently used.
+    std::optional<Result> load(const std::vector<Source>& sources) const;
+    // Writes the entry for the given sources, then evicts the least recently
+    // used entries until the cache fits its capacity again. Results larger
+    // than the capacity are not written.
+    void store(const std::vector<Source>& sources, const Result& result) const;
+    std::uintmax_t capacity() const;
+private:
+    std::filesystem::path directory_;
+    std::uintmax_t capacity_;
+    // Seed of the hash that names the entries, from the interpreter version
+    // and the optimization options.
+    std::uint64_t key_seed_;
+    std::filesystem::path path(const std::vector<Source>& sources) const;
+    void evict() const;
+};
+
+
+// Keeps a copy of everything written to the given output stream for as long
+// as it is alive, up to the given size, while still passing it on.
+class OutputRecorder : public std::streambuf
+{
+public:
+    OutputRecorder(std::ostream& stream, std::string& output, const std::size_t maximum_size);
+    ~OutputRecorder();
+    OutputRecorder(const OutputRecorder&) = delete;
+    OutputRecorder& operator=(const OutputRecorder&) = delete;
+    // Returns whether more was written than could be kept.
+    bool overflowed() const;
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+private:
+    std::ostream& stream_;
+    std::streambuf* destination_;
+    std::string& output_;
+    std::size_t maximum_size_;
+    bool overflowed_{false};
+    void record(const char* s, const std::size_t n);
+};
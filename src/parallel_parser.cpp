@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "parallel_parser.hpp"
+#include "arena.hpp"
+#include "beeline.hpp"
+#include "lexer.hpp"
+#include "logging.hpp"
+#include "parser.hpp"
+#include "splitter.hpp"
+#include "thread_pool.hpp"
+
+
+std::optional<Program> parse_in_parallel(Source source, const std::size_t threads, const std::size_t chunk_size, const bool lazy)
+{
+    const std::string_view text = source.text();
+    // Chunks are appended while workers fill in earlier ones, so they are
+    // held by pointer to stay put when the vector grows.
+    std::vector<std::unique_ptr<std::optional<Program>>> chunks;
+    std::atomic<bool> failed{false};
+    {
+        ThreadPool pool{threads};
+        auto submit = [&](const std::size_t begin, const std::size_t end) {
+            chunks.push_back(std::make_unique<std::optional<Program>>());
+            std::optional<Program>& chunk = *chunks.back();
+            pool.submit([&source, &failed, &chunk, begin, end, lazy]() {
+                if (failed.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+                // Errors are reported by the serial fallback instead.
+                LoggingSilencer silencer;
+                try
+                {
+                    chunk = Parser{Lexer{source, begin, end}.scan(), lazy}.parse();
+                }
+                catch (const BeelineError&)
+                {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            });
+        };
+        Splitter splitter;
+        std::size_t chunk_begin = 0;
+        for (std::size_t offset = 0; offset < text.size(); offset += chunk_size)
+        {
+            const std::size_t boundary = splitter.scan(text.substr(offset, chunk_size));
+            if (boundary > chunk_begin)
+            {
+                submit(chunk_begin, boundary);
+                chunk_begin = boundary;
+            }
+            if (failed.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        if (!failed.load(std::memory_order_relaxed))
+        {
+            const std::size_t end = splitter.finish();
+            if (end > chunk_begin || chunks.empty())
+            {
+                submit(chunk_begin, end);
+            }
+        }
+        // Destroying the pool waits for the submitted chunks.
+    }
+    if (failed)
+    {
+        return std::nullopt;
+    }
+    // The nodes of all chunks are kept alive by one arena.
+    Program program{std::move(source), std::make_unique<Arena>(), {}};
+    std::size_t size = 0;
+    for (const std::unique_ptr<std::optional<Program>>& chunk : chunks)
+    {
+        size += (*chunk)->statements.size();
+    }
+    program.statements.reserve(size);
+    for (const std::unique_ptr<std::optional<Program>>& chunk : chunks)
+    {
+        program.arena->merge(std::move(*(*chunk)->arena));
+        program.statements.insert(program.statements.end(), (*chunk)->statements.begin(), (*chunk)->statements.end());
+    }
+    return program;
+}
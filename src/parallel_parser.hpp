@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+#include "source.hpp"
+#include "program.hpp"
+
+
+// Lexes and parses the given source on the given number of threads. The
+// source is split into chunks of roughly the given size at the boundaries
+// between top-level declarations, which are found with a Splitter while
+// earlier chunks are already being lexed and parsed. The statements of the
+// chunks are joined in order and their arenas merged; token positions need
+// no adjustment since every chunk is lexed in place within the whole source. Returns nothing, without
+// logging, if any chunk has an error, in which case the caller should parse
+// the source serially to report the errors exactly as usual. Chunks are
+// parsed lazily if requested, as by a lazy Parser.
+std::optional<Program> parse_in_parallel(Source source, const std::size_t threads, const std::size_t chunk_size, const bool lazy = false);
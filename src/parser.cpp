@@ -5,11 +5,19 @@
 #include <cassert>
 #include <string>
 #include <optional>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
 
 #include "parser.hpp"
 #include "ast.hpp"
+#include "program.hpp"
+#include "arena.hpp"
 #include "lexer.hpp"
 #include "logging.hpp"
+#include "replace.hpp"
 
 
 enum struct Associativity
@@ -19,20 +27,77 @@ enum struct Associativity
 };
 
 
-// Recursive descent parser. Parses a list of tokens into a list of statements.
-// Private methods represent substitution rules in the grammar. Precedence
-// is represented by the order of the methods. Methods are called until a match
-// is found for the current token. Lower precedence methods are called first
-// to allow higher precedence methods to match first.
+// Binding powers of an infix operator. The operand between two operators is
+// bound by the one with the higher power on that side: a left-associative
+// operator binds slightly more tightly to its right, and a right-associative
+// one slightly more loosely. Tokens that are not infix operators have no power.
+struct BindingPower
+{
+    std::uint8_t left;
+    std::uint8_t right;
+};
+
+
+constexpr std::size_t TOKEN_TYPE_COUNT = static_cast<std::size_t>(Token::Type::END_OF_FILE) + 1;
+
+
+constexpr std::array<BindingPower, TOKEN_TYPE_COUNT> build_binding_powers()
+{
+    std::array<BindingPower, TOKEN_TYPE_COUNT> powers{};
+    // Operators are listed from the lowest to the highest precedence.
+    auto set = [&powers](const std::initializer_list<Token::Type> types, const std::uint8_t precedence, const Associativity associativity) {
+        for (const Token::Type type : types)
+        {
+            const std::uint8_t left = 2 * precedence;
+            powers[static_cast<std::size_t>(type)] = BindingPower{left, static_cast<std::uint8_t>(associativity == Associativity::LEFT ? left + 1 : left - 1)};
+        }
+    };
+    set({Token::Type::EQUAL}, 1, Associativity::RIGHT);
+    set({Token::Type::OR}, 2, Associativity::LEFT);
+    set({Token::Type::AND}, 3, Associativity::LEFT);
+    set({Token::Type::BANG_EQUAL, Token::Type::EQUAL_EQUAL}, 4, Associativity::LEFT);
+    set({Token::Type::GREATER, Token::Type::GREATER_EQUAL, Token::Type::LESS, Token::Type::LESS_EQUAL}, 5, Associativity::LEFT);
+    set({Token::Type::MINUS, Token::Type::PLUS}, 6, Associativity::LEFT);
+    set({Token::Type::SLASH, Token::Type::STAR}, 7, Associativity::LEFT);
+    return powers;
+}
+
+
+constexpr std::array<BindingPower, TOKEN_TYPE_COUNT> BINDING_POWERS = build_binding_powers();
+
+
+// Power with which prefix operators bind their operand, which exceeds that of
+// every infix operator.
+constexpr std::uint8_t PREFIX_BINDING_POWER = 2 * 8;
+
+
+static_assert(BINDING_POWERS[static_cast<std::size_t>(Token::Type::STAR)].left > BINDING_POWERS[static_cast<std::size_t>(Token::Type::PLUS)].right);
+static_assert(BINDING_POWERS[static_cast<std::size_t>(Token::Type::EQUAL)].left > BINDING_POWERS[static_cast<std::size_t>(Token::Type::EQUAL)].right);
+static_assert(BINDING_POWERS[static_cast<std::size_t>(Token::Type::NUMBER)].left == 0);
+
+
+// Block bodies of if statements with fewer tokens than this are parsed
+// eagerly even when parsing lazily, since deferring them would cost more than
+// it saves.
+constexpr std::size_t LAZY_BLOCK_MINIMUM_TOKENS = 64;
+
+
+// Parses a list of tokens into a list of statements. Statements are parsed by
+// recursive descent, where private methods represent substitution rules in
+// the grammar. Expressions are parsed by a Pratt parser, which looks up the
+// binding power of each operator in a table instead of descending through
+// one method per precedence level.
 class Parser::Impl
 {
 public:
     Impl() = delete;
-    Impl(const std::vector<Token>& tokens) : tokens_(tokens) {}
-    std::vector<std::unique_ptr<Statement>> parse()
+    Impl(TokenStream&& tokens, const bool lazy) : tokens_(std::move(tokens)), arena_(std::make_unique<Arena>()), lazy_(lazy) {}
+    Program parse()
     {
-        std::optional<Token> first_bad_token;
-        std::vector<std::unique_ptr<Statement>> statements;
+        std::vector<Statement*> statements;
+        // Newlines are skipped before checking for the end, so that blank
+        // lines and comments are not mistaken for the start of a declaration.
+        consume_newlines();
         while (!is_done())
         {
             try
@@ -41,23 +106,40 @@ public:
             }
             catch (const BeelineParseError& e)
             {
-                if (!first_bad_token)
-                {
-                    first_bad_token = e.token;
-                }
-                log(LoggingLevel::ERROR) << e;
+                report(e);
+                block_names_.clear();
+                block_starts_.clear();
+                free_variables_.clear();
+                redeclared_ = false;
                 recover();
             }
+            consume_newlines();
         }
-        if (first_bad_token)
+        if (first_bad_token_)
         {
-            panic("encountered one or more parsing errors", *first_bad_token);
+            panic("encountered one or more parsing errors", *first_bad_token_);
         }
-        return statements;
+        return Program{tokens_.source(), std::move(arena_), std::move(statements)};
     }
 private:
-    std::vector<Token> tokens_;
+    TokenStream tokens_;
+    // Holds the nodes of the AST, which is handed over with the program.
+    std::unique_ptr<Arena> arena_;
+    const bool lazy_;
+    // Whether a lazy block is being checked for syntax errors, in which case
+    // no nodes are built, and whether a loop body is being parsed.
+    bool checking_{false};
+    bool in_loop_{false};
     std::size_t current_token_index_{0};
+    std::optional<Token> first_bad_token_;
+    // Names declared in the blocks of the lazy block being checked, innermost
+    // last, and where the names of each block start, which tell the variables
+    // it uses from outside apart from its own. Also the variables it refers
+    // to from outside, and whether it declares a name twice.
+    std::vector<std::string_view> block_names_;
+    std::vector<std::size_t> block_starts_;
+    std::vector<Token> free_variables_;
+    bool redeclared_{false};
     void consume_newlines()
     {
         while (is_match(Token::Type::NEWLINE))
@@ -75,23 +157,28 @@ private:
     }
     bool is_match(const Token::Type type) const
     {
-        return (!is_done()) && (peek().type == type);
+        return (!is_done()) && (peek_type() == type);
     }
     bool is_done() const
     {
-        return peek().type == Token::Type::END_OF_FILE;
+        return peek_type() == Token::Type::END_OF_FILE;
     }
-    const Token& peek() const
+    // Reads only the dense type array, without materializing the token.
+    Token::Type peek_type() const
+    {
+        return tokens_.type(current_token_index_);
+    }
+    Token peek() const
     {
         return peek(0);
     }
-    const Token& peek(const std::size_t ahead) const
+    Token peek(const std::size_t ahead) const
     {
-        return tokens_.at(current_token_index_ + ahead);
+        return tokens_[current_token_index_ + ahead];
     }
-    const Token& advance()
+    Token advance()
     {
-        return tokens_.at(current_token_index_++);
+        return tokens_[current_token_index_++];
     }
     void require_match(const std::initializer_list<Token::Type> types, const std::string& message)
     {
@@ -110,19 +197,59 @@ private:
     }
     void panic(const std::string& message, const Token& token) const
     {
-        throw BeelineParseError(message, token);
+        throw BeelineParseError(message, tokens_.source(), token);
+    }
+    // Constructs a node in the arena, unless a lazy block is being checked.
+    template <typename T, typename... Arguments>
+    T* make(Arguments&&... arguments)
+    {
+        return checking_ ? nullptr : arena_->make<T>(std::forward<Arguments>(arguments)...);
+    }
+    // Logs an error, which fails the parse once it is done.
+    void report(const BeelineParseError& error)
+    {
+        if (!first_bad_token_)
+        {
+            first_bad_token_ = error.token;
+        }
+        log(LoggingLevel::ERROR) << error;
+    }
+    // Declares the given name in the innermost block of the lazy block being
+    // checked. Redeclarations are left to the resolver, which reports them
+    // along with those of globals, so such a block is noted to be parsed eagerly.
+    void declare(const Token& name)
+    {
+        if (std::find(block_names_.begin() + block_starts_.back(), block_names_.end(), name.lexeme) != block_names_.end())
+        {
+            redeclared_ = true;
+            return;
+        }
+        block_names_.push_back(name.lexeme);
+    }
+    // Notes a reference to the given variable. While a lazy block is checked
+    // for syntax errors, the variables it refers to from outside it are kept,
+    // so that they can be resolved before the block is parsed.
+    void refer(const Token& name)
+    {
+        if (!checking_
+            || std::find(block_names_.begin(), block_names_.end(), name.lexeme) != block_names_.end()
+            || std::any_of(free_variables_.begin(), free_variables_.end(), [&name](const Token& variable) { return variable.lexeme == name.lexeme; }))
+        {
+            return;
+        }
+        free_variables_.push_back(name);
     }
     // Recovers after an error. Skips tokens until a statement boundary is found.
     void recover()
     {
         while (!is_done())
         {
-            const Token& previous = advance();
+            const Token previous = advance();
             if (previous.type == Token::Type::NEWLINE)
             {
                 return;
             }
-            switch (peek().type)
+            switch (peek_type())
             {
                 case Token::Type::VAR:
                 case Token::Type::IF:
@@ -132,128 +259,89 @@ private:
             }
         }
     }
-    std::unique_ptr<Expression> binary(
-        std::unique_ptr<Expression> (Parser::Impl::*operand)(void),
-        const Associativity associativity,
-        const std::initializer_list<Token::Type> types
-    ) {
-        assert(associativity == Associativity::LEFT && "Associativity::RIGHT is not implemented");
-        std::unique_ptr<Expression> expr = (this->*operand)();
-        while (is_match(types))
-        {
-            const Token& op = advance();
-            std::unique_ptr<Expression> right = std::move((this->*operand)());
-            expr = std::make_unique<Expression::Binary>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-    std::unique_ptr<Expression> expression()
-    {
-        return assignment();
-    }
-    std::unique_ptr<Expression> assignment()
+    // Parses an expression whose infix operators bind more tightly than the
+    // given binding power.
+    Expression* expression(const std::uint8_t minimum_binding_power = 0)
     {
-        std::unique_ptr<Expression> expr = logical_or();
-        if (is_match(Token::Type::EQUAL))
+        const std::size_t start = current_token_index_;
+        Expression* left = prefix();
+        while (true)
         {
-            const Token& equals = advance();
-            // Finish parsing right-hand side since assignment is right-associative
-            std::unique_ptr<Expression> value = assignment();
-            if (Expression::Variable* variable = dynamic_cast<Expression::Variable*>(expr.get()))
+            const BindingPower power = BINDING_POWERS[static_cast<std::size_t>(peek_type())];
+            if (power.left <= minimum_binding_power)
             {
-                return std::make_unique<Expression::Assignment>(variable->name, std::move(value));
+                return left;
+            }
+            // The left operand is told to be a variable by its tokens, since
+            // no nodes are built while checking: only a variable is a single
+            // identifier.
+            const bool is_variable = current_token_index_ == start + 1 && tokens_.type(start) == Token::Type::IDENTIFIER;
+            const Token op = advance();
+            Expression* right = expression(power.right);
+            if (op.type == Token::Type::EQUAL)
+            {
+                if (!is_variable)
+                {
+                    panic("left-hand side of assignment must be a variable", op);
+                }
+                left = make<Expression::Assignment>(tokens_[start], right);
+            }
+            else
+            {
+                left = make<Expression::Binary>(left, op, right);
             }
-            panic("left-hand side of assignment must be a variable", equals);
-        }
-        return expr;
-    }
-    std::unique_ptr<Expression> logical_or()
-    {
-        std::unique_ptr<Expression> expr = logical_and();
-        while (is_match(Token::Type::OR))
-        {
-            const Token& op = advance();
-            std::unique_ptr<Expression> right = logical_and();
-            expr = std::make_unique<Expression::Binary>(std::move(expr), op, std::move(right));
-        }
-        return expr;
-    }
-    std::unique_ptr<Expression> logical_and()
-    {
-        std::unique_ptr<Expression> expr = equality();
-        while (is_match(Token::Type::AND))
-        {
-            const Token& op = advance();
-            std::unique_ptr<Expression> right = equality();
-            expr = std::make_unique<Expression::Binary>(std::move(expr), op, std::move(right));
         }
-        return expr;
-    }
-    std::unique_ptr<Expression> equality()
-    {
-        return binary(&Parser::Impl::comparison, Associativity::LEFT, {Token::Type::BANG_EQUAL, Token::Type::EQUAL_EQUAL});
-    }
-    std::unique_ptr<Expression> comparison()
-    {
-        return binary(&Parser::Impl::term, Associativity::LEFT, {Token::Type::GREATER, Token::Type::GREATER_EQUAL, Token::Type::LESS, Token::Type::LESS_EQUAL});
     }
-    std::unique_ptr<Expression> term()
-    {
-        return binary(&Parser::Impl::factor, Associativity::LEFT, {Token::Type::MINUS, Token::Type::PLUS});
-    }
-    std::unique_ptr<Expression> factor()
-    {
-        return binary(&Parser::Impl::unary, Associativity::LEFT, {Token::Type::SLASH, Token::Type::STAR});
-    }
-    std::unique_ptr<Expression> unary()
+    Expression* prefix()
     {
         if (is_match({Token::Type::BANG, Token::Type::MINUS}))
         {
-            const Token& op = advance();
-            std::unique_ptr<Expression> right = unary();
-            return std::make_unique<Expression::Unary>(op, std::move(right));
+            const Token op = advance();
+            Expression* right = expression(PREFIX_BINDING_POWER);
+            return make<Expression::Unary>(op, right);
         }
         return primary();
     }
-    std::unique_ptr<Expression> primary()
+    Expression* primary()
     {
-        const Token& token = advance();
-        std::unique_ptr<Expression> expr;
+        const std::size_t index = current_token_index_;
+        const Token token = advance();
+        Expression* expr = nullptr;
         switch (token.type)
         {
             case Token::Type::FALSE:
-                expr = std::make_unique<Expression::Literal>(Token::Literal{false});
+                expr = make<Expression::Literal>(Token::Literal{false});
                 break;
             case Token::Type::TRUE:
-                expr = std::make_unique<Expression::Literal>(Token::Literal{true});
+                expr = make<Expression::Literal>(Token::Literal{true});
                 break;
             case Token::Type::NIL:
-                expr = std::make_unique<Expression::Literal>(Token::Literal{nullptr});
+                expr = make<Expression::Literal>(Token::Literal{nullptr});
                 break;
             case Token::Type::NUMBER:
-                expr = std::make_unique<Expression::Literal>(token.literal);
-                break;
             case Token::Type::STRING:
-                expr = std::make_unique<Expression::Literal>(token.literal);
+                // Literals are only converted into values for nodes.
+                expr = checking_ ? nullptr : arena_->make<Expression::Literal>(tokens_.literal(index));
                 break;
             case Token::Type::LEFT_PARENTHESIS:
                 expr = expression();
                 require_match(Token::Type::RIGHT_PARENTHESIS, "expected ')' after expression");
                 advance();
-                expr = std::make_unique<Expression::Grouping>(std::move(expr));
+                expr = make<Expression::Grouping>(expr);
                 break;
             case Token::Type::IDENTIFIER:
-                expr = std::make_unique<Expression::Variable>(token);
+                refer(token);
+                expr = make<Expression::Variable>(token);
                 break;
             default:
                 panic("expected expression", token);
         }
         return expr;
     }
-    std::unique_ptr<Statement> declaration()
+    Statement* declaration()
     {
         consume_newlines();
-        std::unique_ptr<Statement> stmt;
+        Statement* stmt = nullptr;
         if (is_match(Token::Type::VAR))
         {
             stmt = variable_declaration();
@@ -265,10 +353,10 @@ private:
         consume_newlines();
         return stmt;
     }
-    std::unique_ptr<Statement> statement()
+    Statement* statement()
     {
-        std::unique_ptr<Statement> stmt;
-        switch (peek().type)
+        Statement* stmt = nullptr;
+        switch (peek_type())
         {
             case Token::Type::PRINT:
                 stmt = print_statement();
@@ -288,87 +376,168 @@ private:
         }
         return stmt;
     }
-    std::unique_ptr<Statement> print_statement()
+    Statement* print_statement()
     {
         assert(is_match(Token::Type::PRINT));
-        const Token& keyword = advance();
-        std::unique_ptr<Expression> expr = expression();
+        const Token keyword = advance();
+        Expression* expr = expression();
         if (!is_done())
         {
             require_match(Token::Type::NEWLINE, "expected newline or EOF after expression");
             advance();
         }
-        return std::make_unique<Statement::Print>(keyword, std::move(expr));
+        return make<Statement::Print>(keyword, expr);
     }
-    std::unique_ptr<Statement> block()
+    Statement* block()
     {
         assert(is_match(Token::Type::LEFT_BRACE));
         advance();
-        std::vector<std::unique_ptr<Statement>> statements;
+        if (checking_)
+        {
+            block_starts_.push_back(block_names_.size());
+        }
+        std::vector<Statement*> statements;
         while (!is_match(Token::Type::RIGHT_BRACE) && !is_done())
         {
-            statements.push_back(declaration());
+            Statement* statement = declaration();
+            if (!checking_)
+            {
+                statements.push_back(statement);
+            }
         }
         require_match(Token::Type::RIGHT_BRACE, "expected '}' after block");
         advance();
-        return std::make_unique<Statement::Block>(std::move(statements));
+        if (checking_)
+        {
+            block_names_.resize(block_starts_.back());
+            block_starts_.pop_back();
+            return nullptr;
+        }
+        return arena_->make<Statement::Block>(arena_->copy(statements));
+    }
+    // Parses a branch of an if statement. When parsing lazily, a large block
+    // is only checked for syntax errors, without building nodes, and is
+    // represented by its braces until it is first executed. Blocks nested
+    // within it are left to the parse that happens then. A block that
+    // declares a name twice is parsed again eagerly, so that the resolver
+    // reports the error before the program runs. Loop bodies, and branches
+    // within them, are always parsed eagerly: they are likely to run, and
+    // the passes optimize a loop as a whole.
+    Statement* branch()
+    {
+        if (!lazy_ || checking_ || in_loop_ || !is_match(Token::Type::LEFT_BRACE))
+        {
+            return statement();
+        }
+        const std::optional<std::size_t> right_brace_index = find_matching_brace();
+        if (!right_brace_index || *right_brace_index - current_token_index_ < LAZY_BLOCK_MINIMUM_TOKENS)
+        {
+            return statement();
+        }
+        const std::size_t left_brace_index = current_token_index_;
+        const Token left_brace = peek();
+        {
+            ScopedReplace<bool> replacer(checking_, true);
+            block();
+        }
+        assert(current_token_index_ == *right_brace_index + 1);
+        if (redeclared_)
+        {
+            redeclared_ = false;
+            free_variables_.clear();
+            current_token_index_ = left_brace_index;
+            return statement();
+        }
+        std::vector<Expression*> free_variables;
+        free_variables.reserve(free_variables_.size());
+        for (const Token& name : free_variables_)
+        {
+            free_variables.push_back(arena_->make<Expression::Variable>(name));
+        }
+        free_variables_.clear();
+        return arena_->make<Statement::LazyBlock>(left_brace, tokens_[*right_brace_index], arena_->copy(free_variables));
+    }
+    // Returns the index of the brace closing the block that starts at the
+    // current token, if it is closed.
+    std::optional<std::size_t> find_matching_brace() const
+    {
+        std::size_t depth = 0;
+        for (std::size_t index = current_token_index_; index < tokens_.size(); ++index)
+        {
+            switch (tokens_.type(index))
+            {
+                case Token::Type::LEFT_BRACE:
+                    ++depth;
+                    break;
+                case Token::Type::RIGHT_BRACE:
+                    if (--depth == 0)
+                    {
+                        return index;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return std::nullopt;
     }
-    std::unique_ptr<Statement> if_statement()
+    Statement* if_statement()
     {
         assert(is_match(Token::Type::IF));
-        const Token& if_keyword = advance();
+        const Token if_keyword = advance();
         require_match(Token::Type::LEFT_PARENTHESIS, "expected '(' after 'if'");
         advance();
         consume_newlines();
-        std::unique_ptr<Expression> condition = expression();
+        Expression* condition = expression();
         consume_newlines();
         require_match(Token::Type::RIGHT_PARENTHESIS, "expected ')' after if condition");
         advance();
         consume_newlines();
-        std::unique_ptr<Statement> then_statement = statement();
+        Statement* then_statement = branch();
         consume_newlines();
         std::optional<Token> else_keyword;
-        std::unique_ptr<Statement> else_statement;
+        Statement* else_statement = nullptr;
         if (is_match(Token::Type::ELSE))
         {
             else_keyword = advance();
             consume_newlines();
-            else_statement = statement();
+            else_statement = branch();
         }
-        return std::make_unique<Statement::IfElse>(std::move(condition), if_keyword, std::move(then_statement), else_keyword, std::move(else_statement));
+        return make<Statement::IfElse>(condition, if_keyword, then_statement, else_keyword, else_statement);
     }
-    std::unique_ptr<Statement> while_statement()
+    Statement* while_statement()
     {
         assert(is_match(Token::Type::WHILE));
-        const Token& keyword = advance();
+        const Token keyword = advance();
         require_match(Token::Type::LEFT_PARENTHESIS, "expected '(' after 'while'");
         advance();
         consume_newlines();
-        std::unique_ptr<Expression> condition = expression();
+        Expression* condition = expression();
         consume_newlines();
         require_match(Token::Type::RIGHT_PARENTHESIS, "expected ')' after while condition");
         advance();
         consume_newlines();
-        std::unique_ptr<Statement> body = statement();
-        return std::make_unique<Statement::WhileLoop>(keyword, std::move(condition), std::move(body));
+        ScopedReplace<bool> replacer(in_loop_, true);
+        Statement* body = statement();
+        return make<Statement::WhileLoop>(keyword, condition, body);
     }
-    std::unique_ptr<Statement> expression_statement()
+    Statement* expression_statement()
     {
-        std::unique_ptr<Expression> expr = expression();
+        Expression* expr = expression();
         if (!is_done())
         {
             require_match(Token::Type::NEWLINE, "expected newline or EOF after expression");
             advance();
         }
-        return std::make_unique<Statement::Expression>(std::move(expr));
+        return make<Statement::Expression>(expr);
     }
-    std::unique_ptr<Statement> variable_declaration()
+    Statement* variable_declaration()
     {
         assert(is_match(Token::Type::VAR));
         advance();
         require_match(Token::Type::IDENTIFIER, "expected identifier");
-        const Token& name = advance();
-        std::unique_ptr<Expression> initializer;
+        const Token name = advance();
+        Expression* initializer = nullptr;
         if (is_match(Token::Type::EQUAL))
         {
             advance();
@@ -379,20 +548,24 @@ private:
             require_match({Token::Type::NEWLINE}, "expected newline or EOF after variable declaration");
             advance();
         }
-        return std::make_unique<Statement::VariableDeclaration>(name, std::move(initializer));
+        if (checking_)
+        {
+            declare(name);
+        }
+        return make<Statement::VariableDeclaration>(name, initializer);
     }
 };
 
 
-Parser::Parser(const std::vector<Token>& tokens) : impl_(std::make_unique<Impl>(tokens)) {}
+Parser::Parser(TokenStream&& tokens, const bool lazy) : impl_(std::make_unique<Impl>(std::move(tokens), lazy)) {}
 Parser::~Parser() = default;
-std::vector<std::unique_ptr<Statement>> Parser::parse() { return impl_->parse(); }
+Program Parser::parse() { return impl_->parse(); }
 
 
-BeelineParseError::BeelineParseError(const std::string& message, const Token& token) : BeelineError(message), token(token) {}
+BeelineParseError::BeelineParseError(const std::string& message, const Source& source, const Token& token) : BeelineError(message), source(source), token(token) {}
 
 
 std::ostream& operator<<(std::ostream& os, const BeelineParseError& bpe)
 {
-    return os << "BeelineParseError: " << bpe.what() << " at " << bpe.token.position;
+    return os << "BeelineParseError: " << bpe.what() << " at " << to_string(bpe.source, bpe.token.position);
 }
@@ -8,17 +8,23 @@
 #include "beeline.hpp"
 #include "lexer.hpp"
 #include "ast.hpp"
+#include "program.hpp"
 
 
-// Parses a list of tokens into a list of statements.
+// Parses a list of tokens into a list of statements. The parser takes
+// ownership of the tokens, which must be moved in. A lazy parser leaves
+// large block bodies of if statements outside loops as Statement::LazyBlock
+// nodes, after checking them for syntax errors and noting the variables they
+// refer to from outside; the interpreter parses them from the source when
+// they are first executed. Variables declared twice are left to the resolver.
 class Parser
 {
 public:
     Parser() = delete;
-    Parser(const std::vector<Token>& tokens);
+    Parser(TokenStream&& tokens, const bool lazy = false);
     ~Parser();
-    // Parses the list of tokens into a list of statements.
-    std::vector<std::unique_ptr<Statement>> parse();
+    // Parses the list of tokens into a program.
+    Program parse();
 private:
     // PIMPL idiom
     class Impl;
@@ -29,7 +35,8 @@ private:
 class BeelineParseError : public BeelineError
 {
 public:
-    BeelineParseError(const std::string& message, const Token& token);
+    BeelineParseError(const std::string& message, const Source& source, const Token& token);
+    Source source;
     Token token;
 };
 
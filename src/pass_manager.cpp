@@ -0,0 +1,260 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iterator>
+#include <ostream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pass_manager.hpp"
+#include "beeline.hpp"
+#include "flat_ast.hpp"
+#include "arena.hpp"
+#include "ast.hpp"
+#include "stringify.hpp"
+#include "logging.hpp"
+#include "constant_folder.hpp"
+#include "simplifier.hpp"
+#include "loop_invariants.hpp"
+#include "common_subexpressions.hpp"
+#include "type_checker.hpp"
+#include "superinstructions.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Passes that only rewrite nodes in place run from level 1, and those that
+// introduce temporaries from level 2. Folding and simplifying first leaves
+// the later passes fewer and simpler expressions, and checking types after
+// them gives the temporaries they introduce their types. Superinstructions
+// are fused last, from the forms whose types have been checked.
+constexpr Pass PASSES[] = {
+    {
+        "constant_folder", 1,
+        [](FlatAst& ast, const std::size_t) { fold_constants(ast); },
+        [](FlatAst& ast, const FlatAst::Index statement, const std::size_t) { fold_constants(ast, statement); },
+    },
+    {
+        "simplifier", 1,
+        [](FlatAst& ast, const std::size_t) { simplify(ast); },
+        [](FlatAst& ast, const FlatAst::Index statement, const std::size_t) { simplify(ast, statement); },
+    },
+    {
+        "loop_invariants", 2,
+        [](FlatAst& ast, const std::size_t) { hoist_loop_invariants(ast); },
+        [](FlatAst& ast, const FlatAst::Index statement, const std::size_t) { hoist_loop_invariants(ast, statement); },
+    },
+    {
+        "common_subexpressions", 2,
+        [](FlatAst& ast, const std::size_t stack_size) { eliminate_common_subexpressions(ast, stack_size); },
+        [](FlatAst& ast, const FlatAst::Index statement, const std::size_t stack_size) { eliminate_common_subexpressions(ast, statement, stack_size); },
+    },
+    {
+        "type_checker", 1,
+        [](FlatAst& ast, const std::size_t) { specialize_types(ast); },
+        [](FlatAst& ast, const FlatAst::Index statement, const std::size_t) { specialize_types(ast, statement); },
+    },
+    {
+        "superinstructions", 1,
+        [](FlatAst& ast, const std::size_t) { fuse_superinstructions(ast); },
+        [](FlatAst& ast, const FlatAst::Index statement, const std::size_t) { fuse_superinstructions(ast, statement); },
+    },
+};
+
+
+constexpr int MAXIMUM_OPTIMIZATION_LEVEL = 2;
+
+
+std::span<const Pass> registered_passes()
+{
+    return PASSES;
+}
+
+
+// Logs and throws a BeelineError with the given message.
+[[noreturn]] void reject_options(const std::string& message)
+{
+    BeelineError be{message};
+    log(LoggingLevel::ERROR) << be;
+    throw be;
+}
+
+
+// Returns the index of the registered pass with the given name, or throws a
+// BeelineError if there is none.
+std::size_t find_pass(const std::string_view name)
+{
+    for (std::size_t i = 0; i < std::size(PASSES); ++i)
+    {
+        if (PASSES[i].name == name)
+        {
+            return i;
+        }
+    }
+    reject_options("unknown optimization pass '" + std::string{name} + "'");
+}
+
+
+PassManager::PassManager(const OptimizationOptions& options, std::ostream& dump) : dump_after_{NONE}, dump_{&dump}
+{
+    if (options.level < 0 || options.level > MAXIMUM_OPTIMIZATION_LEVEL)
+    {
+        reject_options("optimization level must be between 0 and " + std::to_string(MAXIMUM_OPTIMIZATION_LEVEL));
+    }
+    for (std::size_t i = 0; i < std::size(PASSES); ++i)
+    {
+        if (PASSES[i].level <= options.level)
+        {
+            enabled_ |= std::uint32_t{1} << i;
+        }
+    }
+    for (const std::string& name : options.enabled_passes)
+    {
+        enabled_ |= std::uint32_t{1} << find_pass(name);
+    }
+    for (const std::string& name : options.disabled_passes)
+    {
+        enabled_ &= ~(std::uint32_t{1} << find_pass(name));
+    }
+    if (!options.dump_after.empty())
+    {
+        dump_after_ = find_pass(options.dump_after);
+    }
+}
+
+
+bool PassManager::is_enabled(const std::string_view name) const
+{
+    return enabled_ & (std::uint32_t{1} << find_pass(name));
+}
+
+
+void PassManager::run(FlatAst& ast, const std::size_t stack_size) const
+{
+    run(ast, FlatAst::NONE, [&](const Pass& pass) {
+        pass.run(ast, stack_size);
+    });
+}
+
+
+void PassManager::run(FlatAst& ast, const FlatAst::Index statement, const std::size_t stack_size) const
+{
+    run(ast, statement, [&](const Pass& pass) {
+        pass.run_statement(ast, statement, stack_size);
+    });
+}
+
+
+// Runs the given function on each enabled pass, reporting on and dumping the
+// given statement, or the top-level statements if it is NONE.
+template <typename Function>
+void PassManager::run(const FlatAst& ast, const FlatAst::Index statement, Function&& function) const
+{
+    const auto count = [&]() {
+        return statement == FlatAst::NONE ? count_nodes(ast) : count_nodes(ast, statement);
+    };
+    const bool report = is_logging_enabled(LoggingLevel::INFO);
+    for (std::size_t i = 0; i < std::size(PASSES); ++i)
+    {
+        if (!(enabled_ & (std::uint32_t{1} << i)))
+        {
+            continue;
+        }
+        const Pass& pass = PASSES[i];
+        if (!report)
+        {
+            function(pass);
+        }
+        else
+        {
+            const std::size_t before = count();
+            const auto start = std::chrono::steady_clock::now();
+            function(pass);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            const std::size_t after = count();
+            std::ostringstream message;
+            message << "pass " << pass.name << ": " << std::fixed << std::setprecision(3) << elapsed.count() << " ms, "
+                << before << " -> " << after << " nodes (" << std::showpos << static_cast<std::ptrdiff_t>(after) - static_cast<std::ptrdiff_t>(before) << ")";
+            log(LoggingLevel::INFO) << message.str();
+        }
+        if (i == dump_after_)
+        {
+            Arena arena;
+            const std::vector<Statement*> statements = statement == FlatAst::NONE ? raise(ast, arena) : std::vector<Statement*>{raise(ast, statement, arena)};
+            *dump_ << "after " << pass.name << ":\n";
+            for (const Statement* raised : statements)
+            {
+                ExpressionToString visitor;
+                raised->accept(visitor);
+                *dump_ << visitor.str() << '\n';
+            }
+        }
+    }
+}
+
+
+// Counts the nodes reachable from the node at the given index.
+std::size_t count_nodes(const FlatAst& ast, const FlatAst::Index index)
+{
+    if (index == FlatAst::NONE)
+    {
+        return 0;
+    }
+    const FlatAst::Node& node = ast.node(index);
+    switch (node.opcode)
+    {
+        case Opcode::LITERAL:
+        case Opcode::VARIABLE:
+        // Superinstructions run in a single step.
+        case Opcode::INCREMENT:
+        case Opcode::GREATER_CONSTANT:
+        case Opcode::GREATER_EQUAL_CONSTANT:
+        case Opcode::LESS_CONSTANT:
+        case Opcode::LESS_EQUAL_CONSTANT:
+        case Opcode::APPEND:
+            return 1;
+        case Opcode::NEGATE:
+        case Opcode::NOT:
+        case Opcode::GROUPING:
+        case Opcode::NEGATE_NUMBER:
+        case Opcode::NOT_BOOLEAN:
+        case Opcode::EXPRESSION:
+        case Opcode::PRINT:
+            return 1 + count_nodes(ast, node.a);
+        case Opcode::ASSIGNMENT:
+        case Opcode::VARIABLE_DECLARATION:
+            return 1 + count_nodes(ast, node.b);
+        case Opcode::BLOCK:
+        case Opcode::LAZY_BLOCK:
+        {
+            std::size_t count = 1;
+            for (const FlatAst::Index child : ast.list(node.a, node.b))
+            {
+                count += count_nodes(ast, child);
+            }
+            return count;
+        }
+        case Opcode::IF_ELSE:
+        case Opcode::IF_ELSE_BOOLEAN:
+            return 1 + count_nodes(ast, node.a) + count_nodes(ast, node.b) + count_nodes(ast, node.c);
+        default:
+            // Binary operators and while loops.
+            return 1 + count_nodes(ast, node.a) + count_nodes(ast, node.b);
+    }
+}
+
+
+std::size_t count_nodes(const FlatAst& ast)
+{
+    std::size_t count = 0;
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        count += count_nodes(ast, statement);
+    }
+    return count;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+#include "beeline.hpp"
+#include "flat_ast.hpp"
+
+
+// Pass that optimizes a resolved flat AST before it runs.
+struct Pass
+{
+    std::string_view name;
+    // Lowest optimization level that runs the pass.
+    int level;
+    // Runs the pass on the top-level statements, which run with the stack at
+    // the given size.
+    void (*run)(FlatAst& ast, const std::size_t stack_size);
+    // Runs the pass on the statement at the given index, which runs with the
+    // stack at the given size.
+    void (*run_statement)(FlatAst& ast, const FlatAst::Index statement, const std::size_t stack_size);
+};
+
+
+// Returns the registered passes, in the order they run.
+std::span<const Pass> registered_passes();
+
+
+// Runs the registered passes that the given options enable, in order. While
+// info messages are logged, the time each pass takes and the number of nodes
+// it adds or removes are logged after it. The program is printed with
+// ExpressionToString to the given stream after the pass it is dumped after.
+class PassManager
+{
+public:
+    // Throws a BeelineError if the level is not between 0 and 2 or a pass is
+    // unknown.
+    explicit PassManager(const OptimizationOptions& options = {}, std::ostream& dump = std::cerr);
+    bool is_enabled(const std::string_view name) const;
+    // Runs the passes on the top-level statements of the given flat AST.
+    void run(FlatAst& ast, const std::size_t stack_size) const;
+    // Runs the passes on the statement at the given index of the given flat
+    // AST, which a lazy block was expanded into.
+    void run(FlatAst& ast, const FlatAst::Index statement, const std::size_t stack_size) const;
+private:
+    // Bit i is set if the i-th registered pass is enabled.
+    std::uint32_t enabled_{0};
+    // Index of the pass after which the program is dumped, or NONE.
+    std::size_t dump_after_;
+    std::ostream* dump_;
+    static constexpr std::size_t NONE = static_cast<std::size_t>(-1);
+    template <typename Function>
+    void run(const FlatAst& ast, const FlatAst::Index statement, Function&& function) const;
+};
+
+
+// Returns the number of nodes reachable from the given top-level statements
+// of the given flat AST, or from the statement at the given index.
+std::size_t count_nodes(const FlatAst& ast);
+std::size_t count_nodes(const FlatAst& ast, const FlatAst::Index statement);
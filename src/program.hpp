@@ -0,0 +1,19 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "source.hpp"
+#include "arena.hpp"
+#include "ast.hpp"
+
+
+// A parsed beeline program. Owns the AST, through the arena its nodes are
+// allocated from, together with the source its tokens refer into, so that
+// they are handed between stages as one move-only unit.
+struct Program
+{
+    Source source;
+    std::unique_ptr<Arena> arena;
+    std::vector<Statement*> statements;
+};
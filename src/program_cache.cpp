@@ -0,0 +1,95 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "beeline.hpp"
+#include "program_cache.hpp"
+#include "cache_file.hpp"
+#include "hash.hpp"
+#include "logging.hpp"
+
+
+// Identifies entry files, and changes whenever their layout or that of the
+// serialized flat AST does.
+constexpr char MAGIC[8] = {'B', 'E', 'E', 'L', 'I', 'N', 'E', 'C'};
+constexpr std::uint32_t FORMAT_VERSION = 3;
+// Seed of the hash that verifies the source, which is independent of the one
+// naming the entry.
+constexpr std::uint64_t SOURCE_CHECK_SEED = 0x5eed;
+
+
+struct ProgramCacheHeader
+{
+    char magic[sizeof(MAGIC)];
+    std::uint32_t format_version;
+    std::uint32_t reserved;
+    std::uint64_t source_size;
+    std::uint64_t source_hash;
+    std::uint64_t contents_size;
+    std::uint64_t contents_hash;
+};
+
+
+ProgramCache::ProgramCache(std::filesystem::path directory) : directory_{std::move(directory)} {}
+
+
+std::optional<FlatAst> ProgramCache::load(const Source& source) const
+{
+    const std::filesystem::path entry = path(source);
+    const std::optional<Source> mapping = map_cache_file(entry);
+    if (!mapping)
+    {
+        return std::nullopt;
+    }
+    const std::string_view data = mapping->text();
+    ProgramCacheHeader header;
+    std::optional<FlatAst> ast;
+    if (data.size() >= sizeof(header))
+    {
+        std::memcpy(&header, data.data(), sizeof(header));
+        const std::string_view contents = data.substr(sizeof(header));
+        const std::string_view text = source.text();
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+            && header.format_version == FORMAT_VERSION
+            && header.source_size == text.size()
+            && header.contents_size == contents.size()
+            && header.contents_hash == hash(contents)
+            && header.source_hash == hash(text, SOURCE_CHECK_SEED))
+        {
+            ast = FlatAst::deserialize(contents, source);
+        }
+    }
+    if (!ast)
+    {
+        const UnrecordedLogging unrecorded;
+        log(LoggingLevel::WARN) << "ignoring invalid program cache entry '" + entry.string() + "'";
+    }
+    return ast;
+}
+
+
+void ProgramCache::store(const FlatAst& ast) const
+{
+    const std::string_view text = ast.source().text();
+    std::string data(sizeof(ProgramCacheHeader), '\0');
+    ast.serialize(data);
+    const std::string_view contents = std::string_view{data}.substr(sizeof(ProgramCacheHeader));
+    ProgramCacheHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format_version = FORMAT_VERSION;
+    header.source_size = text.size();
+    header.source_hash = hash(text, SOURCE_CHECK_SEED);
+    header.contents_size = contents.size();
+    header.contents_hash = hash(contents);
+    std::memcpy(data.data(), &header, sizeof(header));
+    write_cache_file(path(ast.source()), data);
+}
+
+
+std::filesystem::path ProgramCache::path(const Source& source) const
+{
+    return directory_ / cache_file_name(hash(source.text(), hash(BEELINE_VERSION)), ".bpc");
+}
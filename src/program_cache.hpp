@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+
+#include "source.hpp"
+#include "flat_ast.hpp"
+
+
+// Cache of compiled programs on disk, which lets unchanged sources skip
+// lexing and parsing. An entry holds the serialized flat AST of a source and
+// is named after a hash of the source text and the interpreter version. Each
+// entry also records the format it is written in, a second hash of the source
+// and a checksum of its contents. An entry that fails any check is ignored
+// and rewritten.
+class ProgramCache
+{
+public:
+    explicit ProgramCache(std::filesystem::path directory);
+    // Maps the entry for the given source into memory and reads its flat AST.
+    // Returns nothing if there is no valid entry.
+    std::optional<FlatAst> load(const Source& source) const;
+    // Writes the entry for the source of the given flat AST.
+    void store(const FlatAst& ast) const;
+private:
+    std::filesystem::path directory_;
+    std::filesystem::path path(const Source& source) const;
+};
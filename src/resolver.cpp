@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "resolver.hpp"
+#include "flat_ast.hpp"
+#include "lexer.hpp"
+#include "logging.hpp"
+#include "replace.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Hashes strings and string views alike, so globals can be looked up by the
+// names of a flat AST without building a std::string.
+struct NameHash
+{
+    using is_transparent = void;
+    std::size_t operator()(std::string_view name) const
+    {
+        return std::hash<std::string_view>{}(name);
+    }
+};
+
+
+// Walks flat ASTs in source order, keeping the variables in scope. Variables
+// of blocks are few and short-lived, so they are kept in a list that is
+// searched from the innermost one outwards, and globals in a hash map.
+class Resolver::Impl
+{
+public:
+    void resolve(FlatAst& ast)
+    {
+        ast_ = &ast;
+        locals_.clear();
+        const std::size_t first_global = global_names_.size();
+        const std::span<const FlatAst::Index> statements = ast.statements();
+        // The variables of blocks go above every global the program declares.
+        next_slot_ = first_global + std::count_if(statements.begin(), statements.end(), [&ast](const FlatAst::Index statement) {
+            return ast.node(statement).opcode == Opcode::VARIABLE_DECLARATION;
+        });
+        try
+        {
+            for (const FlatAst::Index statement : statements)
+            {
+                if (ast.node(statement).opcode == Opcode::VARIABLE_DECLARATION)
+                {
+                    declare_global(statement);
+                }
+                else
+                {
+                    resolve_statement(statement);
+                }
+            }
+        }
+        catch (const BeelineResolveError&)
+        {
+            forget_globals(first_global);
+            throw;
+        }
+    }
+    void resolve(FlatAst& ast, const FlatAst::Index block, const FlatAst::Index lazy_block, const std::size_t stack_size)
+    {
+        ast_ = &ast;
+        locals_.clear();
+        const FlatAst::Node& node = ast.node(lazy_block);
+        for (const FlatAst::Index free_variable : ast.list(node.a, node.b))
+        {
+            locals_.push_back(Local{ast.node(free_variable).a, ast.node(free_variable).c});
+        }
+        next_slot_ = stack_size;
+        resolve_statement(block);
+    }
+    std::size_t global_count() const
+    {
+        return global_names_.size();
+    }
+    void forget_globals(const std::size_t first_slot)
+    {
+        for (std::size_t slot = first_slot; slot < global_names_.size(); ++slot)
+        {
+            globals_.erase(global_names_[slot]);
+        }
+        global_names_.resize(std::min(first_slot, global_names_.size()));
+    }
+private:
+    struct Local
+    {
+        // Names are interned, so locals are told apart by name index.
+        FlatAst::Index name;
+        FlatAst::Index slot;
+    };
+    FlatAst* ast_{nullptr};
+    std::unordered_map<std::string, FlatAst::Index, NameHash, std::equal_to<>> globals_;
+    // Names of the globals, by slot.
+    std::vector<std::string> global_names_;
+    // Variables of the blocks around the node being resolved, innermost last.
+    std::vector<Local> locals_;
+    // Where the variables of the innermost block start in locals_.
+    std::size_t block_start_{0};
+    std::size_t next_slot_{0};
+    void declare_global(const FlatAst::Index index)
+    {
+        FlatAst::Node& node = ast_->node(index);
+        if (node.b != FlatAst::NONE)
+        {
+            resolve_expression(node.b);
+        }
+        const std::string_view name = ast_->name(node.a);
+        if (globals_.find(name) != globals_.end())
+        {
+            panic(index, "variable '" + std::string{name} + "' is already defined");
+        }
+        node.c = static_cast<FlatAst::Index>(global_names_.size());
+        globals_.emplace(name, node.c);
+        global_names_.emplace_back(name);
+    }
+    void resolve_statement(const FlatAst::Index index)
+    {
+        FlatAst::Node& node = ast_->node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+                resolve_expression(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                if (node.b != FlatAst::NONE)
+                {
+                    resolve_expression(node.b);
+                }
+                if (std::any_of(locals_.begin() + block_start_, locals_.end(), [&node](const Local& local) { return local.name == node.a; }))
+                {
+                    panic(index, "variable '" + std::string{ast_->name(node.a)} + "' is already defined");
+                }
+                node.c = static_cast<FlatAst::Index>(next_slot_++);
+                locals_.push_back(Local{node.a, node.c});
+                break;
+            case Opcode::BLOCK:
+            {
+                const std::size_t first_local = locals_.size();
+                const std::size_t first_slot = next_slot_;
+                ScopedReplace<std::size_t> replacer(block_start_, first_local);
+                for (const FlatAst::Index statement : ast_->list(node.a, node.b))
+                {
+                    resolve_statement(statement);
+                }
+                node.c = static_cast<FlatAst::Index>(next_slot_ - first_slot);
+                locals_.resize(first_local);
+                next_slot_ = first_slot;
+                break;
+            }
+            case Opcode::LAZY_BLOCK:
+                for (const FlatAst::Index free_variable : ast_->list(node.a, node.b))
+                {
+                    resolve_expression(free_variable);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                resolve_expression(node.a);
+                resolve_statement(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    resolve_statement(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                node.c = static_cast<FlatAst::Index>(next_slot_);
+                resolve_expression(node.a);
+                resolve_statement(node.b);
+                break;
+            default:
+                assert(false && "node is not a statement");
+        }
+    }
+    void resolve_expression(const FlatAst::Index index)
+    {
+        FlatAst::Node& node = ast_->node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                break;
+            case Opcode::VARIABLE:
+                node.c = lookup(index);
+                break;
+            case Opcode::ASSIGNMENT:
+                // The target comes first in the source, and so does its error.
+                node.c = lookup(index);
+                resolve_expression(node.b);
+                break;
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+                resolve_expression(node.a);
+                break;
+            default:
+                resolve_expression(node.a);
+                resolve_expression(node.b);
+                break;
+        }
+    }
+    // Returns the slot of the variable named by the node at the given index.
+    FlatAst::Index lookup(const FlatAst::Index index) const
+    {
+        const FlatAst::Index name_index = ast_->node(index).a;
+        const auto local = std::find_if(locals_.rbegin(), locals_.rend(), [name_index](const Local& local) { return local.name == name_index; });
+        if (local != locals_.rend())
+        {
+            return local->slot;
+        }
+        const std::string_view name = ast_->name(name_index);
+        if (const auto global = globals_.find(name); global != globals_.end())
+        {
+            return global->second;
+        }
+        panic(index, "variable '" + std::string{name} + "' is undefined");
+        return FlatAst::NONE;
+    }
+    void panic(const FlatAst::Index index, const std::string& message) const
+    {
+        BeelineResolveError bre{message, ast_->source(), ast_->position(index)};
+        log(LoggingLevel::ERROR) << bre;
+        throw bre;
+    }
+};
+
+
+Resolver::Resolver() : impl_{std::make_unique<Impl>()} {}
+Resolver::~Resolver() = default;
+void Resolver::resolve(FlatAst& ast)
+{
+    impl_->resolve(ast);
+}
+void Resolver::resolve(FlatAst& ast, const FlatAst::Index block, const FlatAst::Index lazy_block, const std::size_t stack_size)
+{
+    impl_->resolve(ast, block, lazy_block, stack_size);
+}
+std::size_t Resolver::global_count() const
+{
+    return impl_->global_count();
+}
+void Resolver::forget_globals(const std::size_t first_slot)
+{
+    impl_->forget_globals(first_slot);
+}
+
+
+BeelineResolveError::BeelineResolveError(const std::string& message, const Source& source, const Token::Position& position) : BeelineError{message}, source{source}, position{position} {}
+
+
+std::ostream& operator<<(std::ostream& os, const BeelineResolveError& bre)
+{
+    return os << "BeelineResolveError: " << bre.what() << " at " << to_string(bre.source, bre.position);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "beeline.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "flat_ast.hpp"
+
+
+// Resolves the variables of flat ASTs to the slots of the interpreter's stack
+// that hold them, so that they are accessed by index instead of looked up by
+// name. Beeline has no functions, so scopes nest strictly and every variable
+// has a fixed slot: globals fill the bottom of the stack in the order they
+// are declared, and the variables of each block follow those of the blocks
+// around it. Globals are kept from one program to the next.
+class Resolver
+{
+public:
+    Resolver();
+    ~Resolver();
+    // Resolves the top-level statements of the given program, which may use
+    // the globals of earlier programs. Stops at the first variable that is
+    // undefined where it is used, or that is declared twice in one block or
+    // at the top level, and
+    // throws a BeelineResolveError after forgetting the globals the program
+    // declares.
+    void resolve(FlatAst& ast);
+    // Resolves the block the given lazy block was parsed into in the scope of
+    // the lazy block, whose variables fill the stack up to the given size.
+    void resolve(FlatAst& ast, const FlatAst::Index block, const FlatAst::Index lazy_block, const std::size_t stack_size);
+    // Returns the number of globals, which fill the bottom of the stack.
+    std::size_t global_count() const;
+    // Forgets the globals from the given slot on, whose declarations did not
+    // run, so that later programs can declare them again.
+    void forget_globals(const std::size_t first_slot);
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+
+// Exception thrown when a variable cannot be resolved.
+class BeelineResolveError : public BeelineError
+{
+public:
+    BeelineResolveError(const std::string& message, const Source& source, const Token::Position& position);
+    Source source;
+    Token::Position position;
+};
+
+
+std::ostream& operator<<(std::ostream& os, const BeelineResolveError& bre);
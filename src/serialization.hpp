@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+// Appends the bytes of plain values, strings and vectors of plain values to
+// a buffer. Values are written in native byte order, for caches that are
+// read back on the same machine.
+class Writer
+{
+public:
+    Writer(std::string& buffer) : buffer_{buffer} {}
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    // Writes the number of values followed by the values.
+    template <typename T>
+    void write(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write<std::uint64_t>(values.size());
+        buffer_.append(reinterpret_cast<const char*>(values.data()), sizeof(T) * values.size());
+    }
+    void write(const std::string_view text)
+    {
+        write<std::uint64_t>(text.size());
+        buffer_.append(text);
+    }
+private:
+    std::string& buffer_;
+};
+
+
+// Reads values written by a Writer. Reads fail, leaving their destination
+// untouched, once they would run past the end of the data.
+class Reader
+{
+public:
+    Reader(std::string_view data) : data_{data} {}
+    template <typename T>
+    bool read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (data_.size() < sizeof(T))
+        {
+            return false;
+        }
+        std::memcpy(&value, data_.data(), sizeof(T));
+        data_.remove_prefix(sizeof(T));
+        return true;
+    }
+    template <typename T>
+    bool read(std::vector<T>& values)
+    {
+        std::uint64_t size = 0;
+        if (!read(size) || size > data_.size() / sizeof(T))
+        {
+            return false;
+        }
+        values.resize(size);
+        std::memcpy(values.data(), data_.data(), sizeof(T) * size);
+        data_.remove_prefix(sizeof(T) * size);
+        return true;
+    }
+    bool read(std::string& text)
+    {
+        std::uint64_t size = 0;
+        if (!read(size) || size > data_.size())
+        {
+            return false;
+        }
+        text.assign(data_.data(), size);
+        data_.remove_prefix(size);
+        return true;
+    }
+    bool is_done() const
+    {
+        return data_.empty();
+    }
+private:
+    std::string_view data_;
+};
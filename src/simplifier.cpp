@@ -0,0 +1,206 @@
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "simplifier.hpp"
+#include "flat_ast.hpp"
+#include "lexer.hpp"
+#include "type_inference.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Simplifies flat ASTs bottom up and in place, keeping the types of the
+// nodes it has visited.
+class Simplifier
+{
+public:
+    Simplifier(FlatAst& ast, const std::span<const FlatAst::Index> statements) : ast_{ast}, variable_types_{ast, statements}, types_(ast.size(), ANY) {}
+    void simplify(const std::span<const FlatAst::Index> statements)
+    {
+        for (const FlatAst::Index statement : statements)
+        {
+            simplify_statement(statement);
+        }
+    }
+private:
+    FlatAst& ast_;
+    VariableTypes variable_types_;
+    // Types of the nodes simplified so far, by index.
+    std::vector<Types> types_;
+    void simplify_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+                simplify_expression(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                if (node.b != FlatAst::NONE)
+                {
+                    simplify_expression(node.b);
+                }
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    simplify_statement(statement);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                simplify_expression(node.a);
+                simplify_statement(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    simplify_statement(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                simplify_expression(node.a);
+                simplify_statement(node.b);
+                break;
+            default:
+                break;
+        }
+    }
+    void simplify_expression(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                types_[index] = type_of(ast_.constant(node.a));
+                return;
+            case Opcode::VARIABLE:
+                types_[index] = variable_types_.at(node.c);
+                return;
+            case Opcode::ASSIGNMENT:
+                simplify_expression(node.b);
+                types_[index] = types_[node.b];
+                return;
+            case Opcode::GROUPING:
+                // Groupings only order the operations of the tree.
+                simplify_expression(node.a);
+                replace(index, node.a);
+                return;
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            {
+                simplify_expression(node.a);
+                types_[index] = result_types(node.opcode, types_[node.a], 0);
+                // -(-x) is x for numbers, and !!x for booleans.
+                const FlatAst::Node& operand = ast_.node(node.a);
+                if (operand.opcode == node.opcode && types_[operand.a] == types_[index])
+                {
+                    replace(index, operand.a);
+                }
+                return;
+            }
+            default:
+                break;
+        }
+        simplify_expression(node.a);
+        simplify_expression(node.b);
+        const Types left = types_[node.a];
+        const Types right = types_[node.b];
+        types_[index] = result_types(node.opcode, left, right);
+        switch (node.opcode)
+        {
+            case Opcode::ADD:
+                if (left == STRING && is_literal(node.b, std::string{}))
+                {
+                    replace(index, node.a);
+                }
+                else if (right == STRING && is_literal(node.a, std::string{}))
+                {
+                    replace(index, node.b);
+                }
+                break;
+            case Opcode::SUBTRACT:
+                // Subtracting 0 keeps the sign of -0, which adding 0 does not.
+                if (left == NUMBER && is_literal(node.b, 0.0))
+                {
+                    replace(index, node.a);
+                }
+                break;
+            case Opcode::MULTIPLY:
+                if (left == NUMBER && is_literal(node.b, 1.0))
+                {
+                    replace(index, node.a);
+                }
+                else if (right == NUMBER && is_literal(node.a, 1.0))
+                {
+                    replace(index, node.b);
+                }
+                break;
+            case Opcode::DIVIDE:
+                if (left == NUMBER && is_literal(node.b, 1.0))
+                {
+                    replace(index, node.a);
+                }
+                break;
+            case Opcode::AND:
+            case Opcode::OR:
+            {
+                // true and x, x and true, false or x and x or false are x.
+                const bool identity = node.opcode == Opcode::AND;
+                if (left == BOOLEAN && is_literal(node.b, identity))
+                {
+                    replace(index, node.a);
+                }
+                else if (right == BOOLEAN && is_literal(node.a, identity))
+                {
+                    replace(index, node.b);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    // Returns whether the node at the given index is the given literal, with
+    // numbers compared by their bits to tell 0 from -0.
+    template <typename T>
+    bool is_literal(const FlatAst::Index index, const T& value) const
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        if (node.opcode != Opcode::LITERAL || !std::holds_alternative<T>(ast_.constant(node.a)))
+        {
+            return false;
+        }
+        if constexpr (std::is_same_v<T, double>)
+        {
+            return std::bit_cast<std::uint64_t>(std::get<double>(ast_.constant(node.a))) == std::bit_cast<std::uint64_t>(value);
+        }
+        else
+        {
+            return std::get<T>(ast_.constant(node.a)) == value;
+        }
+    }
+    // Replaces the expression at the given index by its operand at another.
+    void replace(const FlatAst::Index index, const FlatAst::Index operand)
+    {
+        ast_.replace(index, operand);
+        types_[index] = types_[operand];
+    }
+};
+
+
+void simplify(FlatAst& ast)
+{
+    Simplifier{ast, ast.statements()}.simplify(ast.statements());
+}
+
+
+void simplify(FlatAst& ast, const FlatAst::Index statement)
+{
+    const std::span<const FlatAst::Index> statements{&statement, 1};
+    Simplifier{ast, statements}.simplify(statements);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "flat_ast.hpp"
+
+
+// Rewrites algebraic identities in the given resolved flat AST, such as
+// x * 1, -(-x) and !!x, into simpler expressions with the same value, and
+// removes groupings. An identity is only rewritten where the types of its
+// operands are known to be the ones it holds for, as the interpreter would
+// otherwise report an error. The types of variables are known if every value
+// the program stores in them has that type.
+void simplify(FlatAst& ast);
+
+
+// Simplifies the statement at the given index of the given resolved flat
+// AST, as above. The variables it does not declare have unknown types.
+void simplify(FlatAst& ast, const FlatAst::Index statement);
@@ -0,0 +1,120 @@
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "beeline.hpp"
+#include "source.hpp"
+#include "logging.hpp"
+
+
+class Source::Buffer
+{
+public:
+    Buffer(std::string text, const std::size_t first_line) : owned_text_{std::move(text)}, text_{owned_text_}, first_line_{first_line} {}
+    Buffer(const char* mapping, const std::size_t size, std::string name) : text_{mapping, size}, name_{std::move(name)}, mapping_{mapping} {}
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    ~Buffer()
+    {
+        if (mapping_)
+        {
+            munmap(const_cast<char*>(mapping_), text_.size());
+        }
+    }
+    std::string_view text() const
+    {
+        return text_;
+    }
+    std::string_view name() const
+    {
+        return name_;
+    }
+    Location locate(const std::size_t offset) const
+    {
+        std::call_once(line_starts_built_, [this]() { build_line_starts(); });
+        // The line containing the offset is the last one starting at or before it.
+        auto it = std::upper_bound(line_starts_.begin(), line_starts_.end(), offset);
+        const std::size_t line = it - line_starts_.begin();
+        return Location{first_line_ + line - 1, offset - line_starts_[line - 1] + 1};
+    }
+private:
+    std::string owned_text_;
+    std::string_view text_;
+    std::string name_;
+    std::size_t first_line_{1};
+    // Start of the memory mapping backing text_, if any.
+    const char* mapping_{nullptr};
+    mutable std::once_flag line_starts_built_;
+    mutable std::vector<std::size_t> line_starts_;
+    // Records the offset at which every line starts. Newlines are counted
+    // first so the table is allocated once, then found with memchr, which
+    // scans many bytes per instruction.
+    void build_line_starts() const
+    {
+        line_starts_.reserve(std::count(text_.begin(), text_.end(), '\n') + 1);
+        line_starts_.push_back(0);
+        const char* const begin = text_.data();
+        const char* const end = begin + text_.size();
+        for (const char* c = begin; (c = static_cast<const char*>(std::memchr(c, '\n', end - c))); ++c)
+        {
+            line_starts_.push_back(c - begin + 1);
+        }
+    }
+};
+
+
+// Logs and throws an error about the file at the given path, described by errno.
+[[noreturn]] void panic_about_file(const std::string& path, const std::string& action)
+{
+    BeelineError be{"cannot " + action + " '" + path + "': " + std::strerror(errno)};
+    log(LoggingLevel::ERROR) << be;
+    throw be;
+}
+
+
+Source::Source(std::string text, const std::size_t first_line) : buffer_{std::make_shared<const Buffer>(std::move(text), first_line)} {}
+Source::Source(std::shared_ptr<const Buffer> buffer) : buffer_{std::move(buffer)} {}
+Source Source::map(const std::string& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        panic_about_file(path, "open");
+    }
+    struct stat status;
+    if (fstat(fd, &status) < 0)
+    {
+        close(fd);
+        panic_about_file(path, "stat");
+    }
+    const std::size_t size = status.st_size;
+    if (size == 0)
+    {
+        // Empty files cannot be mapped.
+        close(fd);
+        return Source{std::make_shared<const Buffer>(std::string{}, 1)};
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping remains valid after the file is closed.
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        panic_about_file(path, "map");
+    }
+    // The lexer reads the source front to back, so the kernel may read ahead aggressively.
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    return Source{std::make_shared<const Buffer>(static_cast<const char*>(mapping), size, path)};
+}
+std::string_view Source::text() const { return buffer_->text(); }
+std::string_view Source::name() const { return buffer_->name(); }
+Source::Location Source::locate(const std::size_t offset) const { return buffer_->locate(offset); }
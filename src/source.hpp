@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+
+// Immutable, reference-counted buffer of beeline source code. Copies share
+// the same underlying text, so tokens and AST nodes can refer into it through
+// std::string_view for as long as any copy of the source is alive.
+class Source
+{
+public:
+    // 1-based line and column of a character in the source.
+    struct Location
+    {
+        std::size_t line;
+        std::size_t column;
+    };
+
+    Source() = delete;
+    // Creates a source from the given text. If the text continues some earlier
+    // text, first_line is the line of that text the given text starts on.
+    explicit Source(std::string text, const std::size_t first_line = 1);
+    // Creates a source from the file at the given path, which is mapped into
+    // memory read-only rather than copied. The source is named after the path.
+    static Source map(const std::string& path);
+    // Returns a view of the source text.
+    std::string_view text() const;
+    // Returns the name of the source, which is empty unless it was read from a file.
+    std::string_view name() const;
+    // Resolves the given offset into a line and column. The table of line
+    // starts is built on first use, so sources that never report an error
+    // never pay for it.
+    Location locate(const std::size_t offset) const;
+private:
+    class Buffer;
+    std::shared_ptr<const Buffer> buffer_;
+    Source(std::shared_ptr<const Buffer> buffer);
+};
@@ -0,0 +1,186 @@
+#include <cstddef>
+#include <string_view>
+
+#include "splitter.hpp"
+
+
+constexpr bool is_identifier_character(const char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+
+std::size_t Splitter::scan(std::string_view text)
+{
+    for (const char c : text)
+    {
+        ++offset_;
+        switch (state_)
+        {
+            case State::STRING:
+                if (c == '"')
+                {
+                    state_ = State::CODE;
+                }
+                continue;
+            case State::COMMENT:
+                if (c != '\n')
+                {
+                    continue;
+                }
+                state_ = State::CODE;
+                break;
+            case State::CODE:
+                break;
+        }
+        if (previous_was_slash_)
+        {
+            previous_was_slash_ = false;
+            if (c == '/')
+            {
+                state_ = State::COMMENT;
+                continue;
+            }
+            // The slash was a division operator.
+            start_token();
+        }
+        if (is_identifier_character(c))
+        {
+            if (identifier_length_ < sizeof(identifier_))
+            {
+                identifier_[identifier_length_] = c;
+            }
+            ++identifier_length_;
+            continue;
+        }
+        end_identifier();
+        switch (c)
+        {
+            case '/':
+                // Whether the slash starts a comment, which must not confirm a
+                // candidate boundary, is only known from the next character.
+                previous_was_slash_ = true;
+                break;
+            case ' ':
+            case '\t':
+            case '\r':
+                break;
+            case '\n':
+                if (depth_ == 0 && in_declaration_ && !in_header_ && !awaiting_statement_ && !has_candidate_)
+                {
+                    if (open_ifs_ == 0)
+                    {
+                        set_boundary(offset_);
+                    }
+                    else
+                    {
+                        candidate_ = offset_;
+                        has_candidate_ = true;
+                    }
+                }
+                break;
+            case '"':
+                start_token();
+                state_ = State::STRING;
+                break;
+            case '(':
+            case '{':
+                start_token();
+                ++depth_;
+                break;
+            case ')':
+            case '}':
+                start_token();
+                // Unbalanced closers are syntax errors, which the parser reports.
+                if (depth_ > 0)
+                {
+                    --depth_;
+                }
+                if (depth_ == 0 && in_header_ && c == ')')
+                {
+                    in_header_ = false;
+                    awaiting_statement_ = true;
+                }
+                break;
+            default:
+                start_token();
+                break;
+        }
+    }
+    return boundary_;
+}
+
+
+std::size_t Splitter::confirm()
+{
+    if (has_candidate_)
+    {
+        set_boundary(candidate_);
+    }
+    return boundary_;
+}
+
+
+std::size_t Splitter::finish()
+{
+    end_identifier();
+    set_boundary(offset_);
+    return boundary_;
+}
+
+
+void Splitter::end_identifier()
+{
+    if (identifier_length_ == 0)
+    {
+        return;
+    }
+    const std::string_view identifier{identifier_, identifier_length_ <= sizeof(identifier_) ? identifier_length_ : 0};
+    identifier_length_ = 0;
+    if (identifier == "else")
+    {
+        // The declaration continues, so the newline before it is no boundary.
+        has_candidate_ = false;
+        if (depth_ == 0)
+        {
+            awaiting_statement_ = true;
+            if (open_ifs_ > 0)
+            {
+                --open_ifs_;
+            }
+        }
+        return;
+    }
+    start_token();
+    if (depth_ == 0 && (identifier == "if" || identifier == "while"))
+    {
+        in_header_ = true;
+        if (identifier == "if")
+        {
+            ++open_ifs_;
+        }
+    }
+}
+
+
+void Splitter::start_token()
+{
+    if (has_candidate_)
+    {
+        set_boundary(candidate_);
+    }
+    in_declaration_ = true;
+    if (depth_ == 0)
+    {
+        awaiting_statement_ = false;
+    }
+}
+
+
+void Splitter::set_boundary(const std::size_t boundary)
+{
+    boundary_ = boundary;
+    has_candidate_ = false;
+    in_declaration_ = false;
+    open_ifs_ = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+
+// Incrementally finds the boundaries between complete top-level declarations
+// in beeline source code without lexing or parsing it. A boundary follows a
+// newline that is outside of strings, comments, braces and parentheses, that
+// does not end an 'if' or 'while' header or an 'else' still waiting for its
+// statement, and that is not followed by an 'else'. Only a declaration with
+// an 'if' whose 'else' may still follow waits for the next token to confirm
+// its boundary; every other one is confirmed at its newline. Offsets are
+// relative to the start of all text scanned so far.
+class Splitter
+{
+public:
+    // Scans the given text, which continues the text scanned so far. Returns
+    // the offset just past the last boundary confirmed so far.
+    std::size_t scan(std::string_view text);
+    // Confirms the boundary at the last newline scanned, if it is awaiting
+    // the next token, as if that token were not an 'else'. Returns the offset
+    // just past the last boundary confirmed so far.
+    std::size_t confirm();
+    // Signals the end of input. Returns the offset of the end of the input,
+    // which is the final boundary.
+    std::size_t finish();
+private:
+    enum struct State
+    {
+        CODE,
+        STRING,
+        COMMENT,
+    };
+    State state_{State::CODE};
+    std::size_t offset_{0};
+    std::size_t boundary_{0};
+    // Boundary awaiting the next token, which must not be an 'else'.
+    std::size_t candidate_{0};
+    bool has_candidate_{false};
+    // Nesting depth of braces and parentheses.
+    std::size_t depth_{0};
+    // Set once the declaration being scanned has a token.
+    bool in_declaration_{false};
+    // Number of top-level 'if' keywords of the declaration being scanned
+    // that are not yet matched by an 'else', which may still follow.
+    std::size_t open_ifs_{0};
+    // Set between an 'if' or 'while' keyword and the end of its condition.
+    bool in_header_{false};
+    // Set after a header or an 'else' until its statement starts.
+    bool awaiting_statement_{false};
+    // Set after a slash that may start a comment.
+    bool previous_was_slash_{false};
+    // Identifier being scanned, which may span calls to scan. Only its
+    // first few characters are kept since only keywords are of interest.
+    char identifier_[6]{};
+    std::size_t identifier_length_{0};
+    void end_identifier();
+    void start_token();
+    void set_boundary(const std::size_t boundary);
+};
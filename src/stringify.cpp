@@ -70,13 +70,18 @@ public:
     void visit(const Statement::Block& block) override
     {
         buffer_ << "{";
-        for (const auto& statement : block.statements)
+        for (const Statement* statement : block.statements)
         {
             statement->accept(*this);
             buffer_ << " ";
         }
         buffer_ << "}";
     }
+    void visit(const Statement::LazyBlock&) override
+    {
+        // The statements of the block have not been parsed yet.
+        buffer_ << "{...}";
+    }
     void visit(const Statement::IfElse& if_else) override
     {
         buffer_ << "(if ";
@@ -116,5 +121,6 @@ void ExpressionToString::visit(const Statement::Expression& expression) { impl_-
 void ExpressionToString::visit(const Statement::Print& print) { impl_->visit(print); }
 void ExpressionToString::visit(const Statement::VariableDeclaration& variable_declaration) { impl_->visit(variable_declaration); }
 void ExpressionToString::visit(const Statement::Block& block) { impl_->visit(block); }
+void ExpressionToString::visit(const Statement::LazyBlock& lazy_block) { impl_->visit(lazy_block); }
 void ExpressionToString::visit(const Statement::IfElse& if_else) { impl_->visit(if_else); }
 void ExpressionToString::visit(const Statement::WhileLoop& while_loop) { impl_->visit(while_loop); }
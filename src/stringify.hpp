@@ -23,6 +23,7 @@ public:
     void visit(const Statement::Print& print) override;
     void visit(const Statement::VariableDeclaration& variable_declaration) override;
     void visit(const Statement::Block& block) override;
+    void visit(const Statement::LazyBlock& lazy_block) override;
     void visit(const Statement::IfElse& if_else) override;
     void visit(const Statement::WhileLoop& while_loop) override;
 private:
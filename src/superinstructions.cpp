@@ -0,0 +1,198 @@
+#include <string>
+#include <variant>
+
+#include "superinstructions.hpp"
+#include "flat_ast.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Fuses flat ASTs bottom up and in place. A fused expression moves the nodes
+// it stands for to a copy at the end of the flat AST, and takes their place.
+class SuperinstructionFuser
+{
+public:
+    explicit SuperinstructionFuser(FlatAst& ast) : ast_{ast} {}
+    void fuse_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+                fuse_expression(node.a);
+                fuse_append(index);
+                break;
+            case Opcode::PRINT:
+                fuse_expression(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                if (node.b != FlatAst::NONE)
+                {
+                    fuse_expression(node.b);
+                }
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    fuse_statement(statement);
+                }
+                break;
+            case Opcode::IF_ELSE:
+            case Opcode::IF_ELSE_BOOLEAN:
+                fuse_expression(node.a);
+                fuse_statement(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    fuse_statement(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+            case Opcode::WHILE_LOOP_BOOLEAN:
+                fuse_expression(node.a);
+                fuse_statement(node.b);
+                break;
+            default:
+                break;
+        }
+    }
+private:
+    FlatAst& ast_;
+    void fuse_expression(const FlatAst::Index index)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+            case Opcode::VARIABLE:
+                return;
+            case Opcode::ASSIGNMENT:
+                fuse_expression(node.b);
+                fuse_increment(index);
+                return;
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+            case Opcode::NEGATE_NUMBER:
+            case Opcode::NOT_BOOLEAN:
+                fuse_expression(node.a);
+                return;
+            default:
+                break;
+        }
+        fuse_expression(node.a);
+        fuse_expression(node.b);
+        switch (node.opcode)
+        {
+            case Opcode::GREATER_NUMBERS:
+                fuse_comparison(index, Opcode::GREATER_CONSTANT, Opcode::LESS_CONSTANT);
+                break;
+            case Opcode::GREATER_EQUAL_NUMBERS:
+                fuse_comparison(index, Opcode::GREATER_EQUAL_CONSTANT, Opcode::LESS_EQUAL_CONSTANT);
+                break;
+            case Opcode::LESS_NUMBERS:
+                fuse_comparison(index, Opcode::LESS_CONSTANT, Opcode::GREATER_CONSTANT);
+                break;
+            case Opcode::LESS_EQUAL_NUMBERS:
+                fuse_comparison(index, Opcode::LESS_EQUAL_CONSTANT, Opcode::GREATER_EQUAL_CONSTANT);
+                break;
+            default:
+                break;
+        }
+    }
+    // Fuses the assignment at the given index into an increment if it adds a
+    // constant to, or subtracts one from, the number it assigns to.
+    void fuse_increment(const FlatAst::Index index)
+    {
+        const FlatAst::Node assignment = ast_.node(index);
+        const FlatAst::Node value = ast_.node(assignment.b);
+        if (value.opcode == Opcode::ADD_NUMBERS)
+        {
+            // Adding numbers is commutative.
+            if (is_variable(value.a, assignment.c) && is_literal(value.b))
+            {
+                fuse(index, Opcode::INCREMENT, ast_.node(value.b).a, assignment.c);
+            }
+            else if (is_literal(value.a) && is_variable(value.b, assignment.c))
+            {
+                fuse(index, Opcode::INCREMENT, ast_.node(value.a).a, assignment.c);
+            }
+        }
+        else if (value.opcode == Opcode::SUBTRACT_NUMBERS && is_variable(value.a, assignment.c) && is_literal(value.b))
+        {
+            // Subtracting a number is exactly adding its negation.
+            const double constant = *std::get_if<double>(&ast_.constant(ast_.node(value.b).a));
+            fuse(index, Opcode::INCREMENT, ast_.add_constant(-constant), assignment.c);
+        }
+    }
+    // Fuses the comparison at the given index into the given form if it
+    // compares a variable to a constant, or into the mirrored form if it
+    // compares a constant to a variable.
+    void fuse_comparison(const FlatAst::Index index, const Opcode form, const Opcode mirrored)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        if (is_variable(node.a) && is_literal(node.b))
+        {
+            fuse(index, form, ast_.node(node.b).a, ast_.node(node.a).c);
+        }
+        else if (is_literal(node.a) && is_variable(node.b))
+        {
+            fuse(index, mirrored, ast_.node(node.a).a, ast_.node(node.b).c);
+        }
+    }
+    // Fuses the expression statement at the given index into an append if it
+    // assigns a variable the variable followed by a string literal.
+    void fuse_append(const FlatAst::Index index)
+    {
+        FlatAst::Node& statement = ast_.node(index);
+        const FlatAst::Node assignment = ast_.node(statement.a);
+        if (assignment.opcode != Opcode::ASSIGNMENT)
+        {
+            return;
+        }
+        const FlatAst::Node value = ast_.node(assignment.b);
+        if (value.opcode == Opcode::ADD && is_variable(value.a, assignment.c) && is_literal(value.b)
+            && std::holds_alternative<std::string>(ast_.constant(ast_.node(value.b).a)))
+        {
+            // The statement only refers to the assignment, which stays where
+            // it is.
+            statement = FlatAst::Node{Opcode::APPEND, statement.a, ast_.node(value.b).a, assignment.c};
+        }
+    }
+    // Replaces the expression at the given index by the given superinstruction,
+    // which keeps a copy of it.
+    void fuse(const FlatAst::Index index, const Opcode opcode, const FlatAst::Index constant, const FlatAst::Index slot)
+    {
+        const FlatAst::Node node = ast_.node(index);
+        const FlatAst::Index copy = ast_.add(node.opcode, ast_.position(index), node.a, node.b, node.c);
+        ast_.node(index) = FlatAst::Node{opcode, copy, constant, slot};
+    }
+    bool is_literal(const FlatAst::Index index) const
+    {
+        return ast_.node(index).opcode == Opcode::LITERAL;
+    }
+    bool is_variable(const FlatAst::Index index) const
+    {
+        return ast_.node(index).opcode == Opcode::VARIABLE;
+    }
+    bool is_variable(const FlatAst::Index index, const FlatAst::Index slot) const
+    {
+        return is_variable(index) && ast_.node(index).c == slot;
+    }
+};
+
+
+void fuse_superinstructions(FlatAst& ast)
+{
+    SuperinstructionFuser fuser{ast};
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        fuser.fuse_statement(statement);
+    }
+}
+
+
+void fuse_superinstructions(FlatAst& ast, const FlatAst::Index statement)
+{
+    SuperinstructionFuser{ast}.fuse_statement(statement);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "flat_ast.hpp"
+
+
+// Fuses the common shapes of the given resolved and type checked flat AST
+// into superinstructions that the interpreter runs in a single step:
+// increments of a number variable by a constant, such as `i = i + 1`,
+// comparisons of a number variable to a constant, such as `i < 10`, and
+// statements appending a string literal to a variable, such as
+// `s = s + "x"`, which append in place. Only operators whose operands are
+// proven to be numbers are fused into increments and comparisons, so these
+// cannot fail; appends fall back on the nodes they stand for if the variable
+// does not hold a string.
+void fuse_superinstructions(FlatAst& ast);
+
+
+// Fuses the superinstructions of the statement at the given index of the
+// given resolved and type checked flat AST, as above.
+void fuse_superinstructions(FlatAst& ast, const FlatAst::Index statement);
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+
+class ThreadPool::Impl
+{
+public:
+    Impl() = delete;
+    Impl(const std::size_t threads)
+    {
+        workers_.reserve(std::max<std::size_t>(threads, 1));
+        for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i)
+        {
+            workers_.emplace_back([this]() { work(); });
+        }
+    }
+    ~Impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stopping_ = true;
+        }
+        task_available_.notify_all();
+        for (std::thread& worker : workers_)
+        {
+            worker.join();
+        }
+    }
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            tasks_.push_back(std::move(task));
+            ++unfinished_;
+        }
+        task_available_.notify_one();
+    }
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        all_finished_.wait(lock, [this]() { return unfinished_ == 0; });
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable task_available_;
+    std::condition_variable all_finished_;
+    std::deque<std::function<void()>> tasks_;
+    // Number of tasks that are queued or running.
+    std::size_t unfinished_{0};
+    bool stopping_{false};
+    std::vector<std::thread> workers_;
+    // Runs queued tasks until the pool is stopped and the queue is drained.
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock{mutex_};
+                task_available_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                --unfinished_;
+            }
+            all_finished_.notify_all();
+        }
+    }
+};
+
+
+ThreadPool::ThreadPool(const std::size_t threads) : impl_(std::make_unique<Impl>(threads)) {}
+ThreadPool::~ThreadPool() = default;
+void ThreadPool::submit(std::function<void()> task) { impl_->submit(std::move(task)); }
+void ThreadPool::wait() { impl_->wait(); }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+
+// Fixed set of worker threads running submitted tasks in submission order.
+// Destroying the pool waits for every submitted task to finish.
+class ThreadPool
+{
+public:
+    ThreadPool() = delete;
+    // Starts the given number of worker threads, at least one.
+    explicit ThreadPool(const std::size_t threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    // Queues the given task to run on one of the worker threads. Tasks must
+    // not throw.
+    void submit(std::function<void()> task);
+    // Blocks until every task submitted so far has finished.
+    void wait();
+private:
+    // PIMPL idiom
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,647 @@
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "type_checker.hpp"
+#include "flat_ast.hpp"
+#include "interpreter.hpp"
+#include "lexer.hpp"
+#include "logging.hpp"
+#include "type_inference.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+// Infers the types of the operands of each node along the paths through the
+// statements, with the types of the variables at each point, then either
+// reports the type errors or gives the nodes their forms. Each loop is walked until the types of the variables at
+// its condition stop changing, so the last walk of a node is the one that
+// holds for every iteration of the loops around it.
+class TypeChecker
+{
+public:
+    // The statements checked run whenever the program does if runs is set,
+    // so that type errors in them fail the program before it runs. If
+    // specializes is set, the nodes are given their forms instead, and
+    // nothing is reported, as the program was checked before it was
+    // optimized.
+    TypeChecker(FlatAst& ast, const bool runs, const bool specializes) : ast_{ast}, operands_(ast.size()), constants_(ast.size()), runs_{runs}, specializes_{specializes} {}
+    void infer_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+                infer_expression(node.a);
+                break;
+            case Opcode::PRINT:
+                operands_[index] = Operands{infer_expression(node.a), 0};
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+            {
+                const Types types = node.b == FlatAst::NONE ? NULL_TYPE : infer_expression(node.b);
+                assign(node.c, types);
+                break;
+            }
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    infer_statement(statement);
+                }
+                break;
+            case Opcode::LAZY_BLOCK:
+                // The code of lazy blocks is not known yet, so they may store
+                // anything in the variables they refer to.
+                for (const FlatAst::Index free_variable : ast_.list(node.a, node.b))
+                {
+                    assign(ast_.node(free_variable).c, ANY);
+                }
+                break;
+            case Opcode::IF_ELSE:
+            {
+                operands_[index] = Operands{infer_expression(node.a), 0};
+                const std::size_t before = trail_.size();
+                infer_statement(node.b);
+                if (node.c == FlatAst::NONE)
+                {
+                    merge(changes(before));
+                    break;
+                }
+                // The types the then branch leaves in the variables it
+                // assigns, which the else branch starts without.
+                std::vector<Change> then_changes = changes(before);
+                for (Change& change : then_changes)
+                {
+                    change.types = slots_[change.slot];
+                }
+                undo(before);
+                infer_statement(node.c);
+                std::vector<Change> else_changes = changes(before);
+                ++generation_;
+                for (const auto [variable, types] : then_changes)
+                {
+                    seen_[variable] = generation_;
+                    assign(variable, slots_[variable] | types);
+                }
+                for (const auto [variable, types] : else_changes)
+                {
+                    // Variables both branches assign hold what either left.
+                    if (seen_[variable] != generation_)
+                    {
+                        assign(variable, slots_[variable] | types);
+                    }
+                }
+                break;
+            }
+            case Opcode::WHILE_LOOP:
+            {
+                while (true)
+                {
+                    const std::size_t entry = trail_.size();
+                    operands_[index] = Operands{infer_expression(node.a), 0};
+                    const std::size_t exit = trail_.size();
+                    infer_statement(node.b);
+                    // The variables the loop assigns enter the next iteration
+                    // with the types they entered this one with, or left it
+                    // with.
+                    std::vector<Change> widened;
+                    for (const auto [variable, types] : changes(entry))
+                    {
+                        if ((types | slots_[variable]) != types)
+                        {
+                            widened.push_back(Change{variable, static_cast<Types>(types | slots_[variable])});
+                        }
+                    }
+                    if (widened.empty())
+                    {
+                        undo(exit);
+                        break;
+                    }
+                    undo(entry);
+                    for (const auto [variable, types] : widened)
+                    {
+                        assign(variable, types);
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    // Reports the type errors of the statement at the given index, or gives
+    // its nodes their forms.
+    void check_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+                check_expression(node.a);
+                break;
+            case Opcode::PRINT:
+            {
+                check_expression(node.a);
+                const Types value = operands_[index].left;
+                if (value != 0 && !(value & STRING))
+                {
+                    warn("operand must be a string", index);
+                }
+                break;
+            }
+            case Opcode::VARIABLE_DECLARATION:
+                if (node.b != FlatAst::NONE)
+                {
+                    check_expression(node.b);
+                }
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    check_statement(statement);
+                }
+                break;
+            case Opcode::IF_ELSE:
+            {
+                check_expression(node.a);
+                check_condition(index, Opcode::IF_ELSE_BOOLEAN);
+                const bool runs = runs_;
+                runs_ = false;
+                check_statement(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    check_statement(node.c);
+                }
+                runs_ = runs;
+                break;
+            }
+            case Opcode::WHILE_LOOP:
+            {
+                check_expression(node.a);
+                check_condition(index, Opcode::WHILE_LOOP_BOOLEAN);
+                const bool runs = runs_;
+                runs_ = false;
+                check_statement(node.b);
+                // Nothing after a loop that never ends runs.
+                runs_ = runs && value_of(node.a) != Token::Literal{true};
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    // Throws the first error on a path that runs whenever the program does,
+    // if any.
+    void raise() const
+    {
+        if (error_)
+        {
+            std::rethrow_exception(error_);
+        }
+    }
+private:
+    // Types of the operands of a node where it last ran, or of the condition
+    // or value of a statement. None if it never runs.
+    struct Operands
+    {
+        Types left;
+        Types right;
+    };
+    // Types a variable held before an assignment, or holds after one.
+    struct Change
+    {
+        FlatAst::Index slot;
+        Types types;
+    };
+    FlatAst& ast_;
+    // Types of the variables at the point being inferred, by slot.
+    std::vector<Types> slots_;
+    // Types the variables held before each assignment of slots_, in order,
+    // so that branches and loops touch only the variables they assign.
+    std::vector<Change> trail_;
+    // Generation in which each slot was last seen while listing changes.
+    std::vector<std::uint32_t> seen_;
+    std::uint32_t generation_{0};
+    std::vector<Operands> operands_;
+    // Whether each expression reads no variable, so that its value is known
+    // before the program runs.
+    std::vector<bool> constants_;
+    // Whether the expression being checked is part of a constant one.
+    bool in_constant_{false};
+    // Number of type errors reported.
+    std::size_t reports_{0};
+    // Whether the node being checked runs whenever the program does, unless
+    // it fails before then.
+    bool runs_;
+    bool specializes_;
+    // First type error or failing constant expression on a path that runs
+    // whenever the program does.
+    std::exception_ptr error_;
+    Types& slot(const FlatAst::Index index)
+    {
+        if (index >= slots_.size())
+        {
+            slots_.resize(index + 1, ANY);
+            seen_.resize(index + 1, 0);
+        }
+        return slots_[index];
+    }
+    void assign(const FlatAst::Index index, const Types types)
+    {
+        Types& variable = slot(index);
+        trail_.push_back(Change{index, variable});
+        variable = types;
+    }
+    // Returns the variables assigned since the trail had the given size,
+    // with the types they held then.
+    std::vector<Change> changes(const std::size_t mark)
+    {
+        ++generation_;
+        std::vector<Change> first_changes;
+        for (std::size_t i = mark; i < trail_.size(); ++i)
+        {
+            if (seen_[trail_[i].slot] != generation_)
+            {
+                seen_[trail_[i].slot] = generation_;
+                first_changes.push_back(trail_[i]);
+            }
+        }
+        return first_changes;
+    }
+    // Restores the types the variables held when the trail had the given
+    // size.
+    void undo(const std::size_t mark)
+    {
+        while (trail_.size() > mark)
+        {
+            slots_[trail_.back().slot] = trail_.back().types;
+            trail_.pop_back();
+        }
+    }
+    // Adds the given types the variables held at another point that leads to
+    // the point being inferred.
+    void merge(const std::vector<Change>& other)
+    {
+        for (const auto [variable, types] : other)
+        {
+            assign(variable, slots_[variable] | types);
+        }
+    }
+    // Returns the types the expression at the given index may have if it
+    // succeeds, and stores those of the values it assigns.
+    Types infer_expression(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                constants_[index] = true;
+                return type_of(ast_.constant(node.a));
+            case Opcode::VARIABLE:
+                return slot(node.c);
+            case Opcode::ASSIGNMENT:
+            {
+                const Types types = infer_expression(node.b);
+                assign(node.c, types);
+                return types;
+            }
+            case Opcode::GROUPING:
+            {
+                const Types types = infer_expression(node.a);
+                constants_[index] = constants_[node.a];
+                return types;
+            }
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            {
+                const Types operand = infer_expression(node.a);
+                operands_[index] = Operands{operand, 0};
+                constants_[index] = constants_[node.a];
+                return result_types(node.opcode, operand, 0);
+            }
+            case Opcode::AND:
+            case Opcode::OR:
+            {
+                const Types left = infer_expression(node.a);
+                // The right operand is not always evaluated.
+                const std::size_t before = trail_.size();
+                const Types right = infer_expression(node.b);
+                merge(changes(before));
+                operands_[index] = Operands{left, right};
+                constants_[index] = constants_[node.a] && constants_[node.b];
+                return BOOLEAN;
+            }
+            default:
+            {
+                const Types left = infer_expression(node.a);
+                const Types right = infer_expression(node.b);
+                operands_[index] = Operands{left, right};
+                constants_[index] = constants_[node.a] && constants_[node.b];
+                return result_types(node.opcode, left, right);
+            }
+        }
+    }
+    void check_expression(const FlatAst::Index index)
+    {
+        FlatAst::Node& node = ast_.node(index);
+        const auto [left, right] = operands_[index];
+        if (constants_[index] && node.opcode != Opcode::LITERAL && !in_constant_ && !specializes_)
+        {
+            // The interpreter checks the types of operands before their
+            // values, so a constant expression is evaluated only if its
+            // types check.
+            const std::size_t reports = reports_;
+            in_constant_ = true;
+            check_expression(index);
+            in_constant_ = false;
+            if (reports_ == reports)
+            {
+                check_constant(index);
+            }
+            return;
+        }
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+            case Opcode::VARIABLE:
+                return;
+            case Opcode::ASSIGNMENT:
+                check_expression(node.b);
+                return;
+            case Opcode::GROUPING:
+                check_expression(node.a);
+                return;
+            case Opcode::NEGATE:
+                check_expression(node.a);
+                check_operand(index, Opcode::NEGATE_NUMBER, left, NUMBER, "operand must be a number");
+                return;
+            case Opcode::NOT:
+                check_expression(node.a);
+                check_operand(index, Opcode::NOT_BOOLEAN, left, BOOLEAN, "operand must be a boolean");
+                return;
+            default:
+                break;
+        }
+        check_expression(node.a);
+        if (node.opcode == Opcode::AND || node.opcode == Opcode::OR)
+        {
+            // The right operand is not always evaluated.
+            const bool runs = runs_;
+            runs_ = false;
+            check_expression(node.b);
+            runs_ = runs;
+        }
+        else
+        {
+            check_expression(node.b);
+        }
+        if (left == 0 || right == 0)
+        {
+            return;
+        }
+        switch (node.opcode)
+        {
+            case Opcode::ADD:
+                if (left == NUMBER && right == NUMBER)
+                {
+                    specialize(node, Opcode::ADD_NUMBERS);
+                }
+                else if (!(result_types(Opcode::ADD, left, right)))
+                {
+                    // In the order the interpreter checks them.
+                    if (left == NULL_TYPE)
+                    {
+                        warn("left operand must not be null", index);
+                    }
+                    else if (right == NULL_TYPE)
+                    {
+                        warn("right operand must not be null", index);
+                    }
+                    else if ((left & ~NULL_TYPE) == BOOLEAN && (right & ~NULL_TYPE) == BOOLEAN)
+                    {
+                        warn("cannot add two booleans", index);
+                    }
+                    else
+                    {
+                        warn(std::string{left & NUMBER ? "right" : "left"} + " operand must be a number to participate in addition", index);
+                    }
+                }
+                break;
+            case Opcode::SUBTRACT:
+                check_operands(index, Opcode::SUBTRACT_NUMBERS, left, right, NUMBER, "a number");
+                break;
+            case Opcode::MULTIPLY:
+                check_operands(index, Opcode::MULTIPLY_NUMBERS, left, right, NUMBER, "a number");
+                break;
+            case Opcode::DIVIDE:
+                check_operands(index, Opcode::DIVIDE_NUMBERS, left, right, NUMBER, "a number");
+                // A division by zero fails whatever it divides, so nothing
+                // after it runs.
+                if (runs_ && !in_constant_ && value_of(node.b) == Token::Literal{0.0})
+                {
+                    runs_ = false;
+                }
+                break;
+            case Opcode::GREATER:
+                check_operands(index, Opcode::GREATER_NUMBERS, left, right, NUMBER, "a number");
+                break;
+            case Opcode::GREATER_EQUAL:
+                check_operands(index, Opcode::GREATER_EQUAL_NUMBERS, left, right, NUMBER, "a number");
+                break;
+            case Opcode::LESS:
+                check_operands(index, Opcode::LESS_NUMBERS, left, right, NUMBER, "a number");
+                break;
+            case Opcode::LESS_EQUAL:
+                check_operands(index, Opcode::LESS_EQUAL_NUMBERS, left, right, NUMBER, "a number");
+                break;
+            case Opcode::AND:
+            case Opcode::OR:
+                // The right operand fails only if it is evaluated.
+                if (left == BOOLEAN && right == BOOLEAN)
+                {
+                    specialize(node, node.opcode == Opcode::AND ? Opcode::AND_BOOLEANS : Opcode::OR_BOOLEANS);
+                }
+                else if (!(left & BOOLEAN))
+                {
+                    warn("left operand must be a boolean", index);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    // Gives the branch or loop at the given index the given form if its
+    // condition is a boolean, or warns if it cannot be.
+    void check_condition(const FlatAst::Index index, const Opcode form)
+    {
+        FlatAst::Node& node = ast_.node(index);
+        const Types condition = operands_[index].left;
+        if (condition == BOOLEAN)
+        {
+            specialize(node, form);
+        }
+        else if (condition != 0 && !(condition & BOOLEAN))
+        {
+            warn("condition must evaluate to a boolean", index);
+        }
+    }
+    // Gives the unary node at the given index the given form if its operand
+    // has the given type, or warns if it cannot.
+    void check_operand(const FlatAst::Index index, const Opcode form, const Types operand, const Types type, const std::string& message)
+    {
+        FlatAst::Node& node = ast_.node(index);
+        if (operand == type)
+        {
+            specialize(node, form);
+        }
+        else if (operand != 0 && !(operand & type))
+        {
+            warn(message, index);
+        }
+    }
+    // Gives the binary node at the given index the given form if both its
+    // operands have the given type, or warns if either cannot.
+    void check_operands(const FlatAst::Index index, const Opcode form, const Types left, const Types right, const Types type, const std::string& type_name)
+    {
+        FlatAst::Node& node = ast_.node(index);
+        if (left == type && right == type)
+        {
+            specialize(node, form);
+        }
+        else if ((!(left & type) || !(right & type)))
+        {
+            warn(std::string{left & type ? "right" : "left"} + " operand must be " + type_name, index);
+        }
+    }
+    void specialize(FlatAst::Node& node, const Opcode form) const
+    {
+        if (specializes_)
+        {
+            node.opcode = form;
+        }
+    }
+    // Returns the value of the expression at the given index if it is
+    // constant and does not fail.
+    std::optional<Token::Literal> value_of(const FlatAst::Index index)
+    {
+        if (specializes_ || !constants_[index])
+        {
+            return std::nullopt;
+        }
+        try
+        {
+            return Interpreter::evaluate_constant(ast_, index);
+        }
+        catch (const BeelineRuntimeError&)
+        {
+            return std::nullopt;
+        }
+    }
+    // Evaluates the constant expression at the given index, whose failure is
+    // reported as an error if it is on a path that runs whenever the program
+    // does, or as a warning otherwise.
+    void check_constant(const FlatAst::Index index)
+    {
+        try
+        {
+            Interpreter::evaluate_constant(ast_, index);
+        }
+        catch (const BeelineRuntimeError& bre)
+        {
+            if (!runs_)
+            {
+                log(LoggingLevel::WARN) << "constant expression fails if it runs: " + std::string{bre.what()} + " at " + to_string(bre.source, bre.position);
+                return;
+            }
+            log(LoggingLevel::ERROR) << bre;
+            fail(std::make_exception_ptr(bre));
+        }
+    }
+    // Reports a type error at the given index as an error if it is on a path
+    // that runs whenever the program does, or as a warning otherwise.
+    void warn(const std::string& message, const FlatAst::Index index)
+    {
+        if (specializes_)
+        {
+            return;
+        }
+        ++reports_;
+        if (!runs_)
+        {
+            log(LoggingLevel::WARN) << "type error if it runs: " + message + " at " + to_string(ast_.source(), ast_.position(index));
+            return;
+        }
+        const BeelineTypeError error{message, ast_.source(), ast_.position(index)};
+        log(LoggingLevel::ERROR) << error;
+        fail(std::make_exception_ptr(error));
+    }
+    // Records the given error, which the program fails with before it runs.
+    void fail(const std::exception_ptr error)
+    {
+        error_ = error;
+        // The program fails here, so nothing after it runs.
+        runs_ = false;
+    }
+};
+
+
+void check_types(FlatAst& ast)
+{
+    TypeChecker checker{ast, true, false};
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        checker.infer_statement(statement);
+    }
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        checker.check_statement(statement);
+    }
+    checker.raise();
+}
+
+
+void check_types(FlatAst& ast, const FlatAst::Index statement)
+{
+    // The statement is a lazy block being expanded as it runs, so its type
+    // errors are left to fail as it does.
+    TypeChecker checker{ast, false, false};
+    checker.infer_statement(statement);
+    checker.check_statement(statement);
+}
+
+
+void specialize_types(FlatAst& ast)
+{
+    TypeChecker checker{ast, false, true};
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        checker.infer_statement(statement);
+    }
+    for (const FlatAst::Index statement : ast.statements())
+    {
+        checker.check_statement(statement);
+    }
+}
+
+
+void specialize_types(FlatAst& ast, const FlatAst::Index statement)
+{
+    TypeChecker checker{ast, false, true};
+    checker.infer_statement(statement);
+    checker.check_statement(statement);
+}
+
+
+BeelineTypeError::BeelineTypeError(const std::string& message, const Source& source, const Token::Position& position) : BeelineError{message}, source{source}, position{position} {}
+
+
+std::ostream& operator<<(std::ostream& os, const BeelineTypeError& bte)
+{
+    return os << "BeelineTypeError: " << bte.what() << " at " << to_string(bte.source, bte.position);
+}
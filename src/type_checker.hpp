@@ -0,0 +1,53 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "beeline.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "flat_ast.hpp"
+
+
+// Follows the types of the variables of the given resolved flat AST through
+// its statements in order. Variables declared elsewhere, and those that lazy
+// blocks refer to after the lazy blocks, may have any type. Operations that
+// fail on every type their operands may have, and constant expressions that
+// fail, are logged as warnings, and left to fail if they run, unless they run
+// whenever the program does: then they are logged as errors, and the first
+// of them is thrown, as a BeelineTypeError or the BeelineRuntimeError the
+// constant expression fails with. Programs are checked as they are resolved, before they are
+// optimized, so that which passes run does not change which programs fail.
+void check_types(FlatAst& ast);
+
+
+// Checks the types of the statement at the given index of the given resolved
+// flat AST, as above, except that its type errors are only logged as
+// warnings.
+void check_types(FlatAst& ast, const FlatAst::Index statement);
+
+
+// Follows the types of the variables of the given resolved flat AST as
+// above, and gives the operators whose operands are proven to be numbers or
+// booleans, and the branches and loops whose conditions are proven to be
+// booleans, the forms that the interpreter runs unchecked.
+void specialize_types(FlatAst& ast);
+
+
+// Specializes the statement at the given index of the given resolved flat
+// AST, as above.
+void specialize_types(FlatAst& ast, const FlatAst::Index statement);
+
+
+// Exception thrown when an operation that runs whenever the program does
+// fails on every type its operands may have.
+class BeelineTypeError : public BeelineError
+{
+public:
+    BeelineTypeError(const std::string& message, const Source& source, const Token::Position& position);
+    Source source;
+    Token::Position position;
+};
+
+
+std::ostream& operator<<(std::ostream& os, const BeelineTypeError& bte);
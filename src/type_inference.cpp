@@ -0,0 +1,220 @@
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "type_inference.hpp"
+#include "flat_ast.hpp"
+#include "lexer.hpp"
+
+
+using Opcode = FlatAst::Opcode;
+
+
+Types type_of(const Token::Literal& value)
+{
+    if (std::holds_alternative<double>(value))
+    {
+        return NUMBER;
+    }
+    if (std::holds_alternative<std::string>(value))
+    {
+        return STRING;
+    }
+    if (std::holds_alternative<bool>(value))
+    {
+        return BOOLEAN;
+    }
+    return NULL_TYPE;
+}
+
+
+Types result_types(const Opcode opcode, const Types left, const Types right)
+{
+    switch (opcode)
+    {
+        case Opcode::ADD:
+        {
+            // Strings concatenate with anything but null, and booleans do
+            // not add up.
+            Types types = (left & NUMBER) && (right & NUMBER) ? NUMBER : 0;
+            if (((left & STRING) && (right & ~NULL_TYPE)) || ((right & STRING) && (left & ~NULL_TYPE)))
+            {
+                types |= STRING;
+            }
+            return types;
+        }
+        case Opcode::SUBTRACT:
+        case Opcode::MULTIPLY:
+        case Opcode::DIVIDE:
+        case Opcode::NEGATE:
+            return NUMBER;
+        case Opcode::GROUPING:
+            return left;
+        default:
+            return BOOLEAN;
+    }
+}
+
+
+// Walks the statements until the types of the variables stop changing.
+class VariableTypeInference
+{
+public:
+    VariableTypeInference(const FlatAst& ast, std::unordered_map<FlatAst::Index, Types>& types) : ast_{ast}, types_{types} {}
+    void infer(const std::span<const FlatAst::Index> statements)
+    {
+        for (const FlatAst::Index statement : statements)
+        {
+            declare_statement(statement);
+        }
+        for (const FlatAst::Index slot : escaped_slots_)
+        {
+            types_[slot] = ANY;
+        }
+        do
+        {
+            is_changed_ = false;
+            for (const FlatAst::Index statement : statements)
+            {
+                infer_statement(statement);
+            }
+        }
+        while (is_changed_);
+    }
+private:
+    const FlatAst& ast_;
+    std::unordered_map<FlatAst::Index, Types>& types_;
+    std::vector<FlatAst::Index> escaped_slots_;
+    bool is_changed_{false};
+    void declare_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::VARIABLE_DECLARATION:
+                types_.emplace(node.c, 0);
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    declare_statement(statement);
+                }
+                break;
+            case Opcode::LAZY_BLOCK:
+                for (const FlatAst::Index free_variable : ast_.list(node.a, node.b))
+                {
+                    escaped_slots_.push_back(ast_.node(free_variable).c);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                declare_statement(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    declare_statement(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                declare_statement(node.b);
+                break;
+            default:
+                break;
+        }
+    }
+    Types slot_types(const FlatAst::Index slot) const
+    {
+        const auto types = types_.find(slot);
+        return types != types_.end() ? types->second : ANY;
+    }
+    void store(const FlatAst::Index slot, const Types types)
+    {
+        const auto slot_types = types_.find(slot);
+        if (slot_types != types_.end() && (slot_types->second | types) != slot_types->second)
+        {
+            slot_types->second |= types;
+            is_changed_ = true;
+        }
+    }
+    void infer_statement(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::EXPRESSION:
+            case Opcode::PRINT:
+                infer_expression(node.a);
+                break;
+            case Opcode::VARIABLE_DECLARATION:
+                store(node.c, node.b == FlatAst::NONE ? NULL_TYPE : infer_expression(node.b));
+                break;
+            case Opcode::BLOCK:
+                for (const FlatAst::Index statement : ast_.list(node.a, node.b))
+                {
+                    infer_statement(statement);
+                }
+                break;
+            case Opcode::IF_ELSE:
+                infer_expression(node.a);
+                infer_statement(node.b);
+                if (node.c != FlatAst::NONE)
+                {
+                    infer_statement(node.c);
+                }
+                break;
+            case Opcode::WHILE_LOOP:
+                infer_expression(node.a);
+                infer_statement(node.b);
+                break;
+            default:
+                break;
+        }
+    }
+    // Returns the types the expression at the given index may have, storing
+    // those of the values it assigns.
+    Types infer_expression(const FlatAst::Index index)
+    {
+        const FlatAst::Node& node = ast_.node(index);
+        switch (node.opcode)
+        {
+            case Opcode::LITERAL:
+                return type_of(ast_.constant(node.a));
+            case Opcode::VARIABLE:
+                return slot_types(node.c);
+            case Opcode::ASSIGNMENT:
+            {
+                const Types types = infer_expression(node.b);
+                store(node.c, types);
+                return types;
+            }
+            case Opcode::NEGATE:
+            case Opcode::NOT:
+            case Opcode::GROUPING:
+                return result_types(node.opcode, infer_expression(node.a), 0);
+            default:
+            {
+                const Types left = infer_expression(node.a);
+                return result_types(node.opcode, left, infer_expression(node.b));
+            }
+        }
+    }
+};
+
+
+VariableTypes::VariableTypes(const FlatAst& ast, const std::span<const FlatAst::Index> statements)
+{
+    VariableTypeInference{ast, types_}.infer(statements);
+}
+
+
+Types VariableTypes::at(const FlatAst::Index slot) const
+{
+    const auto types = types_.find(slot);
+    return types != types_.end() ? types->second : ANY;
+}
+
+
+void VariableTypes::add(const FlatAst::Index slot, const Types types)
+{
+    types_[slot] |= types;
+}
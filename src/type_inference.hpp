@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+
+#include "flat_ast.hpp"
+#include "lexer.hpp"
+
+
+// Set of the types a value may have, one bit per type.
+using Types = std::uint8_t;
+constexpr Types NULL_TYPE = 1 << 0;
+constexpr Types NUMBER = 1 << 1;
+constexpr Types STRING = 1 << 2;
+constexpr Types BOOLEAN = 1 << 3;
+constexpr Types ANY = NULL_TYPE | NUMBER | STRING | BOOLEAN;
+
+
+Types type_of(const Token::Literal& value);
+
+
+// Returns the types the given operator may produce from operands of the
+// given types, if it does not fail. Unary operators ignore the right types.
+Types result_types(const FlatAst::Opcode opcode, const Types left, const Types right);
+
+
+// Types of the variables that some statements of a resolved flat AST declare,
+// found by adding the types of the values stored in each to its own until
+// none gains another. Variables declared elsewhere may have any type, and so
+// may those that lazy blocks refer to, as the code of lazy blocks is not
+// known yet.
+class VariableTypes
+{
+public:
+    VariableTypes(const FlatAst& ast, const std::span<const FlatAst::Index> statements);
+    // Returns the types the variable in the given slot may have.
+    Types at(const FlatAst::Index slot) const;
+    // Adds the given types to those of the variable in the given slot. A slot
+    // that none of the statements declares, such as that of a temporary
+    // added later, gets exactly the given types.
+    void add(const FlatAst::Index slot, const Types types);
+private:
+    std::unordered_map<FlatAst::Index, Types> types_;
+};
@@ -0,0 +1,93 @@
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+
+
+// Counts its live instances, to check that the arena destroys it.
+struct Counted
+{
+    Counted(int& count) : count{count} { ++count; }
+    ~Counted() { --count; }
+    int& count;
+};
+
+
+TEST_CASE("arena")
+{
+    SECTION("aligns objects")
+    {
+        Arena arena;
+        arena.make<char>('a');
+        const double* number = arena.make<double>(1.5);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(number) % alignof(double) == 0);
+        REQUIRE(*number == 1.5);
+    }
+    SECTION("outgrows its blocks")
+    {
+        Arena arena;
+        std::vector<const std::uint64_t*> numbers;
+        for (std::uint64_t i = 0; i < 10000; ++i)
+        {
+            numbers.push_back(arena.make<std::uint64_t>(i));
+        }
+        for (std::uint64_t i = 0; i < numbers.size(); ++i)
+        {
+            REQUIRE(*numbers[i] == i);
+        }
+    }
+    SECTION("copies sequences")
+    {
+        Arena arena;
+        const std::vector<int> values{1, 2, 3};
+        const std::span<int> copies = arena.copy(values);
+        REQUIRE(std::vector<int>(copies.begin(), copies.end()) == values);
+        REQUIRE(arena.copy(std::vector<int>{}).empty());
+    }
+    SECTION("destroys objects that need it")
+    {
+        int count = 0;
+        {
+            Arena arena;
+            arena.make<Counted>(count);
+            arena.make<std::string>(100, 'x');
+            REQUIRE(count == 1);
+        }
+        REQUIRE(count == 0);
+    }
+    SECTION("merges")
+    {
+        int count = 0;
+        {
+            Arena arena;
+            const int* number = nullptr;
+            {
+                Arena other;
+                other.make<Counted>(count);
+                number = other.make<int>(7);
+                arena.merge(std::move(other));
+            }
+            REQUIRE(count == 1);
+            REQUIRE(*number == 7);
+        }
+        REQUIRE(count == 0);
+    }
+    SECTION("clears")
+    {
+        int count = 0;
+        Arena arena;
+        arena.make<Counted>(count);
+        const std::uint64_t* first = arena.make<std::uint64_t>(1);
+        arena.clear();
+        REQUIRE(count == 0);
+        arena.make<Counted>(count);
+        REQUIRE(count == 1);
+        // The block is reused from its start.
+        REQUIRE(arena.make<std::uint64_t>(2) == first);
+        arena.clear();
+        REQUIRE(count == 0);
+    }
+}
@@ -2,22 +2,72 @@
 
 #include <sstream>
 
+#include "arena.hpp"
 #include "ast.hpp"
 #include "stringify.hpp"
 
 
+// Evaluates numeric expressions through static dispatch, returning values directly.
+struct Evaluator
+{
+    double operator()(const Expression::Binary& binary) const
+    {
+        return dispatch(*binary.left, *this) * dispatch(*binary.right, *this);
+    }
+    double operator()(const Expression::Grouping& grouping) const
+    {
+        return dispatch(*grouping.expression, *this);
+    }
+    double operator()(const Expression::Literal& literal) const
+    {
+        return std::get<double>(literal.value);
+    }
+    double operator()(const Expression::Unary& unary) const
+    {
+        return -dispatch(*unary.right, *this);
+    }
+    double operator()(const Expression::Variable&) const
+    {
+        return 0;
+    }
+    double operator()(const Expression::Assignment&) const
+    {
+        return 0;
+    }
+};
+
+
+TEST_CASE("dispatch")
+{
+    Arena arena;
+    const Expression* expression = arena.make<Expression::Binary>(
+        arena.make<Expression::Unary>(
+            Token{Token::Type::MINUS, "-", Token::Position{0, 0}},
+            arena.make<Expression::Literal>(1.5)
+        ),
+        Token{Token::Type::STAR, "*", Token::Position{0, 0}},
+        arena.make<Expression::Grouping>(
+            arena.make<Expression::Literal>(4.0)
+        )
+    );
+    REQUIRE(expression->kind == Expression::Kind::BINARY);
+    REQUIRE(dispatch(*expression, Evaluator{}) == -6.0);
+}
+
+
 TEST_CASE("tostring")
 {
     SECTION("expression")
     {
-        std::unique_ptr<Expression> expression = std::make_unique<Expression::Binary>(
-            std::make_unique<Expression::Unary>(
-                Token{Token::Type::MINUS, "-", nullptr, Token::Position{0, 0, 0, 0}},
-                std::make_unique<Expression::Literal>(149.84)
+        Arena arena;
+        Expression* expression = arena.make<Expression::Binary>(
+            arena.make<Expression::Unary>(
+                Token{Token::Type::MINUS, "-", Token::Position{0, 0}},
+                arena.make<Expression::Literal>(149.84)
             ),
-            Token{Token::Type::STAR, "*", nullptr, Token::Position{0, 0, 0, 0}},
-            std::make_unique<Expression::Grouping>(
-                std::make_unique<Expression::Literal>(true)
+            Token{Token::Type::STAR, "*", Token::Position{0, 0}},
+            arena.make<Expression::Grouping>(
+                arena.make<Expression::Literal>(true)
             )
         );
         ExpressionToString visitor;
@@ -0,0 +1,73 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+
+#include "flat_ast.hpp"
+#include "test_helpers.hpp"
+
+
+// Parses, lowers, resolves and simplifies the given program, and eliminates
+// its common subexpressions, as the interpreter does for a first program.
+static FlatAst eliminate(const std::string& text)
+{
+    return optimize(text, {"simplifier", "common_subexpressions"});
+}
+
+
+TEST_CASE("common subexpressions")
+{
+    SECTION("stores the first evaluation and reads it later")
+    {
+        const FlatAst ast = eliminate(
+            "var a = 2\n"
+            "var b = 3\n"
+            "var c = 4\n"
+            "{\n"
+            "    var x = 0\n"
+            "    if (a * b + c > 10) {\n"
+            "        x = a * b + c\n"
+            "    }\n"
+            "    print \"\" + (a * b + c)\n"
+            "}\n"
+        );
+        REQUIRE(count_temporaries(ast, FlatAst::Opcode::ASSIGNMENT) == 1);
+        REQUIRE(count_temporaries(ast, FlatAst::Opcode::VARIABLE) == 2);
+        // x takes slot 3, and the temporary slot 4.
+        const FlatAst::Node& block = ast.node(ast.statements()[3]);
+        REQUIRE(block.c == 2);
+        const FlatAst::Node& branch = ast.node(ast.list(block.a, block.b)[1]);
+        const FlatAst::Node& temporary = ast.node(ast.node(branch.a).a);
+        REQUIRE(temporary.opcode == FlatAst::Opcode::ASSIGNMENT);
+        REQUIRE(temporary.c == 4);
+        REQUIRE(ast.node(temporary.b).opcode == FlatAst::Opcode::ADD);
+    }
+    SECTION("reuses the largest expressions")
+    {
+        const FlatAst ast = eliminate("var a = 2\nvar b = 3\n{\n    print \"\" + (a * b + 1)\n    print \"\" + (a * b + 1)\n}\n");
+        REQUIRE(count_temporaries(ast, FlatAst::Opcode::ASSIGNMENT) == 1);
+        REQUIRE(count_temporaries(ast, FlatAst::Opcode::VARIABLE) == 1);
+    }
+    SECTION("stores top-level values in slots above the globals")
+    {
+        const std::string text = "var a = 2\nvar b = 3\nvar c = a * b + 1\nprint \"\" + (a * b + 1)\n{\n    var x = a\n}\n";
+        const FlatAst ast = eliminate(text);
+        REQUIRE(count_temporaries(ast, FlatAst::Opcode::ASSIGNMENT) == 1);
+        REQUIRE(count_temporaries(ast, FlatAst::Opcode::VARIABLE) == 1);
+        // The globals take slots 0 to 2, x slot 3, and the temporary slot 4.
+        const FlatAst::Node& temporary = ast.node(ast.node(ast.statements()[2]).b);
+        REQUIRE(temporary.opcode == FlatAst::Opcode::ASSIGNMENT);
+        REQUIRE(temporary.c == 4);
+        REQUIRE(ast.reserved_stack() == 5);
+        REQUIRE(run(text) == "7");
+        REQUIRE(eliminate("var a = 2\nvar b = a * 2").reserved_stack() == 0);
+    }
+    SECTION("leaves expressions whose variables change, that assign or that may not run")
+    {
+        REQUIRE(count_temporaries(eliminate("var a = 2\n{\n    var x = a * 2\n    a = 1\n    var y = a * 2\n}\n"), FlatAst::Opcode::VARIABLE) == 0);
+        REQUIRE(count_temporaries(eliminate("var a = 2\n{\n    var x = (a = a + 1) * 2\n    var y = (a = a + 1) * 2\n}\n"), FlatAst::Opcode::VARIABLE) == 0);
+        REQUIRE(count_temporaries(eliminate("var a = 2\n{\n    if (a < 3) {\n        var x = a * 2\n    }\n    var y = a * 2\n}\n"), FlatAst::Opcode::VARIABLE) == 0);
+        REQUIRE(count_temporaries(eliminate("var a = 2\n{\n    var x = a < 3 and a * 2 < 5\n    var y = a * 2\n}\n"), FlatAst::Opcode::VARIABLE) == 0);
+        REQUIRE(count_temporaries(eliminate("var a = 2\n{\n    var x = a * 2\n    while (a < 5) {\n        var y = a * 2\n        a = a + 1\n    }\n}\n"), FlatAst::Opcode::VARIABLE) == 0);
+        REQUIRE(count_temporaries(eliminate("var a = 2\n{\n    var x = a * 2\n    while (x < 5) {\n        var y = a * 2\n        x = x + y\n    }\n}\n"), FlatAst::Opcode::VARIABLE) == 1);
+    }
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+
+#include "flat_ast.hpp"
+#include "test_helpers.hpp"
+
+
+// Parses, lowers, resolves and folds the given program.
+static FlatAst fold(const std::string& text)
+{
+    return optimize(text, {"constant_folder"});
+}
+
+
+// Returns the value of the top-level statement at the given index, which
+// must hold a literal.
+static const Token::Literal& folded_value(const FlatAst& ast, const std::size_t statement)
+{
+    const FlatAst::Node& node = ast.node(ast.statements()[statement]);
+    const FlatAst::Index value = node.opcode == FlatAst::Opcode::VARIABLE_DECLARATION ? node.b : node.a;
+    REQUIRE(ast.node(value).opcode == FlatAst::Opcode::LITERAL);
+    return ast.constant(ast.node(value).a);
+}
+
+
+TEST_CASE("constant folder")
+{
+    SECTION("folds expressions of literals as the interpreter evaluates them")
+    {
+        const FlatAst ast = fold(
+            "print \"First \" + 20 + \" elements\"\n"
+            "var a = (5 - 1) * 2 / 8\n"
+            "var b = !(1 < 2) == false\n"
+            "var c = -(0.5) + \"\"\n"
+            "var d = false and a\n"
+            "var e = true or a\n"
+        );
+        REQUIRE(folded_value(ast, 0) == Token::Literal{"First 20 elements"});
+        REQUIRE(folded_value(ast, 1) == Token::Literal{1.0});
+        REQUIRE(folded_value(ast, 2) == Token::Literal{true});
+        REQUIRE(folded_value(ast, 3) == Token::Literal{"-0.5"});
+        REQUIRE(folded_value(ast, 4) == Token::Literal{false});
+        REQUIRE(folded_value(ast, 5) == Token::Literal{true});
+    }
+    SECTION("leaves expressions that fail or read variables")
+    {
+        const FlatAst ast = fold(
+            "var a = 1 / 0\n"
+            "var b = true + false\n"
+            "var c = true and a\n"
+            "var d = (a + 1) * 2\n"
+        );
+        REQUIRE(ast.node(ast.node(ast.statements()[0]).b).opcode == FlatAst::Opcode::DIVIDE);
+        REQUIRE(ast.node(ast.node(ast.statements()[1]).b).opcode == FlatAst::Opcode::ADD);
+        REQUIRE(ast.node(ast.node(ast.statements()[2]).b).opcode == FlatAst::Opcode::AND);
+        const FlatAst::Node& product = ast.node(ast.node(ast.statements()[3]).b);
+        REQUIRE(product.opcode == FlatAst::Opcode::MULTIPLY);
+        REQUIRE(ast.node(product.b).opcode == FlatAst::Opcode::LITERAL);
+    }
+    SECTION("drops branches and loops that never run")
+    {
+        const FlatAst ast = fold(
+            "var a = 1\n"
+            "if (1 > 2)\n"
+            "    a = 2\n"
+            "else\n"
+            "    a = 3\n"
+            "if (true) {\n"
+            "    while (!true)\n"
+            "        a = 4\n"
+            "    if (false)\n"
+            "        a = 5\n"
+            "    a = 6\n"
+            "}\n"
+            "while (1 == 2) {\n"
+            "    a = 7\n"
+            "}\n"
+            "if (\"yes\")\n"
+            "    a = 8\n"
+        );
+        REQUIRE(ast.node(ast.statements()[1]).opcode == FlatAst::Opcode::EXPRESSION);
+        const FlatAst::Node& block = ast.node(ast.statements()[2]);
+        REQUIRE(block.opcode == FlatAst::Opcode::BLOCK);
+        REQUIRE(block.b == 1);
+        REQUIRE(ast.node(ast.list(block.a, block.b)[0]).opcode == FlatAst::Opcode::EXPRESSION);
+        REQUIRE(ast.node(ast.statements()[3]).opcode == FlatAst::Opcode::BLOCK);
+        REQUIRE(ast.node(ast.statements()[3]).b == 0);
+        // A condition that is not a boolean fails when it runs.
+        REQUIRE(ast.node(ast.statements()[4]).opcode == FlatAst::Opcode::IF_ELSE);
+    }
+}
@@ -0,0 +1,106 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "flat_ast.hpp"
+#include "stringify.hpp"
+
+
+// Formats the given statements, one per line.
+std::string stringify(const std::vector<Statement*>& statements)
+{
+    std::string text;
+    for (const Statement* statement : statements)
+    {
+        ExpressionToString visitor;
+        statement->accept(visitor);
+        text += visitor.str() + "\n";
+    }
+    return text;
+}
+
+
+TEST_CASE("flat ast")
+{
+    const Program program = Parser{Lexer{Source{
+        "var a = -1\n"
+        "if (a > 0 and !(a == 2)) {\n"
+        "    print \"positive\" + a\n"
+        "}\n"
+        "else\n"
+        "    a = a * (2 - 1) / 3\n"
+        "while (a < 10 or a != a) {\n"
+        "    var b\n"
+        "    a = a + 1\n"
+        "}\n"
+        "{}\n"
+    }}.scan()}.parse();
+    const FlatAst ast = lower(program);
+    SECTION("keeps the top-level statements")
+    {
+        REQUIRE(ast.statements().size() == program.statements.size());
+    }
+    SECTION("appends children before their parents")
+    {
+        for (FlatAst::Index index = 0; index < ast.size(); ++index)
+        {
+            const FlatAst::Node& node = ast.node(index);
+            if (node.opcode == FlatAst::Opcode::ADD)
+            {
+                REQUIRE(node.a < index);
+                REQUIRE(node.b < index);
+            }
+        }
+    }
+    SECTION("keeps error positions")
+    {
+        const FlatAst::Node& declaration = ast.node(ast.statements()[0]);
+        REQUIRE(declaration.opcode == FlatAst::Opcode::VARIABLE_DECLARATION);
+        REQUIRE(ast.position(ast.statements()[0]).offset == 4);
+        REQUIRE(ast.name(declaration.a) == "a");
+    }
+    SECTION("interns names and constants")
+    {
+        std::vector<FlatAst::Index> names;
+        std::vector<FlatAst::Index> ones;
+        for (FlatAst::Index index = 0; index < ast.size(); ++index)
+        {
+            const FlatAst::Node& node = ast.node(index);
+            if ((node.opcode == FlatAst::Opcode::VARIABLE || node.opcode == FlatAst::Opcode::ASSIGNMENT) && ast.name(node.a) == "a")
+            {
+                names.push_back(node.a);
+            }
+            if (node.opcode == FlatAst::Opcode::LITERAL && ast.constant(node.a) == Token::Literal{1.0})
+            {
+                ones.push_back(node.a);
+            }
+        }
+        REQUIRE(names.size() == 10);
+        REQUIRE(std::count(names.begin(), names.end(), ast.node(ast.statements()[0]).a) == 10);
+        REQUIRE(ones.size() == 3);
+        REQUIRE(std::count(ones.begin(), ones.end(), ones[0]) == 3);
+        std::string data;
+        ast.serialize(data);
+        FlatAst copy = *FlatAst::deserialize(data, ast.source());
+        REQUIRE(copy.add_name("a") == ast.node(ast.statements()[0]).a);
+        REQUIRE(copy.add_constant(1.0) == ones[0]);
+    }
+    SECTION("keeps constants apart by their bits")
+    {
+        FlatAst constants{Source{""}};
+        REQUIRE(constants.add_constant(0.0) != constants.add_constant(-0.0));
+        REQUIRE(constants.add_constant(false) != constants.add_constant(0.0));
+        REQUIRE(constants.add_constant(std::string{"a"}) == constants.add_constant(std::string{"a"}));
+    }
+    SECTION("raises to the same tree")
+    {
+        Arena arena;
+        REQUIRE(stringify(raise(ast, arena)) == stringify(program.statements));
+    }
+}
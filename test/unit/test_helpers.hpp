@@ -0,0 +1,80 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "beeline.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "flat_ast.hpp"
+#include "resolver.hpp"
+#include "pass_manager.hpp"
+
+
+// Parses and lowers the given program, deferring large blocks if lazy.
+inline FlatAst flatten(const std::string& text, const bool lazy = false)
+{
+    return lower(Parser{Lexer{Source{text}}.scan(), lazy}.parse());
+}
+
+
+// Parses, lowers and resolves the given program, and runs the passes of the
+// given pass manager on it, as the interpreter does for a first program.
+inline FlatAst optimize(const std::string& text, const PassManager& passes, const bool lazy = false)
+{
+    FlatAst ast = flatten(text, lazy);
+    Resolver resolver;
+    resolver.resolve(ast);
+    passes.run(ast, resolver.global_count());
+    return ast;
+}
+
+
+// Parses, lowers and resolves the given program, and runs only the given
+// passes on it, in the order they are registered.
+inline FlatAst optimize(const std::string& text, const std::vector<std::string>& passes, const bool lazy = false)
+{
+    return optimize(text, PassManager{OptimizationOptions{0, passes}}, lazy);
+}
+
+
+// Returns the opcode of the value of the last top-level declaration.
+inline FlatAst::Opcode last_value(const FlatAst& ast)
+{
+    return ast.node(ast.node(ast.statements().back()).b).opcode;
+}
+
+
+// Returns the number of nodes of the flat AST with the given opcode that
+// refer to temporaries.
+inline int count_temporaries(const FlatAst& ast, const FlatAst::Opcode opcode = FlatAst::Opcode::VARIABLE_DECLARATION)
+{
+    int temporaries = 0;
+    for (FlatAst::Index index = 0; index < ast.size(); ++index)
+    {
+        const FlatAst::Node& node = ast.node(index);
+        if (node.opcode == opcode && ast.name(node.a).starts_with("$"))
+        {
+            ++temporaries;
+        }
+    }
+    return temporaries;
+}
+
+
+// Returns what the given program prints when it runs whole with the given
+// optimization options.
+inline std::string run(const std::string& text, const OptimizationOptions& optimization = {})
+{
+    std::ostringstream output;
+    std::streambuf* const previous = std::cout.rdbuf(output.rdbuf());
+    Beeline beeline;
+    beeline.optimize(optimization);
+    beeline.run(text);
+    std::cout.rdbuf(previous);
+    return output.str();
+}
@@ -1,6 +1,9 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
+#include <limits>
+#include <string>
+
 #include "lexer.hpp"
 
 
@@ -9,7 +12,7 @@ TEST_CASE("scan")
     SECTION("empty")
     {
         const auto input = "";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         const auto tokens = lexer.scan();
         REQUIRE(tokens.size() == 1);
         REQUIRE(tokens[0].type == Token::Type::END_OF_FILE);
@@ -17,7 +20,7 @@ TEST_CASE("scan")
     SECTION("whitespace")
     {
         const auto input = " \t\r";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         const auto tokens = lexer.scan();
         REQUIRE(tokens.size() == 1);
         REQUIRE(tokens[0].type == Token::Type::END_OF_FILE);
@@ -25,7 +28,7 @@ TEST_CASE("scan")
     SECTION("comment")
     {
         const auto input = "// comment";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         const auto tokens = lexer.scan();
         REQUIRE(tokens.size() == 1);
         REQUIRE(tokens[0].type == Token::Type::END_OF_FILE);
@@ -33,47 +36,84 @@ TEST_CASE("scan")
     SECTION("missing digit after decimal point")
     {
         const auto input = ".h";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         REQUIRE_THROWS_AS(lexer.scan(), BeelineSyntaxError);
     }
     SECTION("unterminated string")
     {
         const auto input = "\"";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         REQUIRE_THROWS_AS(lexer.scan(), BeelineSyntaxError);
     }
     SECTION("unexpected character")
     {
         const auto input = "$";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         REQUIRE_THROWS_AS(lexer.scan(), BeelineSyntaxError);
     }
     SECTION("identifier")
     {
         const auto input = "foobar";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         const auto tokens = lexer.scan();
         REQUIRE(tokens.size() == 2);
         REQUIRE(tokens[0].type == Token::Type::IDENTIFIER);
         REQUIRE(tokens[0].lexeme == "foobar");
         REQUIRE(tokens[1].type == Token::Type::END_OF_FILE);
         REQUIRE(tokens[0].position.offset == 0);
-        REQUIRE(tokens[0].position.line == 1);
-        REQUIRE(tokens[0].position.column == 1);
+        REQUIRE(tokens.source().locate(tokens[0].position.offset).line == 1);
+        REQUIRE(tokens.source().locate(tokens[0].position.offset).column == 1);
         REQUIRE(tokens[0].position.length == 6);
     }
     SECTION("string literal")
     {
         const auto input = "\"foobar\"";
-        auto lexer = Lexer{input};
+        auto lexer = Lexer{Source{input}};
         const auto tokens = lexer.scan();
         REQUIRE(tokens.size() == 2);
         REQUIRE(tokens[0].type == Token::Type::STRING);
         REQUIRE(tokens[0].lexeme == "\"foobar\"");
         REQUIRE(tokens[1].type == Token::Type::END_OF_FILE);
         REQUIRE(tokens[0].position.offset == 0);
-        REQUIRE(tokens[0].position.line == 1);
-        REQUIRE(tokens[0].position.column == 1);
+        REQUIRE(tokens.source().locate(tokens[0].position.offset).line == 1);
+        REQUIRE(tokens.source().locate(tokens[0].position.offset).column == 1);
         REQUIRE(tokens[0].position.length == 8);
     }
+    SECTION("literal side table")
+    {
+        const auto input = "x = 1.5 + \"foo\"";
+        auto lexer = Lexer{Source{input}};
+        const auto tokens = lexer.scan();
+        REQUIRE(tokens.size() == 6);
+        REQUIRE(tokens.literal(0) == Token::Literal{nullptr});
+        REQUIRE(tokens.literal(2) == Token::Literal{1.5});
+        REQUIRE(tokens.literal(4) == Token::Literal{std::string{"foo"}});
+        REQUIRE(tokens.type(5) == Token::Type::END_OF_FILE);
+        REQUIRE(tokens.type(6) == Token::Type::END_OF_FILE);
+    }
+    SECTION("numbers out of range")
+    {
+        const std::string huge(400, '9');
+        const std::string tiny = "0." + std::string(400, '0') + "1";
+        const auto tokens = Lexer{Source{huge + " " + huge + ".5 " + tiny}}.scan();
+        REQUIRE(tokens.literal(0) == Token::Literal{std::numeric_limits<double>::infinity()});
+        REQUIRE(tokens.literal(1) == Token::Literal{std::numeric_limits<double>::infinity()});
+        REQUIRE(tokens.literal(2) == Token::Literal{0.0});
+    }
+}
+
+
+TEST_CASE("locate")
+{
+    const Source source{"a\nbc\n\nd"};
+    REQUIRE(source.locate(0).line == 1);
+    REQUIRE(source.locate(0).column == 1);
+    REQUIRE(source.locate(1).line == 1);
+    REQUIRE(source.locate(1).column == 2);
+    REQUIRE(source.locate(3).line == 2);
+    REQUIRE(source.locate(3).column == 2);
+    REQUIRE(source.locate(5).line == 3);
+    REQUIRE(source.locate(5).column == 1);
+    REQUIRE(source.locate(7).line == 4);
+    REQUIRE(source.locate(7).column == 2);
 }
@@ -0,0 +1,106 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+
+#include "flat_ast.hpp"
+#include "test_helpers.hpp"
+
+
+// Parses, lowers, resolves and simplifies the given program, and moves its
+// loop invariants, as the interpreter does, deferring large blocks if lazy.
+static FlatAst hoist(const std::string& text, const bool lazy = false)
+{
+    return optimize(text, {"simplifier", "loop_invariants"}, lazy);
+}
+
+
+TEST_CASE("loop invariants")
+{
+    SECTION("moves invariants into a block around the loop")
+    {
+        const FlatAst ast = hoist(
+            "var n = 20\n"
+            "var i = 0\n"
+            "var s = \"\"\n"
+            "while (i < n) {\n"
+            "    if (i < (n - 1)) {\n"
+            "        s = s + \",\"\n"
+            "    }\n"
+            "    i = i + 1\n"
+            "}\n"
+        );
+        const FlatAst::Node& block = ast.node(ast.statements()[3]);
+        REQUIRE(block.opcode == FlatAst::Opcode::BLOCK);
+        REQUIRE(block.b == 2);
+        REQUIRE(block.c == 1);
+        const FlatAst::Node& temporary = ast.node(ast.list(block.a, block.b)[0]);
+        REQUIRE(temporary.opcode == FlatAst::Opcode::VARIABLE_DECLARATION);
+        REQUIRE(temporary.c == 3);
+        REQUIRE(ast.node(temporary.b).opcode == FlatAst::Opcode::SUBTRACT);
+        const FlatAst::Node& loop = ast.node(ast.list(block.a, block.b)[1]);
+        REQUIRE(loop.opcode == FlatAst::Opcode::WHILE_LOOP);
+        const FlatAst::Node& branch = ast.node(ast.list(ast.node(loop.b).a, ast.node(loop.b).b)[0]);
+        const FlatAst::Node& comparison = ast.node(branch.a);
+        REQUIRE(ast.node(comparison.b).opcode == FlatAst::Opcode::VARIABLE);
+        REQUIRE(ast.node(comparison.b).c == 3);
+    }
+    SECTION("moves invariants out of large loop bodies when parsing lazily")
+    {
+        std::string text = "var n = 20\nvar i = 0\nvar s = \"\"\nwhile (i < n) {\n    if (i < (n - 1)) {\n";
+        for (int j = 0; j < 16; ++j)
+        {
+            text += "        s = s + \",\"\n";
+        }
+        text += "    }\n    i = i + 1\n}\n";
+        const FlatAst ast = hoist(text, true);
+        const FlatAst::Node& block = ast.node(ast.statements()[3]);
+        REQUIRE(block.opcode == FlatAst::Opcode::BLOCK);
+        REQUIRE(ast.node(ast.node(ast.list(block.a, block.b)[0]).b).opcode == FlatAst::Opcode::SUBTRACT);
+        for (FlatAst::Index index = 0; index < ast.size(); ++index)
+        {
+            REQUIRE(ast.node(index).opcode != FlatAst::Opcode::LAZY_BLOCK);
+        }
+    }
+    SECTION("moves invariants of nested loops out of all of them")
+    {
+        const FlatAst ast = hoist(
+            "var n = 20\n"
+            "var i = 0\n"
+            "while (i < n) {\n"
+            "    var j = 0\n"
+            "    while (j < n * 2) {\n"
+            "        var k = j * (i + 1)\n"
+            "        j = j + 1\n"
+            "    }\n"
+            "    i = i + 1\n"
+            "}\n"
+        );
+        REQUIRE(count_temporaries(ast) == 2);
+        const FlatAst::Node& outer = ast.node(ast.statements()[2]);
+        REQUIRE(outer.opcode == FlatAst::Opcode::BLOCK);
+        const FlatAst::Node& outer_temporary = ast.node(ast.list(outer.a, outer.b)[0]);
+        REQUIRE(ast.node(outer_temporary.b).opcode == FlatAst::Opcode::MULTIPLY);
+        // j and k take slots 2 and 3, and the outer temporary slot 4.
+        REQUIRE(outer_temporary.c == 4);
+        bool found_inner_temporary = false;
+        for (FlatAst::Index index = 0; index < ast.size(); ++index)
+        {
+            const FlatAst::Node& node = ast.node(index);
+            if (node.opcode == FlatAst::Opcode::VARIABLE_DECLARATION && ast.name(node.a).starts_with("$") && node.c != 4)
+            {
+                REQUIRE(ast.node(node.b).opcode == FlatAst::Opcode::ADD);
+                REQUIRE(node.c == 5);
+                found_inner_temporary = true;
+            }
+        }
+        REQUIRE(found_inner_temporary);
+    }
+    SECTION("leaves expressions that change, assign or may fail")
+    {
+        REQUIRE(count_temporaries(hoist("var i = 0\nwhile (i < 10) {\n    i = (i + 1) * 1\n}")) == 0);
+        REQUIRE(count_temporaries(hoist("var a = 1\nvar i = 0\nwhile (i < 10)\n    i = i + (a = 2) * 3")) == 0);
+        REQUIRE(count_temporaries(hoist("var a = 1\nvar b = 0\nvar i = 0\nwhile (i < 10)\n    i = i + a / b")) == 0);
+        REQUIRE(count_temporaries(hoist("var a = 1\n{\n    a = \"a\"\n}\nvar i = 0\nwhile (i < 10)\n    i = i + (a - 1)")) == 0);
+        REQUIRE(count_temporaries(hoist("var a = 1\nvar i = 0\nwhile (i < 10)\n    i = i + a / 2")) == 1);
+    }
+}
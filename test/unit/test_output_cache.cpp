@@ -0,0 +1,167 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "beeline.hpp"
+#include "source.hpp"
+#include "logging.hpp"
+#include "output_cache.hpp"
+
+
+TEST_CASE("output cache")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / ("beeline_test_output_cache_" + std::to_string(getpid()));
+    std::filesystem::remove_all(directory);
+    const std::vector<Source> sources{Source{"print 1\n"}, Source{"print \"two\"\n"}};
+    const OutputCache::Result result{
+        "1\ntwo\n",
+        {LoggedMessage{LoggingLevel::ERROR, "BeelineRuntimeError: operand must be a number"}},
+        "operand must be a number"
+    };
+    SECTION("misses until stored")
+    {
+        const OutputCache cache{directory, 1 << 20};
+        REQUIRE(!cache.load(sources));
+        cache.store(sources, result);
+        const std::optional<OutputCache::Result> loaded = cache.load(sources);
+        REQUIRE(loaded);
+        REQUIRE(loaded->output == result.output);
+        REQUIRE(loaded->messages.size() == 1);
+        REQUIRE(loaded->messages.front().logging_level == LoggingLevel::ERROR);
+        REQUIRE(loaded->messages.front().text == result.messages.front().text);
+        REQUIRE(loaded->failure == result.failure);
+        cache.store(sources, OutputCache::Result{"1\ntwo\n", {}, std::nullopt});
+        REQUIRE(cache.load(sources)->messages.empty());
+        REQUIRE(!cache.load(sources)->failure);
+    }
+    SECTION("keys entries by the names and texts of the sources in order")
+    {
+        const OutputCache cache{directory, 1 << 20};
+        cache.store(sources, result);
+        REQUIRE(!cache.load({sources[1], sources[0]}));
+        REQUIRE(!cache.load({sources[0]}));
+        REQUIRE(!cache.load({Source{"print 2\n"}, sources[1]}));
+        // A file with the same text is a different source.
+        std::filesystem::create_directories(directory);
+        const std::filesystem::path file = directory / "first.bee";
+        std::ofstream{file} << sources[0].text();
+        REQUIRE(!cache.load({Source::map(file.string()), sources[1]}));
+    }
+    SECTION("keys entries by the optimization options")
+    {
+        const OutputCache cache{directory, 1 << 20};
+        cache.store(sources, result);
+        REQUIRE(OutputCache{directory, 1 << 20, OptimizationOptions{2, {}, {}, {}}}.load(sources));
+        REQUIRE(!OutputCache{directory, 1 << 20, OptimizationOptions{0, {}, {}, {}}}.load(sources));
+        const OutputCache enabled{directory, 1 << 20, OptimizationOptions{2, {"simplifier"}, {}, {}}};
+        const OutputCache disabled{directory, 1 << 20, OptimizationOptions{2, {}, {"simplifier"}, {}}};
+        REQUIRE(!enabled.load(sources));
+        REQUIRE(!disabled.load(sources));
+        disabled.store(sources, OutputCache::Result{"1\n", {}, std::nullopt});
+        REQUIRE(!enabled.load(sources));
+        REQUIRE(disabled.load(sources)->output == "1\n");
+        REQUIRE(cache.load(sources)->output == result.output);
+    }
+    SECTION("ignores corrupt entries")
+    {
+        const OutputCache cache{directory, 1 << 20};
+        cache.store(sources, result);
+        std::vector<std::filesystem::path> entries{std::filesystem::directory_iterator{directory}, std::filesystem::directory_iterator{}};
+        REQUIRE(entries.size() == 1);
+        const std::uintmax_t size = std::filesystem::file_size(entries.front());
+        {
+            std::fstream file{entries.front(), std::ios::binary | std::ios::in | std::ios::out};
+            file.seekp(size - 3);
+            file.put('\x7f');
+        }
+        REQUIRE(!cache.load(sources));
+        std::filesystem::resize_file(entries.front(), size / 2);
+        REQUIRE(!cache.load(sources));
+        cache.store(sources, result);
+        REQUIRE(cache.load(sources));
+    }
+    SECTION("evicts the least recently used entries")
+    {
+        const std::string output(1000, 'x');
+        const OutputCache cache{directory, 2500};
+        const std::vector<Source> first{Source{"print 1\n"}};
+        const std::vector<Source> second{Source{"print 2\n"}};
+        const std::vector<Source> third{Source{"print 3\n"}};
+        cache.store(first, OutputCache::Result{output, {}, std::nullopt});
+        cache.store(second, OutputCache::Result{output, {}, std::nullopt});
+        // Make the first entry older than the second, then use it again.
+        for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator{directory})
+        {
+            std::filesystem::last_write_time(entry.path(), std::filesystem::file_time_type::clock::now() - std::chrono::hours{1});
+        }
+        REQUIRE(cache.load(first));
+        cache.store(third, OutputCache::Result{output, {}, std::nullopt});
+        REQUIRE(cache.load(first));
+        REQUIRE(!cache.load(second));
+        REQUIRE(cache.load(third));
+        // Results larger than the whole cache are not kept.
+        cache.store(second, OutputCache::Result{std::string(3000, 'x'), {}, std::nullopt});
+        REQUIRE(!cache.load(second));
+        REQUIRE(cache.load(first));
+    }
+    std::filesystem::remove_all(directory);
+}
+
+
+TEST_CASE("output recorder")
+{
+    std::ostringstream stream;
+    std::string output;
+    SECTION("keeps a copy of the output")
+    {
+        {
+            OutputRecorder recorder{stream, output, 100};
+            stream << "a" << 1 << '\n' << std::flush;
+            REQUIRE(!recorder.overflowed());
+        }
+        stream << "after";
+        REQUIRE(output == "a1\n");
+        REQUIRE(stream.str() == "a1\nafter");
+    }
+    SECTION("stops keeping output past its maximum size")
+    {
+        OutputRecorder recorder{stream, output, 4};
+        stream << "abc";
+        REQUIRE(!recorder.overflowed());
+        stream << "de";
+        REQUIRE(recorder.overflowed());
+        REQUIRE(stream.str() == "abcde");
+    }
+}
+
+
+TEST_CASE("logging recorder")
+{
+    std::vector<LoggedMessage> messages;
+    {
+        const LoggingRecorder recorder{messages};
+        log(LoggingLevel::INFO) << "info";
+        log(LoggingLevel::WARN) << "warning";
+        log(LoggingLevel::ERROR) << "error";
+        {
+            const UnrecordedLogging unrecorded;
+            log(LoggingLevel::WARN) << "about the caches";
+        }
+    }
+    log(LoggingLevel::ERROR) << "after";
+    // Warnings are kept whatever the logging level, so that replaying them
+    // at a more verbose level prints them.
+    REQUIRE(messages.size() == 2);
+    REQUIRE(messages[0].logging_level == LoggingLevel::WARN);
+    REQUIRE(messages[0].text == "warning");
+    REQUIRE(messages[1].logging_level == LoggingLevel::ERROR);
+    REQUIRE(messages[1].text == "error");
+}
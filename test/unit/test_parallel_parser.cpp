@@ -0,0 +1,73 @@
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "parallel_parser.hpp"
+#include "stringify.hpp"
+
+
+// Formats every statement of the given program, one per line.
+std::string stringify(const Program& program)
+{
+    std::string text;
+    for (const Statement* statement : program.statements)
+    {
+        ExpressionToString visitor;
+        statement->accept(visitor);
+        text += visitor.str() + "\n";
+    }
+    return text;
+}
+
+
+TEST_CASE("parse in parallel")
+{
+    const std::string program =
+        "var a = 1\n"
+        "// a comment\n"
+        "if (a > 0) {\n"
+        "    print \"positive\"\n"
+        "}\n"
+        "else\n"
+        "    print \"not positive\"\n"
+        "while (a < 10)\n"
+        "    a = a + 1\n"
+        "print a * 2\n";
+    SECTION("matches the serial parser for any chunk size")
+    {
+        const Source source{program};
+        const std::string expected = stringify(Parser{Lexer{source}.scan()}.parse());
+        for (std::size_t chunk_size = 1; chunk_size <= program.size(); ++chunk_size)
+        {
+            std::optional<Program> parallel = parse_in_parallel(source, 3, chunk_size);
+            REQUIRE(parallel);
+            REQUIRE(stringify(*parallel) == expected);
+        }
+    }
+    SECTION("keeps positions relative to the whole source")
+    {
+        std::optional<Program> parallel = parse_in_parallel(Source{"print 1\nprint 2\n"}, 2, 1);
+        REQUIRE(parallel);
+        REQUIRE(parallel->statements.size() == 2);
+        const Statement::Print* second = dynamic_cast<const Statement::Print*>(parallel->statements[1]);
+        REQUIRE(second);
+        REQUIRE(second->keyword.position.offset == 8);
+    }
+    SECTION("gives up on errors")
+    {
+        REQUIRE_FALSE(parse_in_parallel(Source{"print 1\nprint (\nprint 3\n"}, 2, 1));
+        REQUIRE_FALSE(parse_in_parallel(Source{"print 1\nprint $\n"}, 2, 1));
+    }
+    SECTION("empty source")
+    {
+        std::optional<Program> parallel = parse_in_parallel(Source{""}, 2, 1);
+        REQUIRE(parallel);
+        REQUIRE(parallel->statements.empty());
+    }
+}
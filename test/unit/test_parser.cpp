@@ -0,0 +1,153 @@
+#include <catch2/catch.hpp>
+
+#include <span>
+#include <string>
+
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "stringify.hpp"
+
+
+// Parses the given single-statement program and formats its statement.
+static std::string parse_statement(const std::string& text)
+{
+    const Program program = Parser{Lexer{Source{text}}.scan()}.parse();
+    REQUIRE(program.statements.size() == 1);
+    ExpressionToString visitor;
+    program.statements.front()->accept(visitor);
+    return visitor.str();
+}
+
+
+TEST_CASE("parse expressions")
+{
+    SECTION("binary operators bind by precedence")
+    {
+        REQUIRE(parse_statement("print 1 + 2 * 3 - 4 / 5") == "(print ((1.000000 + (2.000000 * 3.000000)) - (4.000000 / 5.000000)))");
+        REQUIRE(parse_statement("print a or b and c == d < e + f") == "(print (a or (b and (c == (d < (e + f))))))");
+        REQUIRE(parse_statement("print a + b < c == d and e or f") == "(print (((((a + b) < c) == d) and e) or f))");
+    }
+    SECTION("binary operators are left-associative")
+    {
+        REQUIRE(parse_statement("print 1 - 2 - 3") == "(print ((1.000000 - 2.000000) - 3.000000))");
+        REQUIRE(parse_statement("print a / b * c") == "(print ((a / b) * c))");
+        REQUIRE(parse_statement("print a or b or c") == "(print ((a or b) or c))");
+    }
+    SECTION("assignment is right-associative")
+    {
+        REQUIRE(parse_statement("a = b = c or d") == "(a = (b = (c or d)))");
+    }
+    SECTION("prefix operators bind most tightly")
+    {
+        REQUIRE(parse_statement("print -a * !b") == "(print ((- a) * (! b)))");
+        REQUIRE(parse_statement("print - -(a + b)") == "(print (- (- ((a + b)))))");
+    }
+    SECTION("assignment to anything but a variable is an error")
+    {
+        REQUIRE_THROWS_AS(Parser{Lexer{Source{"a + b = c"}}.scan()}.parse(), BeelineParseError);
+        REQUIRE_THROWS_AS(Parser{Lexer{Source{"-a = c"}}.scan()}.parse(), BeelineParseError);
+    }
+}
+
+
+TEST_CASE("parse declarations")
+{
+    SECTION("nested blocks may declare names again")
+    {
+        REQUIRE(parse_statement("{\n    var a\n    {\n        var a\n    }\n    {\n        var a\n    }\n}") == "{(var a) {(var a) } {(var a) } }");
+    }
+    SECTION("names declared twice are left to the resolver")
+    {
+        REQUIRE(Parser{Lexer{Source{"var a\nvar a"}}.scan()}.parse().statements.size() == 2);
+        REQUIRE(parse_statement("{\n    var a\n    var a = 1\n}") == "{(var a) (var a = 1.000000) }");
+    }
+}
+
+
+TEST_CASE("parse lazily")
+{
+    // A block body long enough to be parsed lazily, with a nested one.
+    std::string body = "{\n    var x = 0\n    if (x < 3) {\n";
+    for (int i = 0; i < 8; ++i)
+    {
+        body += "        x = x + (1 * 2 - 3) / 4\n";
+    }
+    body += "    }\n}";
+    const std::string text = "var a = 1\nif (a > 0) " + body + "\nelse {\n    print \"small\"\n}\n";
+    SECTION("defers large block bodies")
+    {
+        const Program program = Parser{Lexer{Source{text}}.scan(), true}.parse();
+        REQUIRE(program.statements.size() == 2);
+        ExpressionToString visitor;
+        program.statements[1]->accept(visitor);
+        REQUIRE(visitor.str() == "(if (a > 0.000000) then {...} else {(print small) })");
+    }
+    SECTION("parses deferred bodies from their braces")
+    {
+        const Source source{text};
+        const Program program = Parser{Lexer{source}.scan(), true}.parse();
+        const Statement* then_statement = static_cast<const Statement::IfElse*>(program.statements[1])->then_statement;
+        REQUIRE(then_statement->kind == Statement::Kind::LAZY_BLOCK);
+        const Statement::LazyBlock& lazy_block = static_cast<const Statement::LazyBlock&>(*then_statement);
+        const std::size_t begin = lazy_block.left_brace.position.offset;
+        const std::size_t end = lazy_block.right_brace.position.offset + 1;
+        REQUIRE(source.text().substr(begin, end - begin) == body);
+        const Program eager = Parser{Lexer{source, begin, end}.scan()}.parse();
+        const Program lazy = Parser{Lexer{source, begin, end}.scan(), true}.parse();
+        REQUIRE(eager.statements.size() == 1);
+        ExpressionToString eager_visitor;
+        eager.statements.front()->accept(eager_visitor);
+        REQUIRE(eager_visitor.str() == parse_statement(body));
+        // Variables declared within the body are not noted.
+        REQUIRE(lazy_block.free_variables.empty());
+        // The nested branch is deferred in turn.
+        ExpressionToString lazy_visitor;
+        lazy.statements.front()->accept(lazy_visitor);
+        REQUIRE(lazy_visitor.str() == "{(var x = 0.000000) (if (x < 3.000000) then {...}) }");
+    }
+    SECTION("parses loop bodies and the branches within them eagerly")
+    {
+        const std::string loop = "var a = 1\nwhile (a > 0) {\n    a = a - 1\n    if (a > 0) " + body + "\n}\n";
+        const Program lazy = Parser{Lexer{Source{loop}}.scan(), true}.parse();
+        const Program eager = Parser{Lexer{Source{loop}}.scan()}.parse();
+        ExpressionToString lazy_visitor;
+        lazy.statements[1]->accept(lazy_visitor);
+        ExpressionToString eager_visitor;
+        eager.statements[1]->accept(eager_visitor);
+        REQUIRE(lazy_visitor.str() == eager_visitor.str());
+        REQUIRE(lazy_visitor.str().find("{...}") == std::string::npos);
+    }
+    SECTION("notes the variables deferred bodies use from outside")
+    {
+        std::string uses = "{\n    print \"\" + b\n    var c = a\n";
+        for (int i = 0; i < 16; ++i)
+        {
+            uses += "    c = c + a * b\n";
+        }
+        uses += "    var b = c\n    b = b + c\n}";
+        const Program program = Parser{Lexer{Source{"if (false) " + uses}}.scan(), true}.parse();
+        const Statement* body = static_cast<const Statement::IfElse*>(program.statements.front())->then_statement;
+        REQUIRE(body->kind == Statement::Kind::LAZY_BLOCK);
+        const std::span<Expression*> free_variables = static_cast<const Statement::LazyBlock*>(body)->free_variables;
+        REQUIRE(free_variables.size() == 2);
+        REQUIRE(static_cast<const Expression::Variable*>(free_variables[0])->name.lexeme == "b");
+        REQUIRE(static_cast<const Expression::Variable*>(free_variables[1])->name.lexeme == "a");
+        // A body that declares a variable twice is parsed eagerly, so that the
+        // resolver reports it before the program runs.
+        const std::string redeclared = "if (false) " + uses.substr(0, uses.size() - 1) + "    var c\n}";
+        const Program eager = Parser{Lexer{Source{redeclared}}.scan(), true}.parse();
+        REQUIRE(static_cast<const Statement::IfElse*>(eager.statements.front())->then_statement->kind == Statement::Kind::BLOCK);
+    }
+    SECTION("reports syntax errors in deferred bodies")
+    {
+        for (const std::string line : {"print 1 +", "(x) = 1", "-x = 1", "x + x = 1"})
+        {
+            const std::string bad = "if (true) " + body.substr(0, body.size() - 1) + "    " + line + "\n}\n";
+            REQUIRE_THROWS_AS((Parser{Lexer{Source{bad}}.scan(), true}.parse()), BeelineParseError);
+        }
+        const std::string good = "if (true) " + body.substr(0, body.size() - 1) + "    x = x = 1\n}\n";
+        const Program program = Parser{Lexer{Source{good}}.scan(), true}.parse();
+        REQUIRE(static_cast<const Statement::IfElse*>(program.statements.front())->then_statement->kind == Statement::Kind::LAZY_BLOCK);
+    }
+}
@@ -0,0 +1,56 @@
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <string>
+
+#include "beeline.hpp"
+#include "flat_ast.hpp"
+#include "pass_manager.hpp"
+#include "test_helpers.hpp"
+
+
+TEST_CASE("pass manager")
+{
+    SECTION("enables the passes of the level, then those enabled and disabled by name")
+    {
+        const PassManager none{OptimizationOptions{0}};
+        const PassManager some{OptimizationOptions{1}};
+        const PassManager all;
+        for (const Pass& pass : registered_passes())
+        {
+            REQUIRE_FALSE(none.is_enabled(pass.name));
+            REQUIRE(some.is_enabled(pass.name) == (pass.level <= 1));
+            REQUIRE(all.is_enabled(pass.name));
+        }
+        const PassManager chosen{OptimizationOptions{0, {"simplifier", "loop_invariants"}, {"loop_invariants"}}};
+        REQUIRE(chosen.is_enabled("simplifier"));
+        REQUIRE_FALSE(chosen.is_enabled("loop_invariants"));
+        REQUIRE_FALSE(chosen.is_enabled("constant_folder"));
+    }
+    SECTION("rejects unknown levels and passes")
+    {
+        const OptimizationOptions too_high{3};
+        const OptimizationOptions too_low{-1};
+        const OptimizationOptions unknown_enabled{2, {"inliner"}};
+        const OptimizationOptions unknown_dumped{2, {}, {}, "inliner"};
+        REQUIRE_THROWS_AS(PassManager{too_high}, BeelineError);
+        REQUIRE_THROWS_AS(PassManager{too_low}, BeelineError);
+        REQUIRE_THROWS_AS(PassManager{unknown_enabled}, BeelineError);
+        REQUIRE_THROWS_AS(PassManager{unknown_dumped}, BeelineError);
+    }
+    SECTION("runs only the enabled passes")
+    {
+        const std::string text = "var a = 1 + 2";
+        REQUIRE(last_value(optimize(text, PassManager{OptimizationOptions{0}})) == FlatAst::Opcode::ADD);
+        REQUIRE(last_value(optimize(text, PassManager{OptimizationOptions{1}})) == FlatAst::Opcode::LITERAL);
+        REQUIRE(last_value(optimize(text, PassManager{OptimizationOptions{2, {}, {"constant_folder"}}})) == FlatAst::Opcode::ADD_NUMBERS);
+    }
+    SECTION("dumps the program after the chosen pass")
+    {
+        std::ostringstream dump;
+        const PassManager passes{OptimizationOptions{2, {}, {}, "simplifier"}, dump};
+        optimize("var a = 1 + 2\nvar b = a * 1", passes);
+        REQUIRE(dump.str() == "after simplifier:\n(var a = 3.000000)\n(var b = a)\n");
+        REQUIRE(count_nodes(optimize("var a = 1 + 2\nvar b = a * 1", passes)) == 4);
+    }
+}
@@ -0,0 +1,85 @@
+#include <catch2/catch.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "arena.hpp"
+#include "source.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "flat_ast.hpp"
+#include "program_cache.hpp"
+#include "stringify.hpp"
+
+
+// Formats the tree form of the given flat AST, one statement per line.
+static std::string stringify(const FlatAst& ast)
+{
+    Arena arena;
+    std::string text;
+    for (const Statement* statement : raise(ast, arena))
+    {
+        ExpressionToString visitor;
+        statement->accept(visitor);
+        text += visitor.str() + "\n";
+    }
+    return text;
+}
+
+
+TEST_CASE("program cache")
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / ("beeline_test_cache_" + std::to_string(getpid()));
+    std::filesystem::remove_all(directory);
+    const ProgramCache cache{directory};
+    const Source source{
+        "var a = \"text\"\n"
+        "if (a != nil and true) {\n"
+        "    print a + 1.5\n"
+        "}\n"
+        "else\n"
+        "    a = -2 / (3 - 1)\n"
+        "while (false) {}\n"
+    };
+    const FlatAst ast = lower(Parser{Lexer{source}.scan()}.parse());
+    SECTION("misses until stored")
+    {
+        REQUIRE(!cache.load(source));
+        cache.store(ast);
+        const std::optional<FlatAst> loaded = cache.load(source);
+        REQUIRE(loaded);
+        REQUIRE(loaded->size() == ast.size());
+        REQUIRE(stringify(*loaded) == stringify(ast));
+        // Names refer into the source they are loaded for.
+        REQUIRE(loaded->name(0).data() >= source.text().data());
+        REQUIRE(loaded->name(0).data() < source.text().data() + source.text().size());
+    }
+    SECTION("keys entries by source")
+    {
+        cache.store(ast);
+        REQUIRE(!cache.load(Source{std::string{source.text()} + "print a\n"}));
+    }
+    SECTION("ignores corrupt entries")
+    {
+        cache.store(ast);
+        std::vector<std::filesystem::path> entries{std::filesystem::directory_iterator{directory}, std::filesystem::directory_iterator{}};
+        REQUIRE(entries.size() == 1);
+        const std::uintmax_t size = std::filesystem::file_size(entries.front());
+        {
+            std::fstream file{entries.front(), std::ios::binary | std::ios::in | std::ios::out};
+            file.seekp(size - 3);
+            file.put('\x7f');
+        }
+        REQUIRE(!cache.load(source));
+        std::filesystem::resize_file(entries.front(), size / 2);
+        REQUIRE(!cache.load(source));
+        cache.store(ast);
+        REQUIRE(cache.load(source));
+    }
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,81 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+
+#include "beeline.hpp"
+#include "flat_ast.hpp"
+#include "interpreter.hpp"
+#include "test_helpers.hpp"
+
+
+// Returns the index of the expression printed by the first statement.
+static FlatAst::Index printed(const FlatAst& ast)
+{
+    return ast.node(ast.statements().front()).a;
+}
+
+
+// Evaluates the expression at the given index the given number of times and
+// returns the last value.
+static Token::Literal evaluate(FlatAst& ast, const FlatAst::Index expression, const int times)
+{
+    Token::Literal value;
+    for (int i = 0; i < times; ++i)
+    {
+        value = Interpreter::evaluate_constant(ast, expression);
+    }
+    return value;
+}
+
+
+TEST_CASE("quickening")
+{
+    SECTION("quicken operators after their operands keep their types")
+    {
+        FlatAst ast = flatten("print 6 / 3");
+        REQUIRE(std::get<double>(evaluate(ast, printed(ast), 15)) == 2);
+        REQUIRE(ast.node(printed(ast)).opcode == FlatAst::Opcode::DIVIDE);
+        REQUIRE(std::get<double>(evaluate(ast, printed(ast), 1)) == 2);
+        REQUIRE(ast.node(printed(ast)).opcode == FlatAst::Opcode::DIVIDE_NUMBERS_GUARDED);
+        REQUIRE(std::get<double>(evaluate(ast, printed(ast), 1)) == 2);
+        ast = flatten("print \"a\" + \"b\"");
+        REQUIRE(std::get<std::string>(evaluate(ast, printed(ast), 16)) == "ab");
+        REQUIRE(ast.node(printed(ast)).opcode == FlatAst::Opcode::ADD_STRINGS_GUARDED);
+        REQUIRE(std::get<std::string>(evaluate(ast, printed(ast), 1)) == "ab");
+        ast = flatten("print 1 < 2");
+        REQUIRE(std::get<bool>(evaluate(ast, printed(ast), 16)));
+        REQUIRE(ast.node(printed(ast)).opcode == FlatAst::Opcode::LESS_NUMBERS_GUARDED);
+    }
+    SECTION("leave operators whose operands have mixed types")
+    {
+        FlatAst ast = flatten("print \"a\" + 1");
+        REQUIRE(std::get<std::string>(evaluate(ast, printed(ast), 32)) == "a1");
+        REQUIRE(ast.node(printed(ast)).opcode == FlatAst::Opcode::ADD);
+    }
+    SECTION("deoptimize for good once a guard fails")
+    {
+        FlatAst ast = flatten("print 1 + 2");
+        const FlatAst::Index addition = printed(ast);
+        REQUIRE(std::get<double>(evaluate(ast, addition, 16)) == 3);
+        REQUIRE(ast.node(addition).opcode == FlatAst::Opcode::ADD_NUMBERS_GUARDED);
+        const FlatAst::Index right = ast.node(addition).b;
+        const FlatAst::Index number = ast.node(right).a;
+        ast.node(right).a = ast.add_constant(std::string{"b"});
+        REQUIRE(std::get<std::string>(evaluate(ast, addition, 1)) == "1b");
+        REQUIRE(ast.node(addition).opcode == FlatAst::Opcode::ADD);
+        ast.node(right).a = number;
+        REQUIRE(std::get<double>(evaluate(ast, addition, 32)) == 3);
+        REQUIRE(ast.node(addition).opcode == FlatAst::Opcode::ADD);
+    }
+    SECTION("run as the generic operators they stand for")
+    {
+        const OptimizationOptions unoptimized{0};
+        const std::string loop = "var i = 0\nvar s = \"\"\nwhile (i < 40) {\n    s = s + \"ab\"\n    i = i + 1\n"
+            "    if (i == 30) {\n        s = 1\n    }\n}\nprint \"\" + s + (i * 2)";
+        REQUIRE(run(loop, unoptimized) == "1abababababababababab80");
+        REQUIRE(run(loop) == "1abababababababababab80");
+        const std::string division = "var i = 20\nvar total = 0\nwhile (i > -1) {\n    total = total + 100 / i\n"
+            "    i = i - 1\n}\nprint \"\" + total";
+        REQUIRE_THROWS_AS(run(division, unoptimized), BeelineError);
+    }
+}
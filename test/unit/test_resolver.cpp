@@ -0,0 +1,142 @@
+#include <catch2/catch.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "flat_ast.hpp"
+#include "resolver.hpp"
+#include "interpreter.hpp"
+#include "test_helpers.hpp"
+
+
+// Returns the slots of the declarations of the given flat AST, by the
+// position of their names.
+static std::map<std::uint32_t, FlatAst::Index> declared_slots(const FlatAst& ast)
+{
+    std::map<std::uint32_t, FlatAst::Index> slots;
+    for (FlatAst::Index index = 0; index < ast.size(); ++index)
+    {
+        if (ast.node(index).opcode == FlatAst::Opcode::VARIABLE_DECLARATION)
+        {
+            slots[ast.position(index).offset] = ast.node(index).c;
+        }
+    }
+    return slots;
+}
+
+
+TEST_CASE("resolver")
+{
+    Resolver resolver;
+    SECTION("places globals in declaration order and blocks above them")
+    {
+        const std::string text =
+            "var a = 1\n"
+            "{\n"
+            "    var b = a\n"
+            "    {\n"
+            "        var a = b\n"
+            "        a = a + b\n"
+            "    }\n"
+            "    var c = b\n"
+            "}\n"
+            "var d = a\n";
+        FlatAst ast = flatten(text);
+        resolver.resolve(ast);
+        REQUIRE(resolver.global_count() == 2);
+        const std::map<std::uint32_t, FlatAst::Index> slots = declared_slots(ast);
+        REQUIRE(slots.at(text.find("a = 1")) == 0);
+        REQUIRE(slots.at(text.find("d = a")) == 1);
+        REQUIRE(slots.at(text.find("b = a")) == 2);
+        REQUIRE(slots.at(text.find("a = b")) == 3);
+        REQUIRE(slots.at(text.find("c = b")) == 3);
+        std::vector<FlatAst::Index> block_sizes;
+        for (FlatAst::Index index = 0; index < ast.size(); ++index)
+        {
+            const FlatAst::Node& node = ast.node(index);
+            if (node.opcode == FlatAst::Opcode::ASSIGNMENT)
+            {
+                // The inner a shadows the global one.
+                REQUIRE(node.c == 3);
+                REQUIRE(ast.node(ast.node(node.b).b).c == 2);
+            }
+            if (node.opcode == FlatAst::Opcode::BLOCK)
+            {
+                block_sizes.push_back(node.c);
+            }
+        }
+        // Inner blocks are lowered first.
+        REQUIRE(block_sizes == std::vector<FlatAst::Index>{1, 2});
+    }
+    SECTION("reports variables that are undefined where they are used")
+    {
+        for (const std::string text : {"print a", "var a = a", "print b\nvar b = \"\"", "{\n    var c\n}\nc = 1", "if (true) {\n    d = 1\n    var d\n}"})
+        {
+            FlatAst ast = flatten(text);
+            REQUIRE_THROWS_AS(resolver.resolve(ast), BeelineResolveError);
+        }
+        REQUIRE(resolver.global_count() == 0);
+    }
+    SECTION("reports globals declared twice, also by earlier programs")
+    {
+        FlatAst first = flatten("var a\nvar b");
+        resolver.resolve(first);
+        FlatAst second = flatten("var c = a\nvar b");
+        REQUIRE_THROWS_AS(resolver.resolve(second), BeelineResolveError);
+        // The failed program declared nothing.
+        REQUIRE(resolver.global_count() == 2);
+        FlatAst third = flatten("var c = b");
+        resolver.resolve(third);
+        REQUIRE(resolver.global_count() == 3);
+    }
+    SECTION("reports variables declared twice in one block as globals are")
+    {
+        std::string body = "{\n    var x = 1\n";
+        for (int i = 0; i < 16; ++i)
+        {
+            body += "    x = x + 1\n";
+        }
+        body += "    var x\n}";
+        for (const std::string& text : std::vector<std::string>{"var a\nvar a", "{\n    var a\n    var a\n}", "if (true) " + body})
+        {
+            for (const bool lazy : {false, true})
+            {
+                FlatAst ast = flatten(text, lazy);
+                REQUIRE_THROWS_AS(resolver.resolve(ast), BeelineResolveError);
+            }
+        }
+        FlatAst shadowing = flatten("var a\n{\n    var a\n    {\n        var a\n    }\n}");
+        resolver.resolve(shadowing);
+    }
+    SECTION("resolves the variables lazy blocks use from outside")
+    {
+        std::string body = "{\n    var x = 1\n";
+        for (int i = 0; i < 16; ++i)
+        {
+            body += "    x = x + a\n";
+        }
+        body += "    b = x\n}";
+        FlatAst ast = flatten("var a = 1\nvar b\nif (false) " + body, true);
+        const FlatAst::Node& loop = ast.node(ast.statements()[2]);
+        const FlatAst::Node& lazy_block = ast.node(loop.b);
+        REQUIRE(lazy_block.opcode == FlatAst::Opcode::LAZY_BLOCK);
+        REQUIRE(lazy_block.b == 2);
+        resolver.resolve(ast);
+        REQUIRE(ast.node(ast.list(lazy_block.a, lazy_block.b)[0]).c == 0);
+        REQUIRE(ast.node(ast.list(lazy_block.a, lazy_block.b)[1]).c == 1);
+        FlatAst undefined = flatten("var a = 1\nif (false) " + body, true);
+        REQUIRE_THROWS_AS(Resolver{}.resolve(undefined), BeelineResolveError);
+    }
+}
+
+
+TEST_CASE("interpreter forgets the globals of declarations that did not run")
+{
+    Interpreter interpreter;
+    REQUIRE_THROWS_AS(interpreter.interpret(flatten("var a = 1\nvar b = a / 0\nvar c = 2")), BeelineRuntimeError);
+    REQUIRE_THROWS_AS(interpreter.interpret(flatten("var a = 2")), BeelineResolveError);
+    interpreter.interpret(flatten("var b = a\nvar c = b + a"));
+    REQUIRE_THROWS_AS(interpreter.interpret(flatten("var d = c\n{\n    var e = d\n    e = e / 0\n}")), BeelineRuntimeError);
+    interpreter.interpret(flatten("var e = d\n{\n    var f = e\n    f = f + e\n}"));
+}
@@ -0,0 +1,87 @@
+#include <catch2/catch.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+
+#include "beeline.hpp"
+
+
+// Redirects std::cout into a string while it is alive.
+class CaptureOutput
+{
+public:
+    CaptureOutput() : previous_{std::cout.rdbuf(output_.rdbuf())} {}
+    ~CaptureOutput() { std::cout.rdbuf(previous_); }
+    std::string str() const { return output_.str(); }
+private:
+    std::ostringstream output_;
+    std::streambuf* previous_;
+};
+
+
+TEST_CASE("session")
+{
+    CaptureOutput output;
+    Beeline::Session session = Beeline{}.session();
+    SECTION("keeps variables across submissions")
+    {
+        session.submit("var a = \"x\"\n");
+        session.confirm();
+        session.submit("a = a + \"y\"\n");
+        session.confirm();
+        session.submit("print a\n");
+        session.confirm();
+        REQUIRE(output.str() == "xy");
+    }
+    SECTION("waits for the end of a declaration")
+    {
+        session.submit("if (true) {\n");
+        session.confirm();
+        REQUIRE(session.is_pending());
+        session.submit("    print \"then\"\n");
+        session.confirm();
+        REQUIRE(output.str().empty());
+        session.submit("} else {\n    print \"else\"\n}\n");
+        session.confirm();
+        REQUIRE(!session.is_pending());
+        REQUIRE(output.str() == "then");
+    }
+    SECTION("executes each declaration once its line is submitted")
+    {
+        session.submit("var a = 1\n");
+        session.submit("print \"\" + a\n");
+        REQUIRE(output.str() == "1");
+        session.submit("while (a < 3) {\n");
+        session.submit("    a = a + 1\n");
+        REQUIRE(output.str() == "1");
+        session.submit("}\n");
+        session.submit("print \"\" + a\n");
+        REQUIRE(output.str() == "13");
+        REQUIRE(!session.is_pending());
+        // Only an if statement waits for the next line, which may start with an else.
+        session.submit("if (a == 3) print \"x\"\n");
+        REQUIRE(output.str() == "13");
+        session.submit("print \"y\"\n");
+        REQUIRE(output.str() == "13xy");
+    }
+    SECTION("waits for an else unless confirmed")
+    {
+        session.submit("if (false) print \"then\"\n");
+        REQUIRE(session.is_pending());
+        session.submit("else print \"else\"\n");
+        session.finish();
+        REQUIRE(output.str() == "else");
+    }
+    SECTION("continues after errors")
+    {
+        session.submit("var a = \"a\"\n");
+        session.confirm();
+        REQUIRE_THROWS_AS(session.submit("print b\n"), BeelineError);
+        REQUIRE_THROWS_AS(session.submit("print a +\n"), BeelineError);
+        REQUIRE(!session.is_pending());
+        session.submit("print a\n");
+        session.confirm();
+        REQUIRE(output.str() == "a");
+    }
+}
@@ -0,0 +1,49 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+
+#include "flat_ast.hpp"
+#include "test_helpers.hpp"
+
+
+// Parses, lowers, resolves and simplifies the given program.
+static FlatAst simplify(const std::string& text, const bool lazy = false)
+{
+    return optimize(text, {"simplifier"}, lazy);
+}
+
+
+TEST_CASE("simplifier")
+{
+    SECTION("rewrites identities of operands of known types")
+    {
+        REQUIRE(last_value(simplify("var a = 1\nvar b = ((a * 1) / 1 - 0)")) == FlatAst::Opcode::VARIABLE);
+        REQUIRE(last_value(simplify("var a = 2\nvar b = -(-(1 * a))")) == FlatAst::Opcode::VARIABLE);
+        REQUIRE(last_value(simplify("var a = \"\"\na = a + 1\nvar b = \"\" + a + \"\"")) == FlatAst::Opcode::VARIABLE);
+        REQUIRE(last_value(simplify("var a = 1 < 2\nvar b = !!(true and a or false)")) == FlatAst::Opcode::VARIABLE);
+        const FlatAst ast = simplify("var a = 1\nvar b = (a + 1) * (a - 1)");
+        const FlatAst::Node& product = ast.node(ast.node(ast.statements().back()).b);
+        REQUIRE(ast.node(product.a).opcode == FlatAst::Opcode::ADD);
+        REQUIRE(ast.node(product.b).opcode == FlatAst::Opcode::SUBTRACT);
+    }
+    SECTION("keeps identities that may not hold")
+    {
+        // Operands that are not numbers fail, as does !null.
+        REQUIRE(last_value(simplify("var a\nvar b = a * 1")) == FlatAst::Opcode::MULTIPLY);
+        REQUIRE(last_value(simplify("var a = 1\n{\n    a = \"a\"\n}\nvar b = -(-a)")) == FlatAst::Opcode::NEGATE);
+        REQUIRE(last_value(simplify("var a = 1\nvar b = !!a")) == FlatAst::Opcode::NOT);
+        // -0 + 0 is 0.
+        REQUIRE(last_value(simplify("var a = 1\nvar b = a + 0")) == FlatAst::Opcode::ADD);
+        REQUIRE(last_value(simplify("var a = 1\nvar b = \"\" + a")) == FlatAst::Opcode::ADD);
+        // Values may be assigned by lazy blocks, which are not parsed yet.
+        std::string body = "{\n";
+        for (int i = 0; i < 16; ++i)
+        {
+            body += "    a = a + \"a\"\n";
+        }
+        body += "}\n";
+        const FlatAst ast = simplify("var a = 1\nif (a == 1) " + body + "var b = a * 1", true);
+        REQUIRE(ast.node(ast.node(ast.statements()[1]).b).opcode == FlatAst::Opcode::LAZY_BLOCK);
+        REQUIRE(last_value(ast) == FlatAst::Opcode::MULTIPLY);
+    }
+}
@@ -0,0 +1,78 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include "splitter.hpp"
+
+
+// Splits the given text into the chunks between boundaries, feeding the
+// splitter one character at a time to exercise state kept across calls.
+std::vector<std::string> split(const std::string& text)
+{
+    Splitter splitter;
+    std::vector<std::string> chunks;
+    std::size_t start = 0;
+    auto cut = [&](const std::size_t boundary) {
+        if (boundary > start)
+        {
+            chunks.push_back(text.substr(start, boundary - start));
+            start = boundary;
+        }
+    };
+    for (const char c : text)
+    {
+        cut(splitter.scan(std::string{c}));
+    }
+    cut(splitter.finish());
+    return chunks;
+}
+
+
+TEST_CASE("split")
+{
+    SECTION("statements")
+    {
+        REQUIRE(split("var a = 1\nprint \"a\"\n") == std::vector<std::string>{"var a = 1\n", "print \"a\"\n"});
+    }
+    SECTION("braces and parentheses")
+    {
+        REQUIRE(split("{\n  var a = (1\n)\n}\nprint a") == std::vector<std::string>{"{\n  var a = (1\n)\n}\n", "print a"});
+    }
+    SECTION("strings and comments")
+    {
+        REQUIRE(split("print \"{\n(\" // {\nprint b") == std::vector<std::string>{"print \"{\n(\" // {\n", "print b"});
+    }
+    SECTION("else")
+    {
+        REQUIRE(split("if (a) print b\n// comment\n\nelse\n{\n}\nprint c") == std::vector<std::string>{"if (a) print b\n// comment\n\nelse\n{\n}\n", "print c"});
+        REQUIRE(split("if (a) print b\nelsewhere = 1") == std::vector<std::string>{"if (a) print b\n", "elsewhere = 1"});
+    }
+    SECTION("headers awaiting statements")
+    {
+        REQUIRE(split("while (a)\n\n  if (b)\n    c = d / e\nf = g\n") == std::vector<std::string>{"while (a)\n\n  if (b)\n    c = d / e\n", "f = g\n"});
+    }
+    SECTION("boundaries as soon as declarations end")
+    {
+        Splitter splitter;
+        REQUIRE(splitter.scan("var a = 1\n") == 10);
+        REQUIRE(splitter.scan("\n// comment\n") == 10);
+        REQUIRE(splitter.scan("while (a)\n") == 10);
+        REQUIRE(splitter.scan("  a = a - 1\n") == 44);
+        REQUIRE(splitter.scan("if (a) {\n}\n") == 44);
+        REQUIRE(splitter.scan("else if (b) print c\n") == 44);
+        REQUIRE(splitter.scan("else print d\n") == 88);
+        REQUIRE(splitter.scan("if (a) if (b) print c\nelse print d\n") == 88);
+        REQUIRE(splitter.scan("print e\n") == 131);
+    }
+    SECTION("confirm")
+    {
+        Splitter splitter;
+        REQUIRE(splitter.scan("if (a) print b\n") == 0);
+        REQUIRE(splitter.confirm() == 15);
+        REQUIRE(splitter.scan("{\n") == 15);
+        REQUIRE(splitter.confirm() == 15);
+        REQUIRE(splitter.scan("}\n") == 19);
+        REQUIRE(splitter.confirm() == 19);
+    }
+}
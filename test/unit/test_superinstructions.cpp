@@ -0,0 +1,68 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+
+#include "flat_ast.hpp"
+#include "test_helpers.hpp"
+
+
+// Parses, lowers, resolves, simplifies and type checks the given program,
+// and fuses its superinstructions, deferring large blocks if lazy.
+static FlatAst fuse(const std::string& text, const bool lazy = false)
+{
+    return optimize(text, {"simplifier", "type_checker", "superinstructions"}, lazy);
+}
+
+
+TEST_CASE("superinstructions")
+{
+    SECTION("fuse increments, comparisons to constants and appends")
+    {
+        const FlatAst ast = fuse("var i = 0\nvar s = \"\"\nwhile (i < 10) {\n    i = i + 1\n    s = s + \"x\"\n}\n");
+        const FlatAst::Node& loop = ast.node(ast.statements()[2]);
+        REQUIRE(ast.node(loop.a).opcode == FlatAst::Opcode::LESS_CONSTANT);
+        const std::span<const FlatAst::Index> body = ast.list(ast.node(loop.b).a, 2);
+        REQUIRE(ast.node(ast.node(body[0]).a).opcode == FlatAst::Opcode::INCREMENT);
+        REQUIRE(ast.node(body[1]).opcode == FlatAst::Opcode::APPEND);
+        REQUIRE(last_value(fuse("var i = 0\nvar j = i - 2")) == FlatAst::Opcode::SUBTRACT_NUMBERS);
+        REQUIRE(last_value(fuse("var i = 0\nvar j = (i = 2 + i)")) == FlatAst::Opcode::INCREMENT);
+        REQUIRE(last_value(fuse("var i = 0\nvar j = (i = i - 2)")) == FlatAst::Opcode::INCREMENT);
+        REQUIRE(last_value(fuse("var i = 0\nvar j = 2 >= i")) == FlatAst::Opcode::LESS_EQUAL_CONSTANT);
+    }
+    SECTION("fuse the operations of large loop bodies when parsing lazily")
+    {
+        std::string text = "var i = 0\nvar s = \"\"\nwhile (i < 10) {\n    i = i + 1\n";
+        for (int j = 0; j < 16; ++j)
+        {
+            text += "    s = s + \"x\"\n";
+        }
+        text += "}\n";
+        const FlatAst ast = fuse(text, true);
+        const FlatAst::Node& loop = ast.node(ast.statements()[2]);
+        REQUIRE(ast.node(loop.b).opcode == FlatAst::Opcode::BLOCK);
+        const std::span<const FlatAst::Index> body = ast.list(ast.node(loop.b).a, ast.node(loop.b).b);
+        REQUIRE(body.size() == 17);
+        REQUIRE(ast.node(ast.node(body[0]).a).opcode == FlatAst::Opcode::INCREMENT);
+        for (const FlatAst::Index statement : body.subspan(1))
+        {
+            REQUIRE(ast.node(statement).opcode == FlatAst::Opcode::APPEND);
+        }
+    }
+    SECTION("leave operations on unproven types and other variables")
+    {
+        REQUIRE(last_value(fuse("var i = 0\nvar j = 0\nvar k = (i = j + 1)")) == FlatAst::Opcode::ASSIGNMENT);
+        REQUIRE(last_value(fuse("var i = 0\ni = \"s\"\nvar k = (i = i + 1)")) == FlatAst::Opcode::ASSIGNMENT);
+        REQUIRE(last_value(fuse("var i = 0\nif (i == 0) {\n    i = \"s\"\n}\nvar k = i < 1")) == FlatAst::Opcode::LESS);
+        const FlatAst ast = fuse("var s = \"\"\nvar t = \"\"\ns = t + \"x\"\ns = s + t");
+        REQUIRE(ast.node(ast.statements()[2]).opcode == FlatAst::Opcode::EXPRESSION);
+        REQUIRE(ast.node(ast.statements()[3]).opcode == FlatAst::Opcode::EXPRESSION);
+    }
+    SECTION("run as the nodes they stand for")
+    {
+        REQUIRE(run("var i = 0\nwhile (i < 5) {\n    i = i + 2\n}\nprint \"\" + i") == "6");
+        REQUIRE(run("var i = 10\nwhile (3 <= i) {\n    i = i - 3\n}\nprint \"\" + i") == "1");
+        REQUIRE(run("var s = \"a\"\nvar i = 0\nwhile (i < 3) {\n    s = s + \"b\"\n    i = i + 1\n}\nprint s") == "abbb");
+        // Appends to values that are not strings fall back on adding them.
+        REQUIRE(run("var s = 1\nvar i = 0\nwhile (i < 2) {\n    s = s + \"b\"\n    i = i + 1\n}\nprint s") == "1bb");
+    }
+}
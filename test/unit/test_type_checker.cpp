@@ -0,0 +1,125 @@
+#include <catch2/catch.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "beeline.hpp"
+#include "flat_ast.hpp"
+#include "resolver.hpp"
+#include "interpreter.hpp"
+#include "pass_manager.hpp"
+#include "type_checker.hpp"
+#include "logging.hpp"
+#include "test_helpers.hpp"
+
+
+// Parses, lowers and resolves the given program, checks its types, then
+// simplifies it and gives its nodes their forms.
+static FlatAst check(const std::string& text, const bool lazy = false)
+{
+    FlatAst ast = flatten(text, lazy);
+    Resolver resolver;
+    resolver.resolve(ast);
+    check_types(ast);
+    PassManager{OptimizationOptions{0, {"simplifier", "type_checker"}}}.run(ast, resolver.global_count());
+    return ast;
+}
+
+
+TEST_CASE("type checker")
+{
+    SECTION("gives operators and conditions of proven types their unchecked forms")
+    {
+        const FlatAst ast = check("var i = 0\nwhile (i < 10) {\n    i = -i + 1\n}\n");
+        const FlatAst::Node& loop = ast.node(ast.statements()[1]);
+        REQUIRE(loop.opcode == FlatAst::Opcode::WHILE_LOOP_BOOLEAN);
+        REQUIRE(ast.node(loop.a).opcode == FlatAst::Opcode::LESS_NUMBERS);
+        const FlatAst::Node& assignment = ast.node(ast.node(ast.list(ast.node(loop.b).a, 1)[0]).a);
+        const FlatAst::Node& sum = ast.node(assignment.b);
+        REQUIRE(sum.opcode == FlatAst::Opcode::ADD_NUMBERS);
+        REQUIRE(ast.node(sum.a).opcode == FlatAst::Opcode::NEGATE_NUMBER);
+        REQUIRE(last_value(check("var a = 1 < 2\nvar b = !(a and true or a)")) == FlatAst::Opcode::NOT_BOOLEAN);
+        REQUIRE(last_value(check("var a = 1\nvar b = \"\" + a")) == FlatAst::Opcode::ADD);
+        REQUIRE(last_value(check("var a = 1\nvar b = a == 1")) == FlatAst::Opcode::EQUAL);
+    }
+    SECTION("follows the types of variables through the statements")
+    {
+        // a is a number where it is multiplied, and a string after.
+        const FlatAst ast = check("var a = 1\nvar b = a * 2\na = \"s\"\nvar c = a + \"t\"");
+        REQUIRE(ast.node(ast.node(ast.statements()[1]).b).opcode == FlatAst::Opcode::MULTIPLY_NUMBERS);
+        REQUIRE(last_value(ast) == FlatAst::Opcode::ADD);
+        REQUIRE(last_value(check("var a = 1\nif (a < 2) {\n    a = \"s\"\n}\nvar b = a - 1")) == FlatAst::Opcode::SUBTRACT);
+        REQUIRE(last_value(check("var a = 1\nif (a < 2) {\n    a = 2\n} else {\n    a = 3\n}\nvar b = a - 1")) == FlatAst::Opcode::SUBTRACT_NUMBERS);
+        REQUIRE(last_value(check("var a = 1\nvar b = (a > 0 or (a = \"s\") == \"s\")\nvar c = a / 2")) == FlatAst::Opcode::DIVIDE);
+    }
+    SECTION("keeps the checks of what loops and lazy blocks may change")
+    {
+        // On the second iteration, a is a string.
+        const FlatAst ast = check("var a = 1\nvar i = 0\nwhile (i < 3) {\n    var b = a - 1\n    a = \"s\"\n    i = i + 1\n}");
+        const FlatAst::Node& body = ast.node(ast.node(ast.statements()[2]).b);
+        const FlatAst::Node& declaration = ast.node(ast.list(body.a, body.b)[0]);
+        REQUIRE(ast.node(declaration.b).opcode == FlatAst::Opcode::SUBTRACT);
+        std::string block = "{\n";
+        for (int i = 0; i < 16; ++i)
+        {
+            block += "    a = a + 1\n";
+        }
+        block += "}\n";
+        REQUIRE(last_value(check("var a = 1\nif (a == 1) " + block + "var b = a * 2", true)) == FlatAst::Opcode::MULTIPLY);
+        REQUIRE(last_value(check("var a = 1\nif (a == 1) " + block + "var b = a * 2", false)) == FlatAst::Opcode::MULTIPLY_NUMBERS);
+    }
+    SECTION("fails programs before they run on type errors on paths that always run")
+    {
+        REQUIRE_THROWS_AS(check("print \"a\"\nprint 1 + true"), BeelineTypeError);
+        REQUIRE_THROWS_AS(check("var a = \"s\"\n{\n    var b = a - 1\n}"), BeelineTypeError);
+        REQUIRE_THROWS_AS(check("var a = 1\nwhile (a) {\n    a = 2\n}"), BeelineTypeError);
+        REQUIRE_THROWS_AS(run("print \"a\"\nprint 1 + true"), BeelineError);
+    }
+    SECTION("fails programs before they run whatever passes run")
+    {
+        for (const OptimizationOptions& optimization : {OptimizationOptions{0}, OptimizationOptions{2, {}, {"type_checker"}}})
+        {
+            std::ostringstream output;
+            std::streambuf* const previous = std::cout.rdbuf(output.rdbuf());
+            Interpreter interpreter{optimization};
+            CHECK_THROWS_AS(interpreter.interpret(flatten("print \"a\"\nprint 1 + true")), BeelineTypeError);
+            CHECK_THROWS_AS(interpreter.interpret(flatten("print \"a\"\nprint \"\" + (1 / 0)")), BeelineRuntimeError);
+            std::cout.rdbuf(previous);
+            REQUIRE(output.str().empty());
+        }
+    }
+    SECTION("fails programs before they run on constant expressions that fail on paths that always run")
+    {
+        REQUIRE_THROWS_AS(check("print \"a\"\nprint \"\" + (1 / 0)"), BeelineRuntimeError);
+        REQUIRE_THROWS_AS(check("var a = 1\nvar b = a + 2 / (1 - 1)"), BeelineRuntimeError);
+        // Operand types are checked before values, as the interpreter does.
+        REQUIRE_THROWS_AS(check("var a = 1 / (0 + true)"), BeelineTypeError);
+        std::vector<LoggedMessage> messages;
+        {
+            const LoggingRecorder recorder{messages};
+            REQUIRE_NOTHROW(check("var a = 1\nif (a > 2) {\n    print \"\" + (1 / 0)\n}"));
+        }
+        REQUIRE(messages.size() == 1);
+        REQUIRE(messages.front().logging_level == LoggingLevel::WARN);
+        REQUIRE(messages.front().text == "constant expression fails if it runs: division by zero at 3:19-19");
+    }
+    SECTION("reports no error after an evaluation that always fails")
+    {
+        REQUIRE_NOTHROW(check("var x = 1\nprint \"a\" <= x / 0"));
+        REQUIRE_NOTHROW(check("var x = 1\nvar y = x / 0\nprint 1 + true"));
+        REQUIRE_NOTHROW(check("var x = 1\nvar y = x / (1 - 1)\nprint 1 + true"));
+        REQUIRE_NOTHROW(check("var a = 1\nwhile (1 < 2) {\n    a = 2\n}\nprint 1 + true"));
+        REQUIRE_THROWS_AS(check("print \"\" + 1 / 0\nprint 1 + true"), BeelineRuntimeError);
+        REQUIRE_THROWS_AS(check("var x = 1\nvar y = x / 2\nprint 1 + true"), BeelineTypeError);
+    }
+    SECTION("leaves type errors on paths that may not run to fail if they do")
+    {
+        REQUIRE_NOTHROW(check("var a = 1\nif (a > 2) {\n    print a + true\n}"));
+        REQUIRE_NOTHROW(check("var a = 1\nwhile (a > 2) {\n    a = a - true\n}"));
+        REQUIRE_NOTHROW(check("var a = true\nvar b = a or (a + true)"));
+        REQUIRE_NOTHROW(check("var a = 1\nwhile (true) {\n    a = 2\n}\nprint 1 + true"));
+    }
+}